@@ -0,0 +1,126 @@
+/*
+ * async_sync.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#ifndef INCLUDE_ASYNC_SYNC_H_
+#define INCLUDE_ASYNC_SYNC_H_
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "event_loop.h"
+
+namespace ael {
+
+// Synchronization between event loops that never blocks an event loop thread - instead of waiting, a callback is passed.
+// A waiter is resumed as a posted function of its own event loop: the event loop given, or EventLoop::Current() (calling
+// without an event loop outside the context of an event loop throws). A callback that can run immediately is dispatched (see
+// EventLoop::Dispatch()) - in the context of its event loop it is called before the call returns.
+
+namespace detail {
+
+// Not part of the API - the waiters of the primitives below.
+struct AsyncWaiter {
+	std::weak_ptr<EventLoop> event_loop;
+	std::function<void()> callback;
+};
+
+}
+
+// Bounds concurrency (e.g. the number of in-flight upstream requests). Waiters acquire in order (a release hands the unit to
+// the first waiter). A unit handed to a waiter whose event loop is stopped before the waiter runs is released again (acquiring
+// for a stopped event loop is ignored).
+class AsyncSemaphore : public std::enable_shared_from_this<AsyncSemaphore> {
+public:
+	static std::shared_ptr<AsyncSemaphore> Create(std::uint64_t count);
+
+	virtual ~AsyncSemaphore() {}
+
+	void Acquire(std::function<void()> callback);
+	void Acquire(std::shared_ptr<EventLoop> event_loop, std::function<void()> callback);
+	bool TryAcquire();
+	void Release();
+
+	std::uint64_t GetAvailable() const;
+	std::uint64_t GetWaiters() const;
+
+private:
+	AsyncSemaphore(std::uint64_t count) : count_(count) {}
+
+	mutable std::mutex lock_;
+	std::uint64_t count_;
+	std::deque<detail::AsyncWaiter> waiters_;
+};
+
+// A semaphore of one - the callback runs holding the mutex until Unlock() is called (possibly from another event loop).
+class AsyncMutex {
+public:
+	static std::shared_ptr<AsyncMutex> Create();
+
+	virtual ~AsyncMutex() {}
+
+	void Lock(std::function<void()> callback) { semaphore_->Acquire(callback); }
+	void Lock(std::shared_ptr<EventLoop> event_loop, std::function<void()> callback) { semaphore_->Acquire(event_loop, callback); }
+	bool TryLock() { return semaphore_->TryAcquire(); }
+	void Unlock() { semaphore_->Release(); }
+
+	bool IsLocked() const { return semaphore_->GetAvailable() == 0; }
+
+private:
+	AsyncMutex() : semaphore_(AsyncSemaphore::Create(1)) {}
+
+	std::shared_ptr<AsyncSemaphore> semaphore_;
+};
+
+// Waiters are resumed once the count reaches zero (waiting afterwards resumes immediately).
+class AsyncLatch {
+public:
+	static std::shared_ptr<AsyncLatch> Create(std::uint64_t count);
+
+	virtual ~AsyncLatch() {}
+
+	void CountDown(std::uint64_t n = 1);
+	void Wait(std::function<void()> callback);
+	void Wait(std::shared_ptr<EventLoop> event_loop, std::function<void()> callback);
+
+	std::uint64_t GetCount() const;
+
+private:
+	AsyncLatch(std::uint64_t count) : count_(count) {}
+
+	mutable std::mutex lock_;
+	std::uint64_t count_;
+	std::deque<detail::AsyncWaiter> waiters_;
+};
+
+// Waiters are resumed once the event is set - it stays set until it is reset.
+class AsyncEvent {
+public:
+	static std::shared_ptr<AsyncEvent> Create();
+
+	virtual ~AsyncEvent() {}
+
+	void Set();
+	void Reset();
+	void Wait(std::function<void()> callback);
+	void Wait(std::shared_ptr<EventLoop> event_loop, std::function<void()> callback);
+
+	bool IsSet() const;
+
+private:
+	AsyncEvent() : set_(false) {}
+
+	mutable std::mutex lock_;
+	bool set_;
+	std::deque<detail::AsyncWaiter> waiters_;
+};
+
+}
+
+#endif /* INCLUDE_ASYNC_SYNC_H_ */
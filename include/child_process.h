@@ -0,0 +1,94 @@
+/*
+ * child_process.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#ifndef INCLUDE_CHILD_PROCESS_H_
+#define INCLUDE_CHILD_PROCESS_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "event.h"
+
+namespace ael {
+
+// How a child process exited.
+class ChildExit {
+public:
+	ChildExit(std::uint32_t pid, int status) : pid_(pid), status_(status) {}
+
+	std::uint32_t GetPid() const { return pid_; }
+	bool IsExited() const;
+	int GetExitCode() const; // Valid if IsExited().
+	bool IsSignaled() const;
+	int GetSignal() const; // Valid if IsSignaled().
+
+private:
+	std::uint32_t pid_;
+	int status_; // As returned by waitpid().
+};
+
+typedef std::function<void(const ChildExit&)> ChildExitCallback;
+
+class ChildProcessOptions {
+public:
+	ChildProcessOptions() : pipe_stdin_(false), pipe_stdout_(false), pipe_stderr_(false) {}
+
+	std::vector<std::string> env_; // Empty - the environment of this process is inherited.
+	// A piped stream is connected to a pipe (see ChildProcess::TakeStdin()) - otherwise it is inherited.
+	bool pipe_stdin_;
+	bool pipe_stdout_;
+	bool pipe_stderr_;
+};
+
+// A child process watched by the event loop it is attached to (pidfd) - no SIGCHLD handler or blocking waitpid() is required.
+// The callback is called in the context of the event loop once the child exits (the child is reaped).
+// The child must not be reaped by others (e.g. SIGCHLD must not be ignored). If the child process is destroyed before the child
+// exits, the event loop it is attached to still reaps the child (the callback is not called).
+class ChildProcess : public EventHandler {
+public:
+	// Spawns argv[0] (searched in PATH) with posix_spawn().
+	static std::shared_ptr<ChildProcess> Spawn(const std::vector<std::string> &argv, const ChildProcessOptions &options, ChildExitCallback callback);
+
+	virtual ~ChildProcess();
+
+	friend std::ostream& operator<<(std::ostream &out, const ChildProcess *child_process);
+
+	std::uint32_t GetPid() const { return pid_; }
+	bool IsExited() const { return exited_; }
+
+	// The pipes of the piped streams (an invalid handle if not piped or already taken). The caller owns the handle - it is
+	// usually passed to StreamBuffer::CreateForPipe(). Closing stdin signals an end of file to the child.
+	Handle TakeStdin();
+	Handle TakeStdout();
+	Handle TakeStderr();
+
+	// Sends a signal to the child (ignored once the child has exited). May be called from any thread.
+	void Kill(int signal);
+
+private:
+	ChildProcess(Handle handle, std::uint32_t pid, Handle stdin_handle, Handle stdout_handle, Handle stderr_handle, ChildExitCallback callback);
+
+	void HandleEvents(Handle handle, Events events) override;
+	Events GetEvents() const override;
+
+	static Handle Take(Handle &handle);
+
+	const std::uint32_t pid_;
+	Handle stdin_handle_;
+	Handle stdout_handle_;
+	Handle stderr_handle_;
+	ChildExitCallback callback_;
+	std::atomic_bool exited_;
+};
+
+}
+
+#endif /* INCLUDE_CHILD_PROCESS_H_ */
@@ -10,6 +10,7 @@
 
 #include <cstdint>
 #include <memory>
+#include <string>
 
 namespace ael {
 
@@ -24,11 +25,14 @@ public:
 
 	const std::uint8_t* GetData() const { return data_; }
 	int GetDataLength() const { return data_length_; }
+	// A file range queued for writing (see StreamBuffer::WriteFile()) - it has no data, only a length.
+	virtual bool IsFileSegment() const { return false; }
 
 	// [suffix_index, data_length_)
 	DataView Slice(int suffix_index) const;
 
 	std::shared_ptr<const DataView> Save() const;
+	std::shared_ptr<const DataView> Retain() const { return Save(); } // Keeps a borrowed view past the callback it was handed to (only copies if not saved).
 	void AppendToString(std::string &str) const;
 
 private:
@@ -38,6 +42,11 @@ private:
 
 	DataView(const std::uint8_t* data, int data_length, bool saved);
 
+	friend class InputBuffer;
+	friend class PendingWrite;
+	friend class FileSegment;
+	friend class HandlesDataView;
+	friend class FileIO;
 };
 
 } /* namespace ael */
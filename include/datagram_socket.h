@@ -0,0 +1,108 @@
+/*
+ * datagram_socket.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#ifndef INCLUDE_DATAGRAM_SOCKET_H_
+#define INCLUDE_DATAGRAM_SOCKET_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "event.h"
+#include "data_view.h"
+#include "ring_buffer.h"
+
+struct sockaddr;
+
+namespace ael {
+
+class DatagramSocket;
+class PendingDatagram;
+
+// An IPv4 or IPv6 address and port.
+class SocketAddress {
+public:
+	SocketAddress() : addr_size_(0) {}
+	SocketAddress(const std::string &ip_addr, std::uint16_t port);
+	SocketAddress(const sockaddr *addr, std::uint32_t addr_size); // A sockaddr_in or a sockaddr_in6.
+
+	bool IsEmpty() const { return addr_size_ == 0; }
+	std::string GetIPAddr() const;
+	std::uint16_t GetPort() const;
+
+	const void* GetAddr() const { return storage_.data; }
+	std::uint32_t GetAddrSize() const { return addr_size_; }
+
+	bool operator==(const SocketAddress &other) const;
+	bool operator!=(const SocketAddress &other) const { return !(*this == other); }
+
+	friend std::ostream& operator<<(std::ostream &out, const SocketAddress &socket_address);
+
+private:
+	struct alignas(8) Storage {
+		std::uint8_t data[28]; // Large enough for a sockaddr_in6.
+	};
+
+	Storage storage_;
+	std::uint32_t addr_size_;
+};
+
+class DatagramHandler {
+public:
+	DatagramHandler() {}
+	virtual ~DatagramHandler() {}
+
+	// The data view is borrowed from the receive buffers - it is only valid for the duration of the call (call DataView::Retain() to keep it).
+	virtual void HandleDatagram(std::shared_ptr<DatagramSocket> datagram_socket, const DataView &data_view, const SocketAddress &source) = 0;
+};
+
+// A UDP socket. Datagrams are received and sent in batches (recvmmsg and sendmmsg) - see Config::datagram_batch_size_.
+class DatagramSocket: public EventHandler, public std::enable_shared_from_this<DatagramSocket> {
+public:
+	// Binds to ip_addr and port (port 0 binds an ephemeral port - see GetLocalAddress()).
+	static std::shared_ptr<DatagramSocket> Create(std::shared_ptr<DatagramHandler> datagram_handler, const std::string &ip_addr, std::uint16_t port);
+
+	virtual ~DatagramSocket();
+
+	friend std::ostream& operator<<(std::ostream &out, const DatagramSocket *datagram_socket);
+
+	// Queues a datagram (may be called from any thread). Datagrams queued until the event loop handles them are sent together.
+	void SendTo(const DataView &data_view, const SocketAddress &destination);
+	// Queued datagrams are sent (as far as the socket send buffer allows) before the socket is closed.
+	void Close();
+
+	SocketAddress GetLocalAddress() const;
+
+	// Consecutive queued datagrams of the same length and destination are sent as a single segmented send (UDP GSO).
+	// Returns false if not supported.
+	bool SetSegmentationOffload(bool segmentation_offload);
+	// The kernel may coalesce received datagrams (UDP GRO) - they are still handled one datagram at a time.
+	// Returns false if not supported. Should be called before attaching the datagram socket.
+	bool SetReceiveOffload(bool receive_offload);
+
+private:
+	DatagramSocket(std::shared_ptr<DatagramHandler> datagram_handler, Handle handle);
+
+	void HandleEvents(Handle handle, Events events) override;
+	Events GetEvents() const override;
+
+	void DoReceive(std::shared_ptr<DatagramHandler> datagram_handler);
+	void DoSend();
+
+	std::weak_ptr<DatagramHandler> datagram_handler_;
+	std::unique_ptr<class DatagramQueue> send_queue_;
+	RingBuffer<PendingDatagram*> unsent_; // Popped from the send queue and not sent yet (the socket send buffer is full).
+	std::unique_ptr<struct DatagramBatch> receive_batch_;
+	std::unique_ptr<struct DatagramBatch> send_batch_;
+	std::atomic_bool should_close_;
+	std::atomic_bool segmentation_offload_;
+	bool receive_offload_;
+};
+
+}
+
+#endif /* INCLUDE_DATAGRAM_SOCKET_H_ */
@@ -10,6 +10,7 @@
 
 #include <memory>
 #include <mutex>
+#include <atomic>
 #include <cstdint>
 
 #include "handle.h"
@@ -25,7 +26,7 @@ public:
 	static const std::uint32_t Write = 0x2;
 	static const std::uint32_t Close = 0x4;
 	static const std::uint32_t Error = 0x8;
-	static const std::uint32_t Stream = 0x16;
+	static const std::uint32_t Stream = 0x10;
 	
 	Events() : events_(0) {}
 	Events(std::uint32_t events) : events_(events) {}
@@ -54,6 +55,10 @@ protected:
 	void ReadyEvent(Events events);
 	void CloseEvent();
 	void ModifyEvent();
+	void DeferEvent(); // HandleEvents(Events::Write) once the current event loop iteration is dispatched (only in the context of the event loop).
+	bool IsEventLoopThread() const;
+	std::shared_ptr<EventLoop> GetEventLoop() const; // The event loop it is attached to (null if not attached or destroyed).
+	Handle GetHandle() const { return handle_; }
 
 private:
 	std::shared_ptr<Event> event_;
@@ -79,6 +84,7 @@ public:
 	void Close(); // The event should be "closed".
 	void Modify(); // "events" state has been modified. ***Important: this function must be called within the context of the event loop (this restriction may change if required in the future).
 	void Ready(Events events);	// Notifies that the event is ready to handle the given events.
+	void Defer(); // Handle the event at the end of the current event loop iteration. ***Important: this function must be called within the context of the event loop.
 
 private:
 	Event(std::shared_ptr<EventLoop>, std::shared_ptr<EventHandler> event_handler);
@@ -88,8 +94,13 @@ private:
 	std::weak_ptr<EventHandler> event_handler_;
 	Handle handle_;
 	std::once_flag close_flag_;
+	std::atomic<std::uint32_t> pending_ready_; // Ready events are coalesced until handled in the context of the event loop.
+
+	bool AddReady(Events events); // Returns true if the event should be scheduled (no ready events were pending).
+	Events TakeReady();
 
 	friend EventLoop;
+	friend class EPoll;
 };
 
 }
@@ -12,16 +12,57 @@
 #include <memory>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 #include <mutex>
 #include <cstdint>
 #include <atomic>
 #include <functional>
 #include <chrono>
+#include <string>
 
 #include "event.h"
 
 namespace ael {
 
+class WorkerPool;
+
+// Placement and scheduling of the event loop thread - applied by the thread once it starts. Settings that cannot be applied
+// (e.g. SCHED_FIFO without CAP_SYS_NICE) are logged and are not reflected in EventLoopStats.
+class EventLoopOptions {
+public:
+	EventLoopOptions() : numa_node_(-1), fifo_priority_(0), nice_(0), caller_thread_(false), single_thread_(false) {}
+
+	std::string name_; // The thread name (truncated to 15 characters).
+	std::vector<int> cpus_; // CPU affinity (empty - the CPUs of numa_node_ if set, otherwise not restricted).
+	// Memory allocated by the thread (e.g. read buffers and queues of its event handlers) is preferably taken from this node (-1 - not set).
+	int numa_node_;
+	int fifo_priority_; // Positive - the thread is scheduled with SCHED_FIFO at this priority.
+	int nice_; // Zero - not changed.
+	// No thread is started - the event loop is run by the application (see EventLoop::Run() and EventLoop::RunOnce()). The thread
+	// that runs it first becomes the event loop thread (the options above are applied to it).
+	bool caller_thread_;
+	// The application guarantees that the event loop and its event handlers are only used by the thread that creates it (it
+	// implies caller_thread_) - the event loop skips its locks and wakeups. Calls from other threads (including Offload()) throw.
+	// Work attached or posted between RunOnce() calls is handled by the next RunOnce() (the poll fd is not made readable).
+	bool single_thread_;
+};
+
+class EventLoopStats {
+public:
+	EventLoopStats() : numa_node_(-1), fifo_priority_(0), nice_(0), iterations_(0), migrations_(0), cpu_(-1) {}
+
+	// As applied.
+	std::string name_;
+	std::vector<int> cpus_;
+	int numa_node_;
+	int fifo_priority_;
+	int nice_;
+
+	std::uint64_t iterations_;
+	std::uint64_t migrations_; // Iterations that ran on a different CPU than the previous iteration.
+	int cpu_; // The CPU of the last iteration.
+};
+
 class Cancellable : public EventHandler {
 public:
 	Cancellable(Handle handle) : EventHandler(handle) {}
@@ -33,7 +74,10 @@ public:
 class EventLoop : public std::enable_shared_from_this<EventLoop> {
 public:
 	static std::shared_ptr<EventLoop> Create();
+	static std::shared_ptr<EventLoop> Create(const EventLoopOptions &options);
 	static void DestroyAll();
+	// The event loop running on the calling thread (in the context of an event loop) - nullptr otherwise.
+	static std::shared_ptr<EventLoop> Current();
 
 	void Attach(std::shared_ptr<EventHandler> event_handler);
 
@@ -64,16 +108,53 @@ public:
 		return timer_handler;
 	}
 
+	// Runs func in the context of the event loop (may be called from any thread). Posted functions run in order - unlike
+	// ExecuteOnce() no event is registered per call and a burst of posts wakes the event loop up once.
+	void Post(std::function<void()> func);
+	// Runs func immediately if called in the context of this event loop (e.g. a layered protocol passing data to the next
+	// layer) - otherwise it is posted. Unlike Post(), a func that dispatches to its own event loop recurses.
+	void Dispatch(std::function<void()> func);
+
+	// Runs work on a worker pool (WorkerPool::GetDefault() if not given) and then continuation in the context of this event loop.
+	// Returns false if the worker pool queue limit is reached (neither is called). If work throws, the exception is logged
+	// and continuation is still called.
+	bool Offload(std::function<void()> work, std::function<void()> continuation);
+	bool Offload(std::shared_ptr<WorkerPool> worker_pool, std::function<void()> work, std::function<void()> continuation);
+
+	EventLoopStats GetStats() const;
+
+	// EventLoopOptions::caller_thread_ - runs the event loop until Stop() is called. Always called from the same thread.
+	void Run();
+	// EventLoopOptions::caller_thread_ - a single iteration: waits up to timeout for events (negative - no limit), handles them
+	// and returns. Returns false once the event loop is stopped (its events are closed).
+	bool RunOnce(std::chrono::milliseconds timeout);
+	// Readable when RunOnce() has events to handle - may be added to the poll set of another event loop (e.g. a main loop).
+	Handle GetPollFd() const;
+	// May be called from any thread (the event loop thread is joined unless called in the context of the event loop).
+	void Stop();
+	// Posted functions are no longer run (they are destroyed once the event loop closes its events).
+	bool IsStopped() const { return stop_; }
+
 	virtual ~EventLoop();
 
 private:
-	EventLoop();
+	EventLoop(const EventLoopOptions &options);
 
-	void Run();
+	void RunThread();
+	void Iterate(int timeout_ms);
+	void CloseAll();
 	void Remove(std::uint64_t id);
 	void Ready(std::shared_ptr<Event> event, Events events);
 	void Modify(std::shared_ptr<Event> event);
-	void Stop();
+	void Defer(std::shared_ptr<Event> event);
+	void HandleDeferred();
+	void HandlePosted();
+	void UpdateIterationStats();
+	void CheckThread() const;
+	// The lock is skipped by a single thread event loop.
+	void Lock() { if (!options_.single_thread_) lock_.lock(); }
+	void Unlock() { if (!options_.single_thread_) lock_.unlock(); }
+	bool IsInLoopThread() const { return thread_id_ == std::this_thread::get_id(); }
 
 	void AttachInternal(std::shared_ptr<EventHandler> event_handler);
 	void RemoveInternal(std::shared_ptr<EventHandler> event_handler);
@@ -81,13 +162,28 @@ private:
 	std::shared_ptr<Event> CreateEvent(std::shared_ptr<EventHandler> event_handler);
 
 	std::unique_ptr<std::thread> thread_;
+	std::atomic<std::thread::id> thread_id_;
 	std::unique_ptr<class AsyncIO> async_io_;
 	std::unordered_map<std::uint64_t, std::shared_ptr<Event>> events_;
 	std::unordered_set<std::shared_ptr<EventHandler>> internal_event_handlers_;
+	std::vector<std::shared_ptr<Event>> deferred_events_; // Accessed only in the context of the event loop.
+	std::unique_ptr<class PostQueue> post_queue_;
+	std::atomic<std::int64_t> posted_; // Posted functions that were not run yet (a post that makes it positive wakes the event loop up).
 	std::mutex lock_;
 	std::atomic_bool stop_;
+	bool closed_; // The events were closed once the event loop was stopped (accessed only in the context of the event loop).
+	bool placed_; // The options were applied to the event loop thread (accessed only in the context of the event loop).
+	const EventLoopOptions options_;
+	EventLoopStats placement_; // The options as applied by the event loop thread.
+	mutable std::mutex placement_lock_;
+	std::atomic<std::uint64_t> iterations_;
+	std::atomic<std::uint64_t> migrations_;
+	std::atomic_int cpu_;
 
 	friend Event;
+	friend EventHandler;
+	friend class ZeroCopyLinger;
+	friend class ChildReaper;
 
 	class ExecuteHandler : public EventHandler {
 	public:
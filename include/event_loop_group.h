@@ -0,0 +1,51 @@
+/*
+ * event_loop_group.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#ifndef INCLUDE_EVENT_LOOP_GROUP_H_
+#define INCLUDE_EVENT_LOOP_GROUP_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "event_loop.h"
+
+namespace ael {
+
+class Strand;
+
+// A fixed set of event loops (e.g. one per core) that work is spread over.
+class EventLoopGroup {
+public:
+	// size 0 - the hardware concurrency.
+	static std::shared_ptr<EventLoopGroup> Create(std::uint32_t size);
+	// The name of each event loop is suffixed by its index. If cpus_ is set, each event loop is pinned to a single CPU of
+	// it (round robin). caller_thread_ and single_thread_ are not supported.
+	static std::shared_ptr<EventLoopGroup> Create(std::uint32_t size, const EventLoopOptions &options);
+
+	virtual ~EventLoopGroup();
+
+	std::uint32_t GetSize() const { return static_cast<std::uint32_t>(event_loops_.size()); }
+	std::shared_ptr<EventLoop> Get(std::uint32_t index) const { return event_loops_.at(index); }
+	std::shared_ptr<EventLoop> GetNext(); // Round robin.
+	std::shared_ptr<EventLoop> GetForKey(std::uint64_t key) const; // The same event loop for the same key.
+
+	// A strand on the next event loop (round robin) or on the event loop of the key.
+	std::shared_ptr<Strand> CreateStrand();
+	std::shared_ptr<Strand> CreateStrand(std::uint64_t key);
+
+private:
+	EventLoopGroup(std::uint32_t size, const EventLoopOptions &options);
+
+	std::vector<std::shared_ptr<EventLoop>> event_loops_;
+	std::atomic<std::uint32_t> next_;
+};
+
+}
+
+#endif /* INCLUDE_EVENT_LOOP_GROUP_H_ */
@@ -0,0 +1,86 @@
+/*
+ * file_io.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#ifndef INCLUDE_FILE_IO_H_
+#define INCLUDE_FILE_IO_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include "event.h"
+#include "data_view.h"
+#include "ring_buffer.h"
+
+namespace ael {
+
+struct FileOperation;
+
+// The result of an asynchronous file operation.
+class FileResult {
+public:
+	FileResult(std::int64_t result, std::shared_ptr<const DataView> data_view) : result_(result), data_view_(data_view) {}
+
+	bool IsError() const { return result_ < 0; }
+	int GetError() const { return result_ < 0 ? static_cast<int>(-result_) : 0; } // An errno value.
+	std::uint64_t GetBytes() const { return result_ > 0 ? static_cast<std::uint64_t>(result_) : 0; }
+	// ReadFile() - the data read (shorter than requested at the end of the file).
+	const std::shared_ptr<const DataView>& GetData() const { return data_view_; }
+
+private:
+	std::int64_t result_;
+	std::shared_ptr<const DataView> data_view_;
+};
+
+typedef std::function<void(const FileResult&)> FileCallback;
+
+// Asynchronous regular file I/O for the event loop it is attached to (epoll cannot wait for regular files - a read or a write
+// in the context of the event loop blocks it on the disk). Operations are executed by io_uring when the kernel supports it,
+// otherwise by a bounded thread pool shared by all the event loops (see Config::file_io_threads_).
+// Callbacks are called in the context of the event loop. The file handles must remain open until the callback is called.
+class FileIO: public EventHandler, public std::enable_shared_from_this<FileIO> {
+public:
+	// At most queue_depth operations are in flight - more are queued (in order) until operations complete.
+	static std::shared_ptr<FileIO> Create(); // Config::file_io_queue_depth_.
+	static std::shared_ptr<FileIO> Create(std::uint32_t queue_depth);
+
+	// Waits for the operations in flight to complete (their callbacks are not called).
+	virtual ~FileIO();
+
+	friend std::ostream& operator<<(std::ostream &out, const FileIO *file_io);
+
+	// Must be called in the context of the event loop. Operations issued in an event loop iteration are submitted together.
+	void ReadFile(Handle file_handle, std::uint64_t offset, std::uint32_t length, FileCallback callback);
+	// The data view is saved. Short writes are continued - the callback is called once all the data is written (or on an error).
+	void WriteFile(Handle file_handle, std::uint64_t offset, const DataView &data_view, FileCallback callback);
+	void Fsync(Handle file_handle, bool data_only, FileCallback callback); // data_only - fdatasync.
+
+	std::uint32_t GetQueueDepth() const { return queue_depth_; }
+	std::uint32_t GetInFlight() const { return in_flight_; }
+	std::size_t GetQueued() const { return queued_.GetSize(); }
+	bool IsIOUring() const;
+
+private:
+	FileIO(Handle handle, std::uint32_t queue_depth);
+
+	void HandleEvents(Handle handle, Events events) override;
+	Events GetEvents() const override;
+
+	void Queue(FileOperation *operation);
+	void DoComplete();
+	void DoSubmit();
+
+	const std::uint32_t queue_depth_;
+	std::uint32_t in_flight_;
+	RingBuffer<FileOperation*> queued_; // Operations above the queue depth.
+	bool submit_deferred_;
+	std::unique_ptr<class FileIOEngine> engine_;
+};
+
+}
+
+#endif /* INCLUDE_FILE_IO_H_ */
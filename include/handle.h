@@ -29,6 +29,7 @@ public:
 	static Handle CreateTimerHandle(const std::chrono::nanoseconds &interval, const std::chrono::nanoseconds &value);
 	static Handle CreateStreamListenerHandle(const std::string &ip_addr, std::uint16_t port);
 	static Handle CreateStreamHandle(const std::string &ip_addr, std::uint16_t port, bool &is_connected);
+	static Handle CreateDatagramHandle(const std::string &ip_addr, std::uint16_t port);
 
 	void Close();
 private:
@@ -0,0 +1,47 @@
+/*
+ * input_buffer.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#ifndef INCLUDE_INPUT_BUFFER_H_
+#define INCLUDE_INPUT_BUFFER_H_
+
+#include <deque>
+#include <memory>
+
+#include "data_view.h"
+
+namespace ael {
+
+// Accumulates received data as a chain of (reference counted) segments.
+// Data is only copied when a peeked range spans more than one segment.
+class InputBuffer {
+public:
+	InputBuffer();
+	virtual ~InputBuffer();
+
+	int GetDataLength() const { return data_length_; }
+	bool IsEmpty() const { return data_length_ == 0; }
+
+	// A contiguous view of the first data_length bytes - valid until the input buffer is modified.
+	DataView Peek(int data_length);
+	// The index of the first occurrence of delimiter (starting at start_index) or -1 if not found.
+	int Find(const DataView &delimiter, int start_index = 0) const;
+	void Consume(int data_length);
+
+	void Append(std::shared_ptr<const DataView> data_view);
+	void Clear();
+
+private:
+	bool Matches(std::deque<std::shared_ptr<const DataView>>::const_iterator segment_it, int offset, const DataView &delimiter) const;
+
+	std::deque<std::shared_ptr<const DataView>> segments_;
+	int offset_; // Offset of the readable data in the first segment.
+	int data_length_;
+};
+
+} /* namespace ael */
+
+#endif /* INCLUDE_INPUT_BUFFER_H_ */
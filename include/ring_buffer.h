@@ -0,0 +1,102 @@
+/*
+ * ring_buffer.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#ifndef INCLUDE_RING_BUFFER_H_
+#define INCLUDE_RING_BUFFER_H_
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+namespace ael {
+
+// A contiguous growable double ended queue (the capacity is a power of 2).
+// Elements do not require a node allocation each - memory is allocated only when the capacity grows.
+template<typename T>
+class RingBuffer {
+public:
+	RingBuffer() : elements_(nullptr), capacity_(0), head_(0), size_(0) {}
+	RingBuffer(const RingBuffer&) = delete;
+	RingBuffer& operator=(const RingBuffer&) = delete;
+
+	virtual ~RingBuffer() {
+		Clear();
+		::operator delete(elements_);
+	}
+
+	bool IsEmpty() const { return size_ == 0; }
+	std::size_t GetSize() const { return size_; }
+	std::size_t GetCapacity() const { return capacity_; }
+
+	T& Front() { return elements_[head_]; }
+	const T& Front() const { return elements_[head_]; }
+	T& Back() { return elements_[Index(size_ - 1)]; }
+	const T& Back() const { return elements_[Index(size_ - 1)]; }
+	T& operator[](std::size_t index) { return elements_[Index(index)]; }
+	const T& operator[](std::size_t index) const { return elements_[Index(index)]; }
+
+	void PushBack(T element) {
+		if (size_ == capacity_) {
+			Grow();
+		}
+
+		new (&elements_[Index(size_)]) T(std::move(element));
+		size_++;
+	}
+
+	void PushFront(T element) {
+		if (size_ == capacity_) {
+			Grow();
+		}
+
+		head_ = (head_ + capacity_ - 1) & (capacity_ - 1);
+		new (&elements_[head_]) T(std::move(element));
+		size_++;
+	}
+
+	void PopFront() {
+		elements_[head_].~T();
+		head_ = (head_ + 1) & (capacity_ - 1);
+		size_--;
+	}
+
+	void Clear() {
+		while (size_ > 0) {
+			PopFront();
+		}
+		head_ = 0;
+	}
+
+private:
+	std::size_t Index(std::size_t index) const { return (head_ + index) & (capacity_ - 1); }
+
+	void Grow() {
+		auto capacity = capacity_ == 0 ? 4 : capacity_ * 2;
+		auto elements = static_cast<T*>(::operator new(capacity * sizeof(T)));
+
+		for (std::size_t i = 0; i < size_; i++) {
+			auto &element = elements_[Index(i)];
+			new (&elements[i]) T(std::move(element));
+			element.~T();
+		}
+
+		::operator delete(elements_);
+
+		elements_ = elements;
+		capacity_ = capacity;
+		head_ = 0;
+	}
+
+	T *elements_;
+	std::size_t capacity_;
+	std::size_t head_;
+	std::size_t size_;
+};
+
+}
+
+#endif /* INCLUDE_RING_BUFFER_H_ */
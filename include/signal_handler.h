@@ -0,0 +1,71 @@
+/*
+ * signal_handler.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#ifndef INCLUDE_SIGNAL_HANDLER_H_
+#define INCLUDE_SIGNAL_HANDLER_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "event.h"
+
+namespace ael {
+
+// A signal received by a signal handler.
+class SignalInfo {
+public:
+	SignalInfo(int signal, std::int32_t code, std::uint32_t pid, std::uint32_t uid, std::int32_t status) :
+			signal_(signal), code_(code), pid_(pid), uid_(uid), status_(status) {}
+
+	int GetSignal() const { return signal_; }
+	std::int32_t GetCode() const { return code_; } // si_code (e.g. SI_USER, SI_QUEUE or CLD_EXITED).
+	std::uint32_t GetPid() const { return pid_; } // The sending process (SIGCHLD - the child).
+	std::uint32_t GetUid() const { return uid_; }
+	std::int32_t GetStatus() const { return status_; } // SIGCHLD - the exit status or signal of the child.
+
+private:
+	int signal_;
+	std::int32_t code_;
+	std::uint32_t pid_;
+	std::uint32_t uid_;
+	std::int32_t status_;
+};
+
+typedef std::function<void(const SignalInfo&)> SignalCallback;
+
+// Receives signals as events of the event loop it is attached to (signalfd) - the callback runs in the context of the event
+// loop, so it is not restricted to async-signal-safe functions.
+// A signal is received by the signal handler only if it is blocked in every thread (otherwise its disposition applies).
+// Create() blocks the signals in the calling thread and threads inherit the mask of the thread that creates them - create
+// the signal handler (or call Block()) in the main thread before any other thread is created.
+// A signal may be handled by a single signal handler at a time. The signals remain blocked once it is destroyed.
+class SignalHandler : public EventHandler {
+public:
+	static std::shared_ptr<SignalHandler> Create(const std::vector<int> &signals, SignalCallback callback);
+
+	// Blocks the signals in the calling thread (it is not required to call it before Create()).
+	static void Block(const std::vector<int> &signals);
+
+	virtual ~SignalHandler();
+
+	void Close();
+
+private:
+	SignalHandler(Handle handle, const std::vector<int> &signals, SignalCallback callback);
+
+	void HandleEvents(Handle handle, Events events) override;
+	Events GetEvents() const override;
+
+	const std::vector<int> signals_;
+	SignalCallback callback_;
+};
+
+}
+
+#endif /* INCLUDE_SIGNAL_HANDLER_H_ */
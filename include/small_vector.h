@@ -0,0 +1,94 @@
+/*
+ * small_vector.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#ifndef INCLUDE_SMALL_VECTOR_H_
+#define INCLUDE_SMALL_VECTOR_H_
+
+#include <cstddef>
+#include <iterator>
+#include <new>
+#include <utility>
+
+namespace ael {
+
+// An append only vector that stores up to N elements inline (no allocation).
+template<typename T, std::size_t N>
+class SmallVector {
+public:
+	typedef T* iterator;
+	typedef const T* const_iterator;
+	typedef std::reverse_iterator<iterator> reverse_iterator;
+	typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+	SmallVector() : elements_(reinterpret_cast<T*>(inline_elements_)), capacity_(N), size_(0) {}
+	SmallVector(const SmallVector&) = delete;
+	SmallVector& operator=(const SmallVector&) = delete;
+
+	virtual ~SmallVector() {
+		for (std::size_t i = 0; i < size_; i++) {
+			elements_[i].~T();
+		}
+
+		if (!IsInline()) {
+			::operator delete(elements_);
+		}
+	}
+
+	bool IsEmpty() const { return size_ == 0; }
+	bool IsInline() const { return elements_ == reinterpret_cast<const T*>(inline_elements_); }
+	std::size_t GetSize() const { return size_; }
+
+	T& Back() { return elements_[size_ - 1]; }
+	const T& Back() const { return elements_[size_ - 1]; }
+	T& operator[](std::size_t index) { return elements_[index]; }
+	const T& operator[](std::size_t index) const { return elements_[index]; }
+
+	void PushBack(T element) {
+		if (size_ == capacity_) {
+			Grow();
+		}
+
+		new (&elements_[size_]) T(std::move(element));
+		size_++;
+	}
+
+	iterator begin() { return elements_; }
+	iterator end() { return elements_ + size_; }
+	const_iterator begin() const { return elements_; }
+	const_iterator end() const { return elements_ + size_; }
+	reverse_iterator rbegin() { return reverse_iterator(end()); }
+	reverse_iterator rend() { return reverse_iterator(begin()); }
+	const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+	const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+private:
+	void Grow() {
+		auto capacity = capacity_ * 2;
+		auto elements = static_cast<T*>(::operator new(capacity * sizeof(T)));
+
+		for (std::size_t i = 0; i < size_; i++) {
+			new (&elements[i]) T(std::move(elements_[i]));
+			elements_[i].~T();
+		}
+
+		if (!IsInline()) {
+			::operator delete(elements_);
+		}
+
+		elements_ = elements;
+		capacity_ = capacity;
+	}
+
+	alignas(T) unsigned char inline_elements_[N * sizeof(T)];
+	T *elements_;
+	std::size_t capacity_;
+	std::size_t size_;
+};
+
+}
+
+#endif /* INCLUDE_SMALL_VECTOR_H_ */
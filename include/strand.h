@@ -0,0 +1,51 @@
+/*
+ * strand.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#ifndef INCLUDE_STRAND_H_
+#define INCLUDE_STRAND_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include "event_loop.h"
+
+namespace ael {
+
+// Runs the functions posted to it in order and never concurrently (e.g. the work of a session posted from many threads),
+// in the context of its event loop. Strands on different event loops run in parallel (see EventLoopGroup::CreateStrand()).
+// Posting does not take a lock - the poster that finds the strand idle schedules it on the event loop.
+// A strand runs at most Config::strand_batch_limit_ functions per event loop iteration (strands sharing an event loop take turns).
+class Strand : public std::enable_shared_from_this<Strand> {
+public:
+	static std::shared_ptr<Strand> Create(std::shared_ptr<EventLoop> event_loop);
+
+	virtual ~Strand();
+
+	// May be called from any thread.
+	void Post(std::function<void()> func);
+	// Runs func immediately if called from a function of this strand - otherwise it is posted.
+	void Dispatch(std::function<void()> func);
+
+	bool IsRunningInThisThread() const;
+	std::shared_ptr<EventLoop> GetEventLoop() const { return event_loop_; }
+
+private:
+	Strand(std::shared_ptr<EventLoop> event_loop);
+
+	void Schedule();
+	void Drain();
+
+	std::shared_ptr<EventLoop> event_loop_;
+	std::unique_ptr<class StrandQueue> queue_;
+	std::atomic<std::int64_t> pending_; // Posted functions that did not run yet (a post that makes it positive schedules the strand).
+};
+
+}
+
+#endif /* INCLUDE_STRAND_H_ */
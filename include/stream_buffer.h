@@ -8,11 +8,14 @@
 #ifndef INCLUDE_STREAM_BUFFER_H_
 #define INCLUDE_STREAM_BUFFER_H_
 
-#include <list>
 #include <atomic>
+#include <vector>
 
 #include "event.h"
 #include "data_view.h"
+#include "input_buffer.h"
+#include "ring_buffer.h"
+#include "small_vector.h"
 
 namespace ael {
 
@@ -20,12 +23,55 @@ class StreamBuffer;
 
 class StreamBufferHandler {
 public:
-	StreamBufferHandler() {}
+	enum DataMode { SAVED_DATA, BORROWED_DATA, BUFFERED_DATA };
+
+	StreamBufferHandler() : data_mode_(SAVED_DATA) {}
 	virtual ~StreamBufferHandler() {}
 
 	virtual void HandleData(std::shared_ptr<StreamBuffer> stream_buffer, const std::shared_ptr<const DataView> &data_view) = 0;
+	virtual void HandleBorrowedData(std::shared_ptr<StreamBuffer> stream_buffer, const DataView &data_view) { HandleData(stream_buffer, data_view.Retain()); }
+	virtual void HandleBufferedData(std::shared_ptr<StreamBuffer> stream_buffer, InputBuffer &input_buffer);
 	virtual void HandleConnected(std::shared_ptr<StreamBuffer> stream_buffer) = 0;
 	virtual void HandleEOF(std::shared_ptr<StreamBuffer> stream_buffer) = 0;
+	virtual void HandleBackpressure(std::shared_ptr<StreamBuffer>) {} // Queued write data is above the high watermark (producers should pause).
+	virtual void HandleWritable(std::shared_ptr<StreamBuffer>) {} // Queued write data drained to the low watermark (producers may resume).
+	// Handles passed by the peer of a Unix domain stream (called before the data they were sent with is handled).
+	// The handles are owned by the handler - the default implementation closes them.
+	virtual void HandleHandles(std::shared_ptr<StreamBuffer> stream_buffer, std::vector<Handle> handles);
+
+	DataMode GetDataMode() const { return data_mode_; }
+
+protected:
+	StreamBufferHandler(DataMode data_mode) : data_mode_(data_mode) {}
+
+private:
+	const DataMode data_mode_;
+};
+
+// Receives data borrowed from the stream buffer read path (no allocation and no copy per received chunk).
+// The data view is only valid for the duration of HandleBorrowedData(), call DataView::Retain() to keep it.
+class BorrowedStreamBufferHandler : public StreamBufferHandler {
+public:
+	BorrowedStreamBufferHandler() : StreamBufferHandler(BORROWED_DATA) {}
+	virtual ~BorrowedStreamBufferHandler() {}
+
+	void HandleBorrowedData(std::shared_ptr<StreamBuffer> stream_buffer, const DataView &data_view) override = 0;
+
+private:
+	void HandleData(std::shared_ptr<StreamBuffer> stream_buffer, const std::shared_ptr<const DataView> &data_view) override { HandleBorrowedData(stream_buffer, *data_view); }
+};
+
+// Received data is accumulated in a per stream input buffer. HandleBufferedData() is called whenever data is added,
+// data that is not consumed (e.g. a partial message) remains in the input buffer for the next call.
+class BufferedStreamBufferHandler : public StreamBufferHandler {
+public:
+	BufferedStreamBufferHandler() : StreamBufferHandler(BUFFERED_DATA) {}
+	virtual ~BufferedStreamBufferHandler() {}
+
+	void HandleBufferedData(std::shared_ptr<StreamBuffer> stream_buffer, InputBuffer &input_buffer) override = 0;
+
+private:
+	void HandleData(std::shared_ptr<StreamBuffer>, const std::shared_ptr<const DataView>&) override {} // Data is delivered by HandleBufferedData().
 };
 
 class OutResult {
@@ -44,19 +90,29 @@ private:
 
 class InResult {
 public:
-	InResult() : should_close_(false) {}
-	InResult(const std::uint8_t *buf, std::uint32_t buf_size) : should_close_(false), data_view(DataView(buf, buf_size).Save()) {}
+	InResult() : should_close_(false), borrowed_data_(nullptr), borrowed_data_length_(0) {}
+	InResult(const std::uint8_t *buf, std::uint32_t buf_size) : should_close_(false), borrowed_data_(nullptr), borrowed_data_length_(0), data_view(DataView(buf, buf_size).Save()) {}
 
 	bool ShouldCloseRead() const { return should_close_; }
-	bool HasData() const { return data_view && data_view->GetDataLength() > 0; }
-	std::shared_ptr<const DataView> GetData() const { return data_view; }
+	bool HasData() const { return borrowed_data_length_ > 0 || (data_view && data_view->GetDataLength() > 0); }
+	std::shared_ptr<const DataView> GetData() const { return borrowed_data_ ? GetBorrowedData().Save() : data_view; }
+	DataView GetBorrowedData() const { return borrowed_data_ ? DataView(borrowed_data_, borrowed_data_length_) : (data_view ? *data_view : DataView()); }
 
 	static InResult CreateShouldClose() { return InResult(true); }
+	// The data is not copied - it must remain valid until the filter that returned the result is called again.
+	static InResult CreateBorrowed(const DataView &data_view) {
+		InResult in_result;
+		in_result.borrowed_data_ = data_view.GetData();
+		in_result.borrowed_data_length_ = data_view.GetDataLength();
+		return in_result;
+	}
 
 private:
-	InResult(bool should_close) : should_close_(should_close) {}
+	InResult(bool should_close) : should_close_(should_close), borrowed_data_(nullptr), borrowed_data_length_(0) {}
 
 	bool should_close_;
+	const std::uint8_t *borrowed_data_;
+	int borrowed_data_length_;
 	std::shared_ptr<const DataView> data_view;
 };
 
@@ -101,14 +157,26 @@ protected:
 
 	InResult PrevIn() const { return prev_->In(); }
 	OutResult PrevOut(std::shared_ptr<const DataView> &data_view) const { return prev_->Out(data_view); }
+	bool HasMoreOut() const; // More data (queued in this filter or in the filters above it) follows the data being written.
+	// Received data is being handled on this thread (e.g. a data handler runs an event loop) - data it borrowed is still in use.
+	static bool IsHandlingData();
+	bool IsZeroCopy() const { return zerocopy_; }
+	// Writes are flushed in batches (see StreamBuffer::SetDeferredFlush()) - the transport may hold back data that more data follows.
+	bool IsBatched() const { return batched_; }
+	// Every write must be of this length (e.g. an eventfd) - writes of another length are rejected by StreamBuffer::Write().
+	void SetWriteLength(std::uint32_t write_length) { write_length_ = write_length; }
 
 	void HandleData(const std::shared_ptr<const DataView> &data_view);
+	void HandleData(const InResult &in_result);
+	void HandleHandles(std::vector<Handle> handles);
 
 	virtual InResult In() = 0;
 	virtual OutResult Out(std::shared_ptr<const DataView> &data_view) = 0;
 	virtual ShutdownResult Shutdown() = 0;
 	virtual ConnectResult Connect() = 0;
 	virtual ConnectResult Accept() = 0;
+	virtual void Error() {} // The handle has an error event (e.g. transmit completion notifications).
+	virtual OutResult OutFile(std::shared_ptr<const DataView> &file_segment); // Transmits a file segment (the default reads it and calls Out).
 
 private:
 	bool connected_;
@@ -119,9 +187,14 @@ private:
 	std::weak_ptr<StreamBuffer> stream_buffer_;
 	const std::uint64_t id_;
 	std::uint32_t order_;
-	std::list<std::shared_ptr<const DataView>> pending_out_;
-
-	void Write(const std::list<std::shared_ptr<const DataView>> &write_list);
+	RingBuffer<std::shared_ptr<const DataView>> pending_out_;
+	std::uint64_t pending_out_bytes_;
+	bool zerocopy_;
+	std::atomic_bool batched_;
+	std::uint32_t write_length_; // 0 - any length.
+
+	void Write(std::shared_ptr<const DataView> data_view);
+	void Flush();
 	void Read();
 	void Close();
 	Events GetEvents() const;
@@ -131,18 +204,60 @@ private:
 
 class StreamBuffer: public EventHandler, public std::enable_shared_from_this<StreamBuffer> {
 public:
+	// The kind of a pipe handle - DETECT_PIPE looks the handle up in /proc/self/fd (without /proc an eventfd is not detected
+	// and should be declared as EVENTFD_PIPE).
+	enum PipeKind { DETECT_PIPE, STREAM_PIPE, EVENTFD_PIPE };
+
 	static std::shared_ptr<StreamBuffer> CreateForClient(std::shared_ptr<StreamBufferHandler> stream_buffer_handler, Handle handle);
+	// ip_addr may also be a Unix domain socket path (or an abstract socket address starting with '@' - the port is ignored).
 	static std::shared_ptr<StreamBuffer> CreateForClient(std::shared_ptr<StreamBufferHandler> stream_buffer_handler, const std::string &ip_addr, std::uint16_t port);
 	static std::shared_ptr<StreamBuffer> CreateForServer(std::shared_ptr<StreamBufferHandler> stream_buffer_handler, Handle handle);
+	// A non socket handle - a pipe, a character device (e.g. a tty or stdin) or an eventfd - read and written with read/write.
+	// The handle is set to non blocking (restored once the stream buffer is destroyed - the open file description may be shared)
+	// and is owned by the stream buffer (closed once it is destroyed). A read only handle (e.g. the read end of a pipe)
+	// is connected on its first event (data or the writer closing). The stream reaches EOF once the other end is closed.
+	// A write to a pipe without a reader does not raise SIGPIPE (if SIGPIPE is not ignored once the stream is created, it is
+	// blocked during each write). An eventfd is written 8 bytes (a counter value) at a time.
+	static std::shared_ptr<StreamBuffer> CreateForPipe(std::shared_ptr<StreamBufferHandler> stream_buffer_handler, Handle handle, PipeKind pipe_kind = DETECT_PIPE);
+
+	virtual ~StreamBuffer();
 
 	friend std::ostream& operator<<(std::ostream &out, const StreamBuffer *stream_buffer);
 
 	void Write(const DataView &data_view);
+	// Writes data with handles attached - the peer of a Unix domain stream receives duplicates of the handles (SCM_RIGHTS).
+	// The handles are duplicated (the caller may close them once Write returns). Not supported through stream filters.
+	void Write(const DataView &data_view, const std::vector<Handle> &handles);
+	// Writes a range of a file (sendfile when the stream has no filters, otherwise read and written in chunks).
+	void WriteFile(Handle file_handle, std::uint64_t offset, std::uint64_t length);
 	void Close();
 	void AddStreamBufferFilter(std::shared_ptr<StreamBufferFilter> stream_filter);
 
+	// Bytes written and not yet handed to the kernel (may be called from any thread).
+	std::uint64_t GetQueuedBytes() const { return pending_writes_bytes_ + pending_out_bytes_; }
+	void SetWriteWatermarks(std::uint64_t low_watermark, std::uint64_t high_watermark);
+
+	// Stop/restart reading from the stream (may be called from any thread) - while paused the peer is pushed back by TCP flow control.
+	void PauseRead();
+	void ResumeRead();
+
+	// Large writes (see Config::zerocopy_threshold_) are transmitted without copying them into the kernel (MSG_ZEROCOPY).
+	// Falls back to a regular send if the kernel copies anyway. Should be called before attaching the stream buffer.
+	void SetZeroCopy(bool zerocopy);
+
+	// Writes made in the context of the event loop are flushed once the current handler returns (without waking up the event
+	// loop). When enabled, the writes of a flush are packed into full segments (MSG_MORE - the last write of the flush is sent
+	// without it).
+	void SetDeferredFlush(bool deferred_flush);
+
+	// Pumps the data received by this stream buffer to stream_buffer and vice versa (e.g. a proxy) until either one closes.
+	// Both stream buffers must be connected and attached to the same event loop, and it must be called in its context.
+	// Without filters the data is moved within the kernel (splice) and a read EOF is propagated as a write shutdown (half close),
+	// otherwise it is written by the stream buffers (a paused reader when the other side is above its high watermark).
+	void SpliceTo(std::shared_ptr<StreamBuffer> stream_buffer);
+
 private:
-	enum StreamBufferMode { SERVER_MODE, CLIENT_MODE };
+	enum StreamBufferMode { SERVER_MODE, CLIENT_MODE, PIPE_MODE };
 
 	static std::shared_ptr<StreamBuffer> Create(std::shared_ptr<StreamBufferHandler> stream_buffer_handler, Handle handle, StreamBufferMode mode);
 
@@ -153,23 +268,39 @@ private:
 
 	void DoRead();
 	void DoWrite();
+	void DoError();
 	void DoClose();
 	void DoConnect(std::shared_ptr<StreamBufferHandler> stream_buffer_handler);
 	void DoFinalize(std::shared_ptr<StreamBufferHandler> stream_buffer_handler);
+	void DeferFlush();
+	void ScheduleWrite();
 	bool IsConnected() const;
 	bool IsReadClosed() const;
 	bool IsWriteClosed() const;
+	bool HasPendingWrites() const; // Written data that was not handed to the kernel.
 
 	std::weak_ptr<StreamBufferHandler> stream_buffer_handler_;
-	std::list<std::shared_ptr<StreamBufferFilter>> stream_filters_;
-	std::list<std::shared_ptr<const DataView>> pending_writes_;
-	std::mutex pending_writes_lock_;
+	SmallVector<std::shared_ptr<StreamBufferFilter>, 2> stream_filters_; // The transport filter and (typically) a single filter above it are stored inline.
+	std::unique_ptr<class WriteQueue> write_queue_;
+	InputBuffer input_buffer_;
 	bool add_filter_allowed_;
 	bool eof_called_;
 	std::atomic_bool should_close_;
 	StreamBufferMode mode_;
+	std::atomic_bool read_paused_;
+	bool read_interest_paused_;
+	std::atomic<std::uint64_t> pending_writes_bytes_;
+	std::atomic<std::uint64_t> pending_out_bytes_;
+	std::atomic<std::uint64_t> write_low_watermark_;
+	std::atomic<std::uint64_t> write_high_watermark_;
+	bool write_backpressured_;
+	bool flush_deferred_;
+	bool handling_events_;
+	bool written_while_handling_;
+	std::shared_ptr<class Splice> splice_;
 
 	friend StreamBufferFilter;
+	friend Splice;
 	//TODO IMPORTANT!!! handle starvation...
 };
 
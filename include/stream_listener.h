@@ -28,6 +28,7 @@ public:
 
 	friend std::ostream& operator<<(std::ostream &out, const StreamListener *stream_listener);
 
+	// ip_addr may also be a Unix domain socket path (or an abstract socket address starting with '@' - the port is ignored).
 	static std::shared_ptr<StreamListener> Create(std::shared_ptr<NewConnectionHandler> new_connection_handler, const std::string &ip_addr, std::uint16_t port);
 
 private:
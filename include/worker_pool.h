@@ -0,0 +1,69 @@
+/*
+ * worker_pool.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#ifndef INCLUDE_WORKER_POOL_H_
+#define INCLUDE_WORKER_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ael {
+
+// A pool of threads for CPU bound work (e.g. compression, crypto, parsing) that should not run in the context of an event loop
+// (see EventLoop::Offload). Each thread has its own queue - idle threads steal work queued to the other threads.
+class WorkerPool {
+public:
+	// queue_limit bounds the work that is queued and not yet running (threads 0 - the hardware concurrency).
+	static std::shared_ptr<WorkerPool> Create(std::uint32_t threads, std::uint64_t queue_limit);
+	// Shared by the library (Config::worker_threads_ and Config::worker_queue_limit_) - created on first use.
+	static std::shared_ptr<WorkerPool> GetDefault();
+
+	// Work that is still queued is dropped - running work is waited for.
+	virtual ~WorkerPool();
+
+	// May be called from any thread. Returns false (the work is dropped) if the queue limit is reached.
+	// Work submitted by a worker thread is queued to that thread. Exceptions thrown by the work are logged and ignored.
+	bool TrySubmit(std::function<void()> work);
+
+	std::uint32_t GetThreads() const { return static_cast<std::uint32_t>(workers_.size()); }
+	std::uint64_t GetQueueLimit() const { return queue_limit_; }
+	std::uint64_t GetQueued() const { return queued_; }
+	std::uint32_t GetActive() const { return active_; }
+	std::uint64_t GetCompleted() const { return completed_; }
+	std::uint64_t GetStolen() const { return stolen_; }
+	std::uint64_t GetRejected() const { return rejected_; }
+
+private:
+	WorkerPool(std::uint32_t threads, std::uint64_t queue_limit);
+
+	void Run(std::uint32_t index);
+	bool Take(std::uint32_t index, std::function<void()> &work);
+
+	std::vector<std::unique_ptr<class Worker>> workers_;
+	std::vector<std::thread> threads_;
+	const std::uint64_t queue_limit_;
+	std::atomic<std::uint64_t> queued_;
+	std::atomic<std::uint32_t> active_;
+	std::atomic<std::uint64_t> completed_;
+	std::atomic<std::uint64_t> stolen_;
+	std::atomic<std::uint64_t> rejected_;
+	std::atomic<std::uint32_t> next_; // Round robin over the workers for work submitted by other threads.
+	std::atomic<std::uint32_t> sleeping_;
+	std::atomic_bool stop_;
+	std::mutex sleep_lock_;
+	std::condition_variable sleep_cond_;
+};
+
+}
+
+#endif /* INCLUDE_WORKER_POOL_H_ */
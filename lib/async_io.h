@@ -20,14 +20,16 @@ public:
 	AsyncIO() {}
 	virtual ~AsyncIO() {}
 
-	static std::unique_ptr<AsyncIO> Create();
+	static std::unique_ptr<AsyncIO> Create(bool single_thread); // single_thread - all the calls are made by a single thread (no locks).
 
 	virtual void Add(std::shared_ptr<Event> event) = 0; // Add (register) an event.
 	virtual void Modify(std::shared_ptr<Event> event) = 0; // Modify the "state" of the event.
-	virtual void Ready(std::shared_ptr<Event> event, Events events) = 0; // Makes (an already registered) event ready (if no longer registers - should ignore).
+	virtual void Ready(std::shared_ptr<Event> event) = 0; // Makes (an already registered) event ready with its pending ready events (if no longer registers - should ignore).
 	virtual void Remove(std::shared_ptr<Event> event) = 0; // Remove (unregister) an event.
 	virtual void Wakeup() = 0; // Unblock "Process()".
-	virtual void Process() = 0; // Process() "registered" events.
+	virtual void Process(int timeout_ms) = 0; // Process() "registered" events (timeout_ms -1 - blocks until there are events).
+	virtual void Suspend() = 0; // Process() is not called until the handle is readable - elements added from now on wake it up.
+	virtual Handle GetHandle() const = 0; // Readable when Process() has events to process.
 };
 
 }
@@ -0,0 +1,231 @@
+/*
+ * async_sync.cc
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#include "config.h"
+#include "async_sync.h"
+#include "log.h"
+
+namespace ael {
+
+using detail::AsyncWaiter;
+
+static AsyncWaiter CreateWaiter(std::shared_ptr<EventLoop> event_loop, std::function<void()> callback) {
+	if (!event_loop) {
+		throw "async wait called outside the scope of an event loop";
+	}
+
+	return AsyncWaiter{ event_loop, std::move(callback) };
+}
+
+// Returns false if the event loop has been stopped or destroyed (the callback is never run).
+static bool Resume(AsyncWaiter &waiter) {
+	auto event_loop = waiter.event_loop.lock();
+	if (!event_loop || event_loop->IsStopped()) {
+		LOG_DEBUG("async waiter cannot be resumed - event loop has been stopped");
+		return false;
+	}
+
+	event_loop->Post(std::move(waiter.callback));
+	return true;
+}
+
+// A unit handed to a waiter - released again if the posted callback is destroyed without running (the event loop was stopped
+// after the waiter was resumed).
+class AsyncSemaphoreUnit {
+public:
+	AsyncSemaphoreUnit(std::shared_ptr<AsyncSemaphore> semaphore) : semaphore_(std::move(semaphore)) {}
+	~AsyncSemaphoreUnit() {
+		if (semaphore_) {
+			semaphore_->Release();
+		}
+	}
+
+	void Take() { semaphore_.reset(); }
+
+private:
+	std::shared_ptr<AsyncSemaphore> semaphore_;
+};
+
+// The callback of the waiter owns the unit until it runs.
+static std::shared_ptr<AsyncSemaphoreUnit> HoldUnit(AsyncWaiter &waiter, std::shared_ptr<AsyncSemaphore> semaphore) {
+	auto unit = std::make_shared<AsyncSemaphoreUnit>(std::move(semaphore));
+	auto callback = std::move(waiter.callback);
+	waiter.callback = [unit, callback]() {
+		unit->Take();
+		callback();
+	};
+	return unit;
+}
+
+std::shared_ptr<AsyncSemaphore> AsyncSemaphore::Create(std::uint64_t count) {
+	return std::shared_ptr<AsyncSemaphore>(new AsyncSemaphore(count));
+}
+
+void AsyncSemaphore::Acquire(std::function<void()> callback) {
+	Acquire(EventLoop::Current(), std::move(callback));
+}
+
+void AsyncSemaphore::Acquire(std::shared_ptr<EventLoop> event_loop, std::function<void()> callback) {
+	auto waiter = CreateWaiter(event_loop, std::move(callback));
+	if (event_loop->IsStopped()) {
+		LOG_DEBUG("async semaphore is not acquired - event loop has been stopped");
+		return;
+	}
+
+	lock_.lock();
+	// Waiters go first - a release hands its unit to the first waiter.
+	if (count_ > 0 && waiters_.empty()) {
+		count_--;
+		lock_.unlock();
+		if (EventLoop::Current() == event_loop) {
+			waiter.callback();
+			return;
+		}
+
+		// Posted - if the event loop stops first, the unit is released once the callback is destroyed.
+		HoldUnit(waiter, shared_from_this());
+		Resume(waiter);
+		return;
+	}
+	waiters_.push_back(std::move(waiter));
+	lock_.unlock();
+}
+
+bool AsyncSemaphore::TryAcquire() {
+	std::lock_guard<std::mutex> guard(lock_);
+	if (count_ > 0 && waiters_.empty()) {
+		count_--;
+		return true;
+	}
+	return false;
+}
+
+void AsyncSemaphore::Release() {
+	// The unit is handed to the first waiter that can be resumed.
+	for (;;) {
+		lock_.lock();
+		if (waiters_.empty()) {
+			count_++;
+			lock_.unlock();
+			return;
+		}
+		auto waiter = std::move(waiters_.front());
+		waiters_.pop_front();
+		lock_.unlock();
+
+		auto unit = HoldUnit(waiter, shared_from_this());
+		if (Resume(waiter)) {
+			return;
+		}
+		unit->Take();
+	}
+}
+
+std::uint64_t AsyncSemaphore::GetAvailable() const {
+	std::lock_guard<std::mutex> guard(lock_);
+	return count_;
+}
+
+std::uint64_t AsyncSemaphore::GetWaiters() const {
+	std::lock_guard<std::mutex> guard(lock_);
+	return waiters_.size();
+}
+
+std::shared_ptr<AsyncMutex> AsyncMutex::Create() {
+	return std::shared_ptr<AsyncMutex>(new AsyncMutex());
+}
+
+std::shared_ptr<AsyncLatch> AsyncLatch::Create(std::uint64_t count) {
+	return std::shared_ptr<AsyncLatch>(new AsyncLatch(count));
+}
+
+void AsyncLatch::CountDown(std::uint64_t n) {
+	std::deque<AsyncWaiter> waiters;
+
+	lock_.lock();
+	if (count_ == 0) {
+		lock_.unlock();
+		return;
+	}
+	count_ = n < count_ ? count_ - n : 0;
+	if (count_ == 0) {
+		waiters.swap(waiters_);
+	}
+	lock_.unlock();
+
+	for (auto &waiter : waiters) {
+		Resume(waiter);
+	}
+}
+
+void AsyncLatch::Wait(std::function<void()> callback) {
+	Wait(EventLoop::Current(), std::move(callback));
+}
+
+void AsyncLatch::Wait(std::shared_ptr<EventLoop> event_loop, std::function<void()> callback) {
+	auto waiter = CreateWaiter(event_loop, std::move(callback));
+
+	lock_.lock();
+	if (count_ == 0) {
+		lock_.unlock();
+		event_loop->Dispatch(std::move(waiter.callback));
+		return;
+	}
+	waiters_.push_back(std::move(waiter));
+	lock_.unlock();
+}
+
+std::uint64_t AsyncLatch::GetCount() const {
+	std::lock_guard<std::mutex> guard(lock_);
+	return count_;
+}
+
+std::shared_ptr<AsyncEvent> AsyncEvent::Create() {
+	return std::shared_ptr<AsyncEvent>(new AsyncEvent());
+}
+
+void AsyncEvent::Set() {
+	std::deque<AsyncWaiter> waiters;
+
+	lock_.lock();
+	set_ = true;
+	waiters.swap(waiters_);
+	lock_.unlock();
+
+	for (auto &waiter : waiters) {
+		Resume(waiter);
+	}
+}
+
+void AsyncEvent::Reset() {
+	std::lock_guard<std::mutex> guard(lock_);
+	set_ = false;
+}
+
+void AsyncEvent::Wait(std::function<void()> callback) {
+	Wait(EventLoop::Current(), std::move(callback));
+}
+
+void AsyncEvent::Wait(std::shared_ptr<EventLoop> event_loop, std::function<void()> callback) {
+	auto waiter = CreateWaiter(event_loop, std::move(callback));
+
+	lock_.lock();
+	if (set_) {
+		lock_.unlock();
+		event_loop->Dispatch(std::move(waiter.callback));
+		return;
+	}
+	waiters_.push_back(std::move(waiter));
+	lock_.unlock();
+}
+
+bool AsyncEvent::IsSet() const {
+	std::lock_guard<std::mutex> guard(lock_);
+	return set_;
+}
+
+}
@@ -0,0 +1,369 @@
+/*
+ * child_process.cc
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#include "config.h"
+#include "child_process.h"
+#include "event_loop.h"
+#include "log.h"
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+
+#ifdef HAVE_SIGNAL_H
+#include <signal.h>
+#endif
+
+#ifdef HAVE_SPAWN_H
+#include <spawn.h>
+#endif
+
+#ifdef HAVE_SYS_WAIT_H
+#include <sys/wait.h>
+#endif
+
+#ifdef HAVE_SYS_SYSCALL_H
+#include <sys/syscall.h>
+#endif
+
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+extern char **environ;
+
+namespace ael {
+
+bool ChildExit::IsExited() const {
+	return WIFEXITED(status_);
+}
+
+int ChildExit::GetExitCode() const {
+	return WEXITSTATUS(status_);
+}
+
+bool ChildExit::IsSignaled() const {
+	return WIFSIGNALED(status_);
+}
+
+int ChildExit::GetSignal() const {
+	return WTERMSIG(status_);
+}
+
+static std::vector<char*> ToArgs(const std::vector<std::string> &strings) {
+	std::vector<char*> args;
+	args.reserve(strings.size() + 1);
+	for (auto &str : strings) {
+		args.push_back(const_cast<char*>(str.c_str()));
+	}
+	args.push_back(nullptr);
+	return args;
+}
+
+// The child end and the parent end of a pipe of a piped stream.
+class StdioPipe {
+public:
+	StdioPipe(bool piped, bool child_reads) : child_(-1), parent_(-1) {
+		if (!piped) {
+			return;
+		}
+
+		int fds[2];
+		if (pipe2(fds, O_CLOEXEC) != 0) {
+			throw std::system_error(errno, std::system_category(), "pipe2 failed");
+		}
+
+		child_ = child_reads ? fds[0] : fds[1];
+		parent_ = child_reads ? fds[1] : fds[0];
+	}
+
+	~StdioPipe() {
+		CloseChild();
+		if (parent_ >= 0) {
+			close(parent_);
+		}
+	}
+
+	void CloseChild() {
+		if (child_ >= 0) {
+			close(child_);
+			child_ = -1;
+		}
+	}
+
+	int TakeParent() {
+		auto parent = parent_;
+		parent_ = -1;
+		return parent;
+	}
+
+	int child_;
+	int parent_;
+};
+
+class SpawnFileActions {
+public:
+	SpawnFileActions() { posix_spawn_file_actions_init(&file_actions); }
+	~SpawnFileActions() { posix_spawn_file_actions_destroy(&file_actions); }
+
+	void Dup(const StdioPipe &stdio_pipe, int fd) {
+		// dup2() clears close-on-exec of the child end.
+		if (stdio_pipe.child_ >= 0) {
+			posix_spawn_file_actions_adddup2(&file_actions, stdio_pipe.child_, fd);
+		}
+	}
+
+	// Descriptors of the application that are not close-on-exec would otherwise be inherited by the child (and a pipe stays open
+	// as long as the child runs). Without support only the descriptors of the library are close-on-exec.
+	void CloseOthers() {
+#ifdef HAVE_POSIX_SPAWN_CLOSEFROM
+		posix_spawn_file_actions_addclosefrom_np(&file_actions, STDERR_FILENO + 1);
+#endif
+	}
+
+	posix_spawn_file_actions_t file_actions;
+};
+
+// The child starts with no blocked signals (see SignalHandler) and SIGPIPE set to default (even if ignored by the application).
+class SpawnAttr {
+public:
+	SpawnAttr() {
+		posix_spawnattr_init(&attr);
+
+		sigset_t mask;
+		sigemptyset(&mask);
+		posix_spawnattr_setsigmask(&attr, &mask);
+
+		sigset_t default_mask;
+		sigemptyset(&default_mask);
+		sigaddset(&default_mask, SIGPIPE);
+		posix_spawnattr_setsigdefault(&attr, &default_mask);
+
+		posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+	}
+	~SpawnAttr() { posix_spawnattr_destroy(&attr); }
+
+	posix_spawnattr_t attr;
+};
+
+static int PidFdOpen(pid_t pid) {
+#ifdef HAVE_PIDFD_OPEN
+	return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#else
+	(void)pid;
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+std::shared_ptr<ChildProcess> ChildProcess::Spawn(const std::vector<std::string> &argv, const ChildProcessOptions &options, ChildExitCallback callback) {
+	if (argv.empty()) {
+		throw "no program to spawn";
+	}
+
+	StdioPipe stdin_pipe(options.pipe_stdin_, true);
+	StdioPipe stdout_pipe(options.pipe_stdout_, false);
+	StdioPipe stderr_pipe(options.pipe_stderr_, false);
+
+	SpawnFileActions spawn_file_actions;
+	spawn_file_actions.Dup(stdin_pipe, STDIN_FILENO);
+	spawn_file_actions.Dup(stdout_pipe, STDOUT_FILENO);
+	spawn_file_actions.Dup(stderr_pipe, STDERR_FILENO);
+	spawn_file_actions.CloseOthers();
+
+	SpawnAttr spawn_attr;
+
+	auto args = ToArgs(argv);
+	auto env = ToArgs(options.env_);
+
+	// glibc spawns with vfork semantics (the memory of this process is not copied) - spawning is cheap regardless of its size.
+	pid_t pid;
+	auto ret = posix_spawnp(&pid, args[0], &spawn_file_actions.file_actions, &spawn_attr.attr, args.data(), options.env_.empty() ? environ : env.data());
+	if (ret != 0) {
+		throw std::system_error(ret, std::system_category(), "posix_spawnp failed");
+	}
+
+	stdin_pipe.CloseChild();
+	stdout_pipe.CloseChild();
+	stderr_pipe.CloseChild();
+
+	// The child is not reaped until it is waited for - its pid cannot be reused before the pidfd is opened.
+	auto fd = PidFdOpen(pid);
+	if (fd < 0) {
+		auto error = errno;
+		kill(pid, SIGKILL);
+		waitpid(pid, nullptr, 0);
+		throw std::system_error(error, std::system_category(), "pidfd_open failed");
+	}
+
+	LOG_DEBUG("child process is spawned pid=" << pid << " program=" << argv[0]);
+
+	return std::shared_ptr<ChildProcess>(new ChildProcess(fd, static_cast<std::uint32_t>(pid), stdin_pipe.TakeParent(), stdout_pipe.TakeParent(), stderr_pipe.TakeParent(), callback));
+}
+
+// Reaps a child once it exits after its ChildProcess was destroyed - nothing else may reap it.
+class ChildReaper : public EventHandler, public std::enable_shared_from_this<ChildReaper> {
+public:
+	ChildReaper(Handle handle, std::uint32_t pid) : EventHandler(handle), pid_(pid) {}
+	virtual ~ChildReaper() {}
+
+	static void Create(std::shared_ptr<EventLoop> event_loop, Handle handle, std::uint32_t pid) {
+		// The child process closes its handle - the duplicate is watched until the child exits.
+		auto fd = fcntl(handle, F_DUPFD_CLOEXEC, 0);
+		if (fd < 0) {
+			LOG_WARN("child reaper cannot duplicate the handle - the child is not reaped pid=" << pid << " error=" << std::strerror(errno));
+			return;
+		}
+
+		auto child_reaper = std::make_shared<ChildReaper>(fd, pid);
+		child_reaper->event_loop_ = event_loop;
+
+		LOG_DEBUG("child reaper pid=" << pid);
+
+		event_loop->AttachInternal(child_reaper);
+	}
+
+private:
+	void HandleEvents(Handle, Events) override {
+		pid_t ret;
+		do {
+			ret = waitpid(static_cast<pid_t>(pid_), nullptr, WNOHANG);
+		} while (ret < 0 && errno == EINTR);
+
+		if (ret == 0) {
+			return;
+		}
+
+		LOG_DEBUG("child reaper reaped pid=" << pid_);
+
+		CloseEvent();
+
+		auto event_loop = event_loop_.lock();
+		if (event_loop) {
+			event_loop->RemoveInternal(shared_from_this());
+		}
+	}
+
+	Events GetEvents() const override { return Events::Read; }
+
+	const std::uint32_t pid_;
+	std::weak_ptr<EventLoop> event_loop_;
+};
+
+std::ostream& operator<<(std::ostream &out, const ChildProcess *child_process) {
+	const EventHandler *event_handler = child_process;
+	out << event_handler << " pid=" << child_process->pid_ << " exited=" << child_process->exited_;
+	return out;
+}
+
+ChildProcess::ChildProcess(Handle handle, std::uint32_t pid, Handle stdin_handle, Handle stdout_handle, Handle stderr_handle, ChildExitCallback callback) :
+		EventHandler(handle),
+		pid_(pid),
+		stdin_handle_(stdin_handle),
+		stdout_handle_(stdout_handle),
+		stderr_handle_(stderr_handle),
+		callback_(callback),
+		exited_(false) {
+	LOG_TRACE("child process is created " << this);
+}
+
+ChildProcess::~ChildProcess() {
+	LOG_TRACE("child process is destroyed " << this);
+
+	for (auto handle : { stdin_handle_, stdout_handle_, stderr_handle_ }) {
+		if (handle) {
+			handle.Close();
+		}
+	}
+
+	if (exited_ || waitpid(static_cast<pid_t>(pid_), nullptr, WNOHANG) != 0) {
+		return;
+	}
+
+	auto event_loop = GetEventLoop();
+	if (!event_loop || event_loop->IsStopped()) {
+		LOG_WARN("child process is destroyed before it exited - it is not reaped (not attached) " << this);
+		return;
+	}
+	ChildReaper::Create(event_loop, GetHandle(), pid_);
+}
+
+Handle ChildProcess::Take(Handle &handle) {
+	auto taken = handle;
+	handle = Handle();
+	return taken;
+}
+
+Handle ChildProcess::TakeStdin() {
+	return Take(stdin_handle_);
+}
+
+Handle ChildProcess::TakeStdout() {
+	return Take(stdout_handle_);
+}
+
+Handle ChildProcess::TakeStderr() {
+	return Take(stderr_handle_);
+}
+
+void ChildProcess::Kill(int signal) {
+	if (exited_) {
+		LOG_DEBUG("child process kill ignored - exited " << this);
+		return;
+	}
+
+#ifdef HAVE_PIDFD_SEND_SIGNAL
+	// Unlike kill(), a pidfd cannot refer to another process that reused the pid.
+	auto ret = syscall(SYS_pidfd_send_signal, static_cast<int>(GetHandle()), signal, nullptr, 0);
+#else
+	auto ret = kill(static_cast<pid_t>(pid_), signal); // The child is not reaped until it exited - the pid is not reused.
+#endif
+	if (ret != 0 && errno != ESRCH) {
+		throw std::system_error(errno, std::system_category(), "pidfd_send_signal failed");
+	}
+}
+
+void ChildProcess::HandleEvents(Handle, Events events) {
+	LOG_TRACE("handling events " << this << " events=" << events);
+
+	if (exited_ || !(events & Events::Read)) {
+		return;
+	}
+
+	int status;
+	pid_t ret;
+	do {
+		ret = waitpid(static_cast<pid_t>(pid_), &status, WNOHANG);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret == 0) {
+		LOG_TRACE("child process has not exited " << this);
+		return;
+	}
+
+	if (ret < 0) {
+		throw std::system_error(errno, std::system_category(), "waitpid failed");
+	}
+
+	exited_ = true;
+
+	LOG_DEBUG("child process exited " << this << " status=" << status);
+
+	CloseEvent();
+
+	callback_(ChildExit(pid_, status));
+}
+
+Events ChildProcess::GetEvents() const {
+	return Events::Read;
+}
+
+}
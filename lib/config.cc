@@ -16,7 +16,20 @@ Config::Config() :
 		listen_starvation_limit_(50),
 		read_starvation_limit_(1048576),
 		write_starvation_limit_(1048576),
-		interval_occurrences_limit_(10)
+		read_buffer_size_(100000),
+		write_low_watermark_(1048576),
+		write_high_watermark_(4194304),
+		zerocopy_threshold_(65536),
+		interval_occurrences_limit_(10),
+		datagram_batch_size_(32),
+		datagram_receive_size_(4096),
+		datagram_starvation_limit_(16),
+		file_io_queue_depth_(64),
+		file_io_threads_(4),
+		file_io_uring_(true),
+		worker_threads_(0),
+		worker_queue_limit_(65536),
+		strand_batch_limit_(64)
 		{}
 
 Config::~Config() {}
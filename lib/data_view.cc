@@ -8,6 +8,7 @@
 #include "data_view.h"
 
 #include <cstring>
+#include <stdexcept>
 
 namespace ael {
 
@@ -0,0 +1,44 @@
+/*
+ * datagram_queue.cc
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#include "datagram_queue.h"
+
+#include <cstring>
+#include <new>
+
+namespace ael {
+
+PendingDatagram* PendingDatagram::Create(const DataView &data_view, const SocketAddress &destination) {
+	auto data_length = data_view.GetDataLength();
+	auto memory = static_cast<std::uint8_t*>(::operator new(sizeof(PendingDatagram) + data_length));
+
+	std::memcpy(memory + sizeof(PendingDatagram), data_view.GetData(), data_length);
+
+	return new (memory) PendingDatagram(destination, data_length);
+}
+
+void PendingDatagram::Destroy() {
+	this->~PendingDatagram();
+	::operator delete(this);
+}
+
+DatagramQueue::~DatagramQueue() {
+	PendingDatagram *pending_datagram;
+	while ((pending_datagram = queue_.Pop()) != nullptr) {
+		pending_datagram->Destroy();
+	}
+}
+
+void DatagramQueue::Push(const DataView &data_view, const SocketAddress &destination) {
+	queue_.Push(PendingDatagram::Create(data_view, destination));
+}
+
+PendingDatagram* DatagramQueue::Pop() {
+	return queue_.Pop();
+}
+
+}
@@ -0,0 +1,50 @@
+/*
+ * datagram_queue.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#ifndef LIB_DATAGRAM_QUEUE_H_
+#define LIB_DATAGRAM_QUEUE_H_
+
+#include "mpsc_queue.h"
+#include "datagram_socket.h"
+
+namespace ael {
+
+// A datagram queued for sending - the queue node, the destination and the (copied) data share a single allocation.
+class PendingDatagram : public MPSCNode {
+public:
+	static PendingDatagram* Create(const DataView &data_view, const SocketAddress &destination);
+
+	const std::uint8_t* GetData() const { return reinterpret_cast<const std::uint8_t*>(this + 1); }
+	int GetDataLength() const { return data_length_; }
+	const SocketAddress& GetDestination() const { return destination_; }
+
+	void Destroy();
+
+private:
+	PendingDatagram(const SocketAddress &destination, int data_length) : destination_(destination), data_length_(data_length) {}
+	~PendingDatagram() {}
+
+	const SocketAddress destination_;
+	const int data_length_;
+};
+
+// Datagrams may be pushed from any thread. Popped in the context of the event loop.
+class DatagramQueue {
+public:
+	DatagramQueue() {}
+	virtual ~DatagramQueue();
+
+	void Push(const DataView &data_view, const SocketAddress &destination);
+	PendingDatagram* Pop(); // nullptr if empty - the popped datagram should be destroyed once sent.
+
+private:
+	MPSCQueue<PendingDatagram> queue_;
+};
+
+}
+
+#endif /* LIB_DATAGRAM_QUEUE_H_ */
@@ -0,0 +1,488 @@
+/*
+ * datagram_socket.cc
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#include "config.h"
+#include "datagram_socket.h"
+#include "datagram_queue.h"
+#include "log.h"
+
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+
+#ifdef HAVE_SYS_SOCKET_H
+#include <sys/socket.h>
+#endif
+
+#ifdef HAVE_ARPA_INET_H
+#include <arpa/inet.h>
+#endif
+
+#ifdef HAVE_NETINET_UDP_H
+#include <netinet/udp.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+#include <system_error>
+
+namespace ael {
+
+static_assert(sizeof(sockaddr_in6) <= 28, "socket address storage is too small");
+
+// Coalesced (GRO) datagrams and segmented (GSO) sends are limited to the maximum UDP payload.
+static const std::uint32_t max_offload_length = 65507;
+static const std::uint32_t max_segments = 64;
+
+// The message headers (and receive buffers) of a recvmmsg or sendmmsg batch - allocated once per socket.
+struct DatagramBatch {
+	DatagramBatch(std::uint32_t size, std::uint32_t buffer_size) :
+			size(size),
+			buffer_size(buffer_size),
+			messages(size),
+			iovs(size),
+			addrs(size),
+			controls(size * control_size),
+			segments(size),
+			buffers(buffer_size > 0 ? new std::uint8_t[size * buffer_size] : nullptr) {}
+
+	static constexpr std::size_t control_size = CMSG_SPACE(sizeof(int));
+
+	const std::uint32_t size;
+	const std::uint32_t buffer_size;
+	std::vector<mmsghdr> messages;
+	std::vector<iovec> iovs;
+	std::vector<sockaddr_storage> addrs;
+	std::vector<std::uint8_t> controls;
+	std::vector<std::uint32_t> segments; // The number of datagrams of each sent message.
+	std::unique_ptr<std::uint8_t[]> buffers;
+};
+
+SocketAddress::SocketAddress(const std::string &ip_addr, std::uint16_t port) : storage_(), addr_size_(0) {
+	sockaddr_in in4 = {};
+	if (inet_pton(AF_INET, ip_addr.c_str(), &in4.sin_addr) == 1) {
+		in4.sin_family = AF_INET;
+		in4.sin_port = htons(port);
+		std::memcpy(storage_.data, &in4, sizeof(in4));
+		addr_size_ = sizeof(in4);
+		return;
+	}
+
+	sockaddr_in6 in6 = {};
+	if (inet_pton(AF_INET6, ip_addr.c_str(), &in6.sin6_addr) == 1) {
+		in6.sin6_family = AF_INET6;
+		in6.sin6_port = htons(port);
+		std::memcpy(storage_.data, &in6, sizeof(in6));
+		addr_size_ = sizeof(in6);
+		return;
+	}
+
+	throw "invalid host - inet_pton failed for both IPv4 and IPv6";
+}
+
+SocketAddress::SocketAddress(const sockaddr *addr, std::uint32_t addr_size) : storage_(), addr_size_(addr_size) {
+	if (addr_size > sizeof(storage_.data)) {
+		throw "socket address is too large";
+	}
+
+	std::memcpy(storage_.data, addr, addr_size);
+}
+
+std::string SocketAddress::GetIPAddr() const {
+	char ip_addr[INET6_ADDRSTRLEN] = {};
+
+	auto family = reinterpret_cast<const sockaddr*>(storage_.data)->sa_family;
+	if (addr_size_ == sizeof(sockaddr_in) && family == AF_INET) {
+		inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in*>(storage_.data)->sin_addr, ip_addr, sizeof(ip_addr));
+	} else if (addr_size_ == sizeof(sockaddr_in6) && family == AF_INET6) {
+		inet_ntop(AF_INET6, &reinterpret_cast<const sockaddr_in6*>(storage_.data)->sin6_addr, ip_addr, sizeof(ip_addr));
+	}
+
+	return ip_addr;
+}
+
+std::uint16_t SocketAddress::GetPort() const {
+	auto family = reinterpret_cast<const sockaddr*>(storage_.data)->sa_family;
+	if (addr_size_ == sizeof(sockaddr_in) && family == AF_INET) {
+		return ntohs(reinterpret_cast<const sockaddr_in*>(storage_.data)->sin_port);
+	} else if (addr_size_ == sizeof(sockaddr_in6) && family == AF_INET6) {
+		return ntohs(reinterpret_cast<const sockaddr_in6*>(storage_.data)->sin6_port);
+	}
+
+	return 0;
+}
+
+bool SocketAddress::operator==(const SocketAddress &other) const {
+	if (addr_size_ != other.addr_size_) {
+		return false;
+	}
+
+	if (addr_size_ == 0) {
+		return true;
+	}
+
+	auto family = reinterpret_cast<const sockaddr*>(storage_.data)->sa_family;
+	if (family != reinterpret_cast<const sockaddr*>(other.storage_.data)->sa_family) {
+		return false;
+	}
+
+	if (family == AF_INET) {
+		auto in4 = reinterpret_cast<const sockaddr_in*>(storage_.data);
+		auto other_in4 = reinterpret_cast<const sockaddr_in*>(other.storage_.data);
+		return in4->sin_port == other_in4->sin_port && in4->sin_addr.s_addr == other_in4->sin_addr.s_addr;
+	}
+
+	if (family == AF_INET6) {
+		auto in6 = reinterpret_cast<const sockaddr_in6*>(storage_.data);
+		auto other_in6 = reinterpret_cast<const sockaddr_in6*>(other.storage_.data);
+		return in6->sin6_port == other_in6->sin6_port && in6->sin6_scope_id == other_in6->sin6_scope_id &&
+				std::memcmp(&in6->sin6_addr, &other_in6->sin6_addr, sizeof(in6->sin6_addr)) == 0;
+	}
+
+	return std::memcmp(storage_.data, other.storage_.data, addr_size_) == 0;
+}
+
+std::ostream& operator<<(std::ostream &out, const SocketAddress &socket_address) {
+	out << socket_address.GetIPAddr() << ":" << socket_address.GetPort();
+	return out;
+}
+
+std::ostream& operator<<(std::ostream &out, const DatagramSocket *datagram_socket) {
+	const EventHandler *event_handler = datagram_socket;
+	out << event_handler;
+	return out;
+}
+
+DatagramSocket::DatagramSocket(std::shared_ptr<DatagramHandler> datagram_handler, Handle handle) :
+		EventHandler(handle),
+		datagram_handler_(datagram_handler),
+		send_queue_(std::make_unique<DatagramQueue>()),
+		receive_batch_(std::make_unique<DatagramBatch>(GLOBAL_CONFIG.datagram_batch_size_, GLOBAL_CONFIG.datagram_receive_size_)),
+		send_batch_(std::make_unique<DatagramBatch>(GLOBAL_CONFIG.datagram_batch_size_, 0)),
+		should_close_(false),
+		segmentation_offload_(false),
+		receive_offload_(false) {
+	LOG_TRACE("datagram socket created " << this);
+}
+
+DatagramSocket::~DatagramSocket() {
+	LOG_TRACE("datagram socket destroyed " << this);
+
+	while (!unsent_.IsEmpty()) {
+		unsent_.Front()->Destroy();
+		unsent_.PopFront();
+	}
+}
+
+std::shared_ptr<DatagramSocket> DatagramSocket::Create(std::shared_ptr<DatagramHandler> datagram_handler, const std::string &ip_addr, std::uint16_t port) {
+	LOG_INFO("creating a datagram socket ip_addr=" << ip_addr << " port=" << port);
+
+	auto handle = Handle::CreateDatagramHandle(ip_addr, port);
+	return std::shared_ptr<DatagramSocket>(new DatagramSocket(datagram_handler, handle));
+}
+
+SocketAddress DatagramSocket::GetLocalAddress() const {
+	sockaddr_storage addr;
+	socklen_t addr_size = sizeof(addr);
+
+	if (getsockname(GetHandle(), reinterpret_cast<sockaddr*>(&addr), &addr_size) != 0) {
+		throw std::system_error(errno, std::system_category(), "getsockname failed");
+	}
+
+	return SocketAddress(reinterpret_cast<sockaddr*>(&addr), addr_size);
+}
+
+bool DatagramSocket::SetSegmentationOffload(bool segmentation_offload) {
+#ifdef HAVE_UDP_SEGMENT
+	if (segmentation_offload) {
+		int segment_size;
+		socklen_t segment_size_length = sizeof(segment_size);
+		if (getsockopt(GetHandle(), SOL_UDP, UDP_SEGMENT, &segment_size, &segment_size_length) != 0) {
+			LOG_DEBUG("segmentation offload is not supported " << this << " errno=" << errno);
+			return false;
+		}
+	}
+
+	LOG_DEBUG("set segmentation offload " << this << " segmentation_offload=" << segmentation_offload);
+	segmentation_offload_ = segmentation_offload;
+	return true;
+#else
+	return !segmentation_offload;
+#endif
+}
+
+bool DatagramSocket::SetReceiveOffload(bool receive_offload) {
+#ifdef HAVE_UDP_GRO
+	int value = receive_offload ? 1 : 0;
+	if (setsockopt(GetHandle(), SOL_UDP, UDP_GRO, &value, sizeof(value)) != 0) {
+		LOG_DEBUG("receive offload is not supported " << this << " errno=" << errno);
+		return false;
+	}
+
+	LOG_DEBUG("set receive offload " << this << " receive_offload=" << receive_offload);
+	receive_offload_ = receive_offload;
+
+	// Coalesced datagrams are received into a single buffer.
+	receive_batch_ = std::make_unique<DatagramBatch>(GLOBAL_CONFIG.datagram_batch_size_, receive_offload ? max_offload_length : GLOBAL_CONFIG.datagram_receive_size_);
+	return true;
+#else
+	return !receive_offload;
+#endif
+}
+
+void DatagramSocket::SendTo(const DataView &data_view, const SocketAddress &destination) {
+	if (should_close_) {
+		LOG_DEBUG("should close cannot send " << this);
+		return;
+	}
+
+	LOG_TRACE("add datagram " << data_view.GetDataLength() << " bytes " << this << " destination=" << destination);
+
+	send_queue_->Push(data_view, destination);
+
+	ReadyEvent(Events::Write); // Coalesced with other pending ready events - datagrams queued meanwhile are sent in the same batch.
+}
+
+void DatagramSocket::Close() {
+	LOG_DEBUG("close invoked " << this);
+	should_close_ = true;
+	ReadyEvent(Events::Close);
+}
+
+Events DatagramSocket::GetEvents() const {
+	return Events::Read | Events::Write;
+}
+
+void DatagramSocket::HandleEvents(Handle, Events events) {
+	LOG_TRACE("handling events " << this << " events=" << events);
+
+	auto datagram_handler = datagram_handler_.lock();
+	if (!datagram_handler) {
+		LOG_WARN("datagram handler has been destroyed - closing " << this);
+		CloseEvent();
+		return;
+	}
+
+	if (events & (Events::Read | Events::Error)) {
+		DoReceive(datagram_handler);
+	}
+
+	if ((events & (Events::Write | Events::Close)) || should_close_) {
+		DoSend();
+	}
+
+	if (should_close_) {
+		LOG_DEBUG("closing " << this);
+		CloseEvent();
+	}
+}
+
+void DatagramSocket::DoReceive(std::shared_ptr<DatagramHandler> datagram_handler) {
+	auto self = shared_from_this();
+	auto &batch = *receive_batch_;
+
+	// To avoid starvation limit the number of batches.
+	for (auto i = 0; i < GLOBAL_CONFIG.datagram_starvation_limit_; i++) {
+		for (std::uint32_t j = 0; j < batch.size; j++) {
+			batch.iovs[j].iov_base = batch.buffers.get() + j * batch.buffer_size;
+			batch.iovs[j].iov_len = batch.buffer_size;
+
+			auto &msg_hdr = batch.messages[j].msg_hdr;
+			msg_hdr.msg_name = &batch.addrs[j];
+			msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+			msg_hdr.msg_iov = &batch.iovs[j];
+			msg_hdr.msg_iovlen = 1;
+			msg_hdr.msg_control = receive_offload_ ? &batch.controls[j * DatagramBatch::control_size] : nullptr;
+			msg_hdr.msg_controllen = receive_offload_ ? DatagramBatch::control_size : 0;
+			msg_hdr.msg_flags = 0;
+		}
+
+		auto received = recvmmsg(GetHandle(), batch.messages.data(), batch.size, MSG_DONTWAIT, nullptr);
+		if (received < 0) {
+			switch (errno) {
+			case EAGAIN:
+				LOG_TRACE("nothing to receive " << this);
+				return;
+			case EINTR:
+			case ECONNREFUSED:
+			case EHOSTUNREACH:
+			case EHOSTDOWN:
+			case ENETUNREACH:
+			case ENETDOWN:
+				// E.g. an ICMP error of a previous send - the error is cleared, datagrams may follow.
+				LOG_DEBUG("receive failed " << this << " errno=" << errno);
+				continue;
+			case EBADF:
+			case ENOTSOCK:
+			case EFAULT:
+				LOG_ERROR("receive failed - closing " << this << " errno=" << errno);
+				should_close_ = true;
+				return;
+			default:
+				// Retried on the next read event (instead of spinning on a persistent error).
+				LOG_WARN("receive failed " << this << " errno=" << errno);
+				return;
+			}
+		}
+
+		LOG_TRACE("received datagrams " << this << " received=" << received);
+
+		for (auto j = 0; j < received; j++) {
+			auto &message = batch.messages[j];
+
+			if (message.msg_hdr.msg_flags & MSG_TRUNC) {
+				LOG_WARN("datagram truncated - dropped " << this << " receive_size=" << batch.buffer_size);
+				continue;
+			}
+
+			SocketAddress source(static_cast<const sockaddr*>(message.msg_hdr.msg_name), message.msg_hdr.msg_namelen);
+			auto data = static_cast<const std::uint8_t*>(batch.iovs[j].iov_base);
+			auto data_length = message.msg_len;
+			auto segment_length = data_length;
+
+#ifdef HAVE_UDP_GRO
+			for (auto cmsg = CMSG_FIRSTHDR(&message.msg_hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(&message.msg_hdr, cmsg)) {
+				if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+					int gso_size;
+					std::memcpy(&gso_size, CMSG_DATA(cmsg), sizeof(gso_size));
+					segment_length = gso_size;
+				}
+			}
+#endif
+
+			if (data_length == 0) {
+				datagram_handler->HandleDatagram(self, DataView(), source);
+				continue;
+			}
+
+			// Coalesced datagrams are split back (all but the last are of the segment length).
+			for (decltype(data_length) offset = 0; offset < data_length; offset += segment_length) {
+				auto length = std::min(segment_length, data_length - offset);
+				datagram_handler->HandleDatagram(self, DataView(data + offset, length), source);
+			}
+		}
+
+		if (static_cast<std::uint32_t>(received) < batch.size) {
+			return;
+		}
+	}
+
+	LOG_DEBUG("datagram socket reached receive starvation limit " << this);
+
+	ReadyEvent(Events::Read);
+}
+
+void DatagramSocket::DoSend() {
+	auto &batch = *send_batch_;
+
+	// To avoid starvation (datagrams may be queued by other threads while sending) limit the number of batches.
+	for (auto i = 0; i < GLOBAL_CONFIG.datagram_starvation_limit_; i++) {
+		while (unsent_.GetSize() < batch.size) {
+			auto pending_datagram = send_queue_->Pop();
+			if (pending_datagram == nullptr) {
+				break;
+			}
+			unsent_.PushBack(pending_datagram);
+		}
+
+		if (unsent_.IsEmpty()) {
+			LOG_TRACE("nothing to send " << this);
+			return;
+		}
+
+		bool segmentation_offload = segmentation_offload_;
+		std::uint32_t messages_count = 0;
+
+		for (std::uint32_t index = 0; index < unsent_.GetSize(); messages_count++) {
+			auto first = unsent_[index];
+
+			batch.iovs[index].iov_base = const_cast<std::uint8_t*>(first->GetData());
+			batch.iovs[index].iov_len = first->GetDataLength();
+
+			std::uint32_t segments = 1;
+			std::uint32_t length = first->GetDataLength();
+
+			// Segments are of the length of the first datagram - only the last may be shorter.
+			while (segmentation_offload && first->GetDataLength() > 0 && index + segments < unsent_.GetSize() && segments < max_segments) {
+				auto next = unsent_[index + segments];
+				if (next->GetDataLength() == 0 || next->GetDataLength() > first->GetDataLength() ||
+						length + next->GetDataLength() > max_offload_length || next->GetDestination() != first->GetDestination()) {
+					break;
+				}
+
+				batch.iovs[index + segments].iov_base = const_cast<std::uint8_t*>(next->GetData());
+				batch.iovs[index + segments].iov_len = next->GetDataLength();
+				length += next->GetDataLength();
+				segments++;
+
+				if (next->GetDataLength() < first->GetDataLength()) {
+					break;
+				}
+			}
+
+			auto &msg_hdr = batch.messages[messages_count].msg_hdr;
+			msg_hdr = {};
+			msg_hdr.msg_name = const_cast<void*>(first->GetDestination().GetAddr());
+			msg_hdr.msg_namelen = first->GetDestination().GetAddrSize();
+			msg_hdr.msg_iov = &batch.iovs[index];
+			msg_hdr.msg_iovlen = segments;
+
+#ifdef HAVE_UDP_SEGMENT
+			if (segments > 1) {
+				msg_hdr.msg_control = &batch.controls[messages_count * DatagramBatch::control_size];
+				msg_hdr.msg_controllen = CMSG_SPACE(sizeof(std::uint16_t));
+
+				auto cmsg = CMSG_FIRSTHDR(&msg_hdr);
+				cmsg->cmsg_level = SOL_UDP;
+				cmsg->cmsg_type = UDP_SEGMENT;
+				cmsg->cmsg_len = CMSG_LEN(sizeof(std::uint16_t));
+
+				std::uint16_t segment_length = first->GetDataLength();
+				std::memcpy(CMSG_DATA(cmsg), &segment_length, sizeof(segment_length));
+			}
+#endif
+
+			batch.segments[messages_count] = segments;
+			index += segments;
+		}
+
+		auto sent = sendmmsg(GetHandle(), batch.messages.data(), messages_count, MSG_DONTWAIT);
+		if (sent < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				LOG_TRACE("send buffer is full " << this << " unsent=" << unsent_.GetSize());
+				return;
+			}
+
+			if (batch.segments[0] > 1 && (errno == EINVAL || errno == EIO)) {
+				LOG_WARN("segmented send failed - segmentation offload disabled " << this << " errno=" << errno);
+				segmentation_offload_ = false;
+				continue;
+			}
+
+			// The first datagram cannot be sent (e.g. too large for the path) - dropped so the rest are not blocked.
+			LOG_WARN("datagram send failed - dropped " << this << " errno=" << errno);
+			sent = 1;
+		}
+
+		LOG_TRACE("sent datagrams " << this << " messages=" << sent << " of " << messages_count);
+
+		for (auto j = 0; j < sent; j++) {
+			for (std::uint32_t segment = 0; segment < batch.segments[j]; segment++) {
+				unsent_.Front()->Destroy();
+				unsent_.PopFront();
+			}
+		}
+	}
+
+	LOG_DEBUG("datagram socket reached send starvation limit " << this);
+
+	ReadyEvent(Events::Write);
+}
+
+}
@@ -23,14 +23,15 @@
 
 #include <cerrno>
 #include <system_error>
+#include <thread>
 
 #define MAX_EVENTS 32
 
 namespace ael {
 
-std::unique_ptr<AsyncIO> AsyncIO::Create() {
+std::unique_ptr<AsyncIO> AsyncIO::Create(bool single_thread) {
 #ifdef HAVE_SYS_EPOLL_H
-	return std::make_unique<EPoll>();
+	return std::make_unique<EPoll>(single_thread);
 #endif
 }
 
@@ -78,7 +79,7 @@ static Events GetEventsFromEpollEvents(std::uint32_t epoll_events) {
 	return events;
 }
 
-EPoll::EPoll() {
+EPoll::EPoll(bool single_thread) : single_thread_(single_thread), process_thread_id_(std::thread::id()), pending_in_context_(false) {
 	epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
 	if (epoll_fd_ < 0) {
 		throw std::system_error(errno, std::system_category(), "epoll_create1 failed");
@@ -110,9 +111,9 @@ template<typename T>
 void EPoll::HandleElements(std::vector<T> &elements_container, std::function<void(EPoll*, T)> finalize_function) {
 	// This runs in the context of the EventLoop thread.
 	std::vector<T> elements_container_swap;
-	lock_.lock();
+	Lock();
 	elements_container.swap(elements_container_swap);
-	lock_.unlock();
+	Unlock();
 
 	for (T element : elements_container_swap) {
 		finalize_function(this, element);
@@ -122,19 +123,49 @@ void EPoll::HandleElements(std::vector<T> &elements_container, std::function<voi
 template<typename T>
 void EPoll::AddElement(T element, std::vector<T> &elements_container) {
 	// Add the element to be used in the context of the EventLoop thread.
-	lock_.lock();
+	if (single_thread_) {
+		elements_container.push_back(element);
+		pending_in_context_ = true;
+		return;
+	}
+
+	auto in_context = process_thread_id_ == std::this_thread::get_id();
+
+	Lock();
 	elements_container.push_back(element);
-	if (elements_container.size() == 1) {
+	if (in_context) {
+		// Handled before the next epoll_wait - no wakeup is required.
+		pending_in_context_ = true;
+	} else if (elements_container.size() == 1) {
 		Wakeup();
 	}
-	lock_.unlock();
+	Unlock();
+}
+
+void EPoll::HandlePending() {
+	HandleElements<std::shared_ptr<Event>>(events_pending_add_, &EPoll::AddFinalize);
+	HandleElements<std::shared_ptr<Event>>(events_pending_remove_, &EPoll::RemoveFinalize);
+	HandleElements<std::shared_ptr<Event>>(events_pending_ready_, &EPoll::ReadyFinalize);
 }
 
-void EPoll::Process() {
+void EPoll::Process(int timeout_ms) {
 	epoll_event events[MAX_EVENTS];
 
-	auto nfds = epoll_wait(epoll_fd_, events, MAX_EVENTS, -1);
+	process_thread_id_ = std::this_thread::get_id();
+
+	if (pending_in_context_) {
+		LOG_TRACE("epoll handling pending in context epoll_fd_=" << epoll_fd_);
+		pending_in_context_ = false;
+		HandlePending();
+	}
+
+	// Do not block if more elements were added (in context) while handling pending elements.
+	auto nfds = epoll_wait(epoll_fd_, events, MAX_EVENTS, pending_in_context_ ? 0 : timeout_ms);
 	if (nfds == -1) {
+		if (errno == EINTR) {
+			LOG_DEBUG("epoll wait interrupted by a signal epoll_fd_=" << epoll_fd_);
+			return; // Processed again by the next event loop iteration.
+		}
 		throw std::system_error(errno, std::system_category(), "epoll_wait failed");
 	}
 
@@ -151,9 +182,7 @@ void EPoll::Process() {
 
 			while (eventfd_read(pending_fd_, &val) == 0); // Since EPOLLET is set keep reading until the counter is zeroed (EAGAIN is received).
 
-			HandleElements<std::shared_ptr<Event>>(events_pending_add_, &EPoll::AddFinalize);
-			HandleElements<std::shared_ptr<Event>>(events_pending_remove_, &EPoll::RemoveFinalize);
-			HandleElements<ReadyEvent>(events_pending_ready_, &EPoll::ReadyFinalize);
+			HandlePending();
 
 			LOG_TRACE("epoll handling pending fds - complete epoll_fd_=" << epoll_fd_);
 
@@ -200,12 +229,21 @@ void EPoll::Remove(std::shared_ptr<Event> event) {
 	AddElement(event, events_pending_remove_);
 }
 
-void EPoll::Ready(std::shared_ptr<Event> event, Events events) {
-	ReadyEvent ready_event;
-	ready_event.event = event;
-	ready_event.events = events;
+void EPoll::Ready(std::shared_ptr<Event> event) {
+	AddElement(event, events_pending_ready_);
+}
+
+void EPoll::Suspend() {
+	Lock();
+	process_thread_id_ = std::thread::id();
+	auto pending = pending_in_context_;
+	Unlock();
 
-	AddElement(ready_event, events_pending_ready_);
+	// Elements added in context are handled by the next Process() - the handle should be readable (in single thread mode the
+	// application calls the next Process() without polling the handle).
+	if (pending && !single_thread_) {
+		Wakeup();
+	}
 }
 
 void EPoll::Wakeup() {
@@ -267,25 +305,30 @@ void EPoll::RemoveFinalize(std::shared_ptr<Event> event) {
 	LOG_TRACE("epoll removing event finalize - complete epoll_fd_=" << epoll_fd_ << " handle=" << handle << " id=" <<  event->GetID());
 }
 
-void EPoll::ReadyFinalize(ReadyEvent ready_event) {
-	auto handle = ready_event.event->GetHandle();
-	auto id = ready_event.event->GetID();
+void EPoll::ReadyFinalize(std::shared_ptr<Event> event) {
+	auto handle = event->GetHandle();
+	auto id = event->GetID();
+	auto events = event->TakeReady(); // Ready events added from now on are handled in a following iteration.
 
-	LOG_TRACE("epoll ready event finalize epoll_fd_=" << epoll_fd_ << " handle=" << handle << " id=" << id << " events=" << ready_event.events);
+	LOG_TRACE("epoll ready event finalize epoll_fd_=" << epoll_fd_ << " handle=" << handle << " id=" << id << " events=" << events);
 
 	auto event_iterator = events_.find(handle);
 	if (event_iterator == events_.end() || event_iterator->second->GetID() != id) {
-		LOG_TRACE("epoll ready event finalize - event no longer registered (ignore) epoll_fd_=" << epoll_fd_ << " handle=" << handle << " id=" << id << " events=" << ready_event.events);
+		LOG_TRACE("epoll ready event finalize - event no longer registered (ignore) epoll_fd_=" << epoll_fd_ << " handle=" << handle << " id=" << id << " events=" << events);
 		return;
 	}
 
-	auto event_handler = ready_event.event->GetEventHandler().lock();
+	if (events == 0) {
+		LOG_TRACE("epoll ready event finalize - no ready events (ignore) epoll_fd_=" << epoll_fd_ << " handle=" << handle << " id=" << id);
+		return;
+	}
+
+	auto event_handler = event->GetEventHandler().lock();
 	if (event_handler) {
-		event_handler->HandleEvents(handle, ready_event.events);
+		event_handler->HandleEvents(handle, events);
 	} else {
-		LOG_TRACE("epoll ready event finalize - event_handler destroyed epoll_fd_=" << epoll_fd_ << " handle=" << handle << " id=" << id << " events=" << ready_event.events);
+		LOG_TRACE("epoll ready event finalize - event_handler destroyed epoll_fd_=" << epoll_fd_ << " handle=" << handle << " id=" << id << " events=" << events);
 	}
 }
 
 }
-
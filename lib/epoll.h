@@ -14,29 +14,31 @@
 #include <mutex>
 #include <vector>
 #include <functional>
+#include <atomic>
+#include <thread>
 
 namespace ael {
 
 class EPoll : public AsyncIO {
 public:
-	EPoll();
+	EPoll(bool single_thread);
 	virtual ~EPoll();
 
 private:
-	struct ReadyEvent {
-		Events events;
-		std::shared_ptr<Event> event;
-	};
-
 	void Add(std::shared_ptr<Event> event) override;
 	void Modify(std::shared_ptr<Event> event) override;
 	void Remove(std::shared_ptr<Event> event) override;
-	void Ready(std::shared_ptr<Event> event, Events events) override;
+	void Ready(std::shared_ptr<Event> event) override;
 	void Wakeup() override;
-	void Process() override;
+	void Process(int timeout_ms) override;
+	void Suspend() override;
+	Handle GetHandle() const override { return epoll_fd_; }
 
+	void HandlePending();
+	void Lock() { if (!single_thread_) lock_.lock(); }
+	void Unlock() { if (!single_thread_) lock_.unlock(); }
 	void AddFinalize(std::shared_ptr<Event> event);
-	void ReadyFinalize(ReadyEvent ready_event);
+	void ReadyFinalize(std::shared_ptr<Event> event);
 	void RemoveFinalize(std::shared_ptr<Event> event);
 
 	template<typename T>
@@ -44,12 +46,15 @@ private:
 	template<typename T>
 	void HandleElements(std::vector<T> &elements_container, std::function<void(EPoll*, T)> finalize_function);
 
+	const bool single_thread_;
 	int epoll_fd_;
 	int pending_fd_;
+	std::atomic<std::thread::id> process_thread_id_;
+	bool pending_in_context_; // Elements were added in the context of the event loop (without a wakeup).
 	std::mutex lock_;
 	std::vector<std::shared_ptr<Event>> events_pending_add_;
 	std::vector<std::shared_ptr<Event>> events_pending_remove_;
-	std::vector<ReadyEvent> events_pending_ready_;
+	std::vector<std::shared_ptr<Event>> events_pending_ready_; // An event is pending at most once (see Event::AddReady).
 	std::unordered_map<int, std::shared_ptr<Event>> events_;
 };
 
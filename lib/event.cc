@@ -19,7 +19,8 @@ Event::Event(std::shared_ptr<EventLoop> event_loop, std::shared_ptr<EventHandler
 		id_(event_handler->id_),
 		event_loop_(event_loop),
 		event_handler_(event_handler),
-		handle_(event_handler->handle_) {
+		handle_(event_handler->handle_),
+		pending_ready_(0) {
 	LOG_TRACE("event is created " << this);
 }
 
@@ -72,6 +73,27 @@ void Event::Modify() {
 	}
 }
 
+bool Event::AddReady(Events events) {
+	if (events == 0) {
+		return false; // Nothing to handle.
+	}
+
+	return pending_ready_.fetch_or(events) == 0;
+}
+
+Events Event::TakeReady() {
+	return pending_ready_.exchange(0);
+}
+
+void Event::Defer() {
+	auto event_loop = event_loop_.lock();
+	if (event_loop) {
+		event_loop->Defer(shared_from_this());
+	} else {
+		LOG_WARN("event defer called but event loop deleted " << this);
+	}
+}
+
 std::ostream& operator<<(std::ostream &out, const EventHandler *event_handler) {
 	out << "id=" << event_handler->id_ << " handle=" << event_handler->handle_;
 	return out;
@@ -118,4 +140,24 @@ void EventHandler::ModifyEvent() {
 	}
 }
 
+void EventHandler::DeferEvent() {
+	if (event_) {
+		LOG_TRACE("event handler defer " << this);
+		event_->Defer();
+	}
+}
+
+std::shared_ptr<EventLoop> EventHandler::GetEventLoop() const {
+	return event_ ? event_->GetEventLoop().lock() : nullptr;
+}
+
+bool EventHandler::IsEventLoopThread() const {
+	if (!event_) {
+		return false;
+	}
+
+	auto event_loop = event_->GetEventLoop().lock();
+	return event_loop && event_loop->IsInLoopThread();
+}
+
 }
@@ -10,6 +10,9 @@
 #include "log.h"
 #include "async_io.h"
 #include "event_loop.h"
+#include "mpsc_queue.h"
+#include "worker_pool.h"
+#include "thread_placement.h"
 #include "config.h"
 
 #ifdef HAVE_UNISTD_H
@@ -18,6 +21,28 @@
 
 namespace ael {
 
+class PostedFunction : public MPSCNode {
+public:
+	PostedFunction(std::function<void()> func) : func(std::move(func)) {}
+
+	std::function<void()> func;
+};
+
+class PostQueue : public MPSCQueue<PostedFunction> {};
+
+// The event loop that is running on this thread (see EventLoop::Current()).
+static thread_local EventLoop *current_event_loop = nullptr;
+
+// Sets the current event loop for the scope (event loops may be nested - see EventLoop::RunOnce()).
+class CurrentEventLoopScope {
+public:
+	CurrentEventLoopScope(EventLoop *event_loop) : prev_(current_event_loop) { current_event_loop = event_loop; }
+	~CurrentEventLoopScope() { current_event_loop = prev_; }
+
+private:
+	EventLoop *prev_;
+};
+
 static std::mutex table_lock;
 static std::unordered_set<std::shared_ptr<EventLoop>> table;
 
@@ -34,23 +59,47 @@ void EventLoop::DestroyAll() {
 	table_swap.clear();
 }
 
-EventLoop::EventLoop() : async_io_(AsyncIO::Create()), stop_(false) {
+EventLoop::EventLoop(const EventLoopOptions &options) :
+		thread_id_(options.single_thread_ ? std::this_thread::get_id() : std::thread::id()),
+		async_io_(AsyncIO::Create(options.single_thread_)),
+		post_queue_(std::make_unique<PostQueue>()),
+		posted_(0),
+		stop_(false),
+		closed_(false),
+		placed_(false),
+		options_(options),
+		iterations_(0),
+		migrations_(0),
+		cpu_(-1) {
 	LOG_TRACE("event loop is being created");
 }
 
 EventLoop::~EventLoop() {
 	LOG_TRACE("event loop is destroyed");
+
+	while (auto posted_function = post_queue_->Pop()) {
+		delete posted_function;
+	}
 }
 
 std::shared_ptr<EventLoop> EventLoop::Create() {
-	std::shared_ptr<EventLoop> event_loop(new EventLoop);
+	return Create(EventLoopOptions());
+}
+
+std::shared_ptr<EventLoop> EventLoop::Create(const EventLoopOptions &options) {
+	std::shared_ptr<EventLoop> event_loop(new EventLoop(options));
 
 	table_lock.lock();
 	table.insert(event_loop);
 	table_lock.unlock();
 
+	if (options.caller_thread_ || options.single_thread_) {
+		LOG_TRACE("event loop is being created - run by the caller");
+		return event_loop;
+	}
+
 	LOG_TRACE("event loop is being created - starting thread");
-	event_loop->thread_ = std::make_unique<std::thread>(&EventLoop::Run, event_loop.get());
+	event_loop->thread_ = std::make_unique<std::thread>(&EventLoop::RunThread, event_loop.get());
 
 	return event_loop;
 }
@@ -59,40 +108,148 @@ void EventLoop::Stop() {
 	LOG_TRACE("event loop is stopping");
 	stop_ = true;
 	async_io_->Wakeup(); // Wakeup for the loop to detect stop.
-	thread_->join();
-	LOG_TRACE("event loop stopped");
+
+	if (thread_ && thread_->joinable() && !IsInLoopThread()) {
+		thread_->join();
+		LOG_TRACE("event loop stopped");
+	}
 }
 
-void EventLoop::Run() {
+void EventLoop::RunThread() {
 	LOG_DEBUG("event loop thread started");
 
-	while (!stop_) {
-		async_io_->Process();
+	Run();
+
+	LOG_DEBUG("event loop thread finished");
+}
+
+std::shared_ptr<EventLoop> EventLoop::Current() {
+	return current_event_loop ? current_event_loop->shared_from_this() : nullptr;
+}
+
+void EventLoop::Dispatch(std::function<void()> func) {
+	if (current_event_loop == this) {
+		func();
+		return;
 	}
 
-	LOG_DEBUG("event loop stop detected");
+	Post(std::move(func));
+}
+
+void EventLoop::Run() {
+	while (RunOnce(std::chrono::milliseconds(-1))) {}
+}
+
+bool EventLoop::RunOnce(std::chrono::milliseconds timeout) {
+	if (!IsInLoopThread()) {
+		std::thread::id none;
+		if (!thread_id_.compare_exchange_strong(none, std::this_thread::get_id())) {
+			throw "event loop is run by another thread";
+		}
+	}
 
+	if (!placed_) {
+		placed_ = true;
+
+		EventLoopStats placement;
+		ApplyThreadPlacement(options_, placement);
+		placement_lock_.lock();
+		placement_ = placement;
+		placement_lock_.unlock();
+	}
+
+	if (closed_) {
+		return false;
+	}
+
+	CurrentEventLoopScope current_event_loop_scope(this);
+
+	if (!stop_) {
+		Iterate(timeout.count() < 0 ? -1 : static_cast<int>(timeout.count()));
+	}
+
+	if (stop_) {
+		LOG_DEBUG("event loop stop detected");
+		CloseAll();
+		return false;
+	}
+
+	// The application may wait for the poll fd until the next call - attaching in between should make it readable.
+	if (options_.caller_thread_ || options_.single_thread_) {
+		async_io_->Suspend();
+	}
+
+	return true;
+}
+
+void EventLoop::Iterate(int timeout_ms) {
+	// A single thread event loop is not woken up by posts.
+	if (options_.single_thread_ && posted_.load(std::memory_order_relaxed) > 0) {
+		timeout_ms = 0;
+	}
+
+	async_io_->Process(timeout_ms);
+	HandlePosted();
+	HandleDeferred();
+	UpdateIterationStats();
+}
+
+void EventLoop::CloseAll() {
+	closed_ = true;
 
 	std::unordered_map<std::uint64_t, std::shared_ptr<Event>> events_to_close;
-	lock_.lock();
+	Lock();
 	events_to_close = events_; // Make a copy and work on it to prevent "lock issues".
-	lock_.unlock();
+	Unlock();
 
 	for (auto it : events_to_close) {
 		it.second->Close();
 	}
 
+	// Never run - their captures are released now rather than with the event loop.
+	while (auto posted_function = post_queue_->Pop()) {
+		delete posted_function;
+	}
+
 	async_io_->Wakeup(); // Wakeup again in case there is nothing to process.
 
-	async_io_->Process();
+	async_io_->Process(-1);
+}
+
+Handle EventLoop::GetPollFd() const {
+	return async_io_->GetHandle();
+}
+
+void EventLoop::UpdateIterationStats() {
+	// Relaxed - the counters are only written by the event loop thread.
+	iterations_.store(iterations_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
 
-	LOG_DEBUG("event loop thread finished");
+	auto cpu = GetCurrentCpu();
+	auto prev_cpu = cpu_.load(std::memory_order_relaxed);
+	if (cpu != prev_cpu) {
+		if (prev_cpu >= 0) {
+			migrations_.store(migrations_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		}
+		cpu_.store(cpu, std::memory_order_relaxed);
+	}
+}
+
+EventLoopStats EventLoop::GetStats() const {
+	placement_lock_.lock();
+	EventLoopStats stats = placement_;
+	placement_lock_.unlock();
+
+	stats.iterations_ = iterations_;
+	stats.migrations_ = migrations_;
+	stats.cpu_ = cpu_;
+
+	return stats;
 }
 
 void EventLoop::Remove(std::uint64_t id) {
 	LOG_DEBUG("removing event id=" << id);
 
-	lock_.lock();
+	Lock();
 
 	auto event_iterator = events_.find(id);
 	if (event_iterator == events_.end()) {
@@ -103,7 +260,7 @@ void EventLoop::Remove(std::uint64_t id) {
 
 	events_.erase(event_iterator);
 
-	lock_.unlock();
+	Unlock();
 
 	LOG_TRACE("removing event - event removed proceed to async_io remove id=" << id);
 
@@ -113,34 +270,160 @@ void EventLoop::Remove(std::uint64_t id) {
 void EventLoop::Ready(std::shared_ptr<Event> event, Events events) {
 	auto event_id = event->GetID();
 
+	if (!event->AddReady(events)) {
+		// Already pending - handled once (with all the ready events).
+		LOG_TRACE("readying an event - coalesced id=" << event_id << " events=" << events);
+		return;
+	}
+
 	LOG_TRACE("readying an event id=" << event_id << " events=" << events);
 
-	async_io_->Ready(event, events);
+	async_io_->Ready(event);
 }
 
 void EventLoop::Modify(std::shared_ptr<Event> event) {
-	if (thread_->get_id() != std::this_thread::get_id()) {
+	if (!IsInLoopThread()) {
 		throw "Modify() called outside the scope of the event loop";
 	}
 
 	async_io_->Modify(event);
 }
 
+void EventLoop::Defer(std::shared_ptr<Event> event) {
+	if (!IsInLoopThread()) {
+		throw "Defer() called outside the scope of the event loop";
+	}
+
+	LOG_TRACE("deferring an event id=" << event->GetID());
+
+	deferred_events_.push_back(event);
+}
+
+void EventLoop::HandleDeferred() {
+	// Events deferred while handling deferred events are handled as well (in the same iteration).
+	while (!deferred_events_.empty()) {
+		std::vector<std::shared_ptr<Event>> deferred_events_swap;
+		deferred_events_swap.swap(deferred_events_);
+
+		LOG_TRACE("handling deferred events count=" << deferred_events_swap.size());
+
+		for (auto &event : deferred_events_swap) {
+			Lock();
+			auto is_registered = events_.find(event->GetID()) != events_.end();
+			Unlock();
+
+			if (!is_registered) {
+				LOG_TRACE("deferred event no longer registered (ignore) id=" << event->GetID());
+				continue;
+			}
+
+			auto event_handler = event->GetEventHandler().lock();
+			if (event_handler) {
+				event_handler->HandleEvents(event->GetHandle(), Events::Write);
+			}
+		}
+	}
+}
+
+void EventLoop::Post(std::function<void()> func) {
+	if (options_.single_thread_) {
+		CheckThread();
+		post_queue_->Push(new PostedFunction(std::move(func)));
+		posted_.store(posted_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		return;
+	}
+
+	post_queue_->Push(new PostedFunction(std::move(func)));
+
+	// Pushed before it is counted - the event loop runs it once it sees the count.
+	if (posted_++ == 0) {
+		async_io_->Wakeup();
+	}
+}
+
+void EventLoop::HandlePosted() {
+	std::int64_t posted = posted_;
+	if (posted <= 0) {
+		return;
+	}
+
+	// Only take what is already posted - functions posting functions cannot starve the event loop.
+	std::int64_t popped = 0;
+	while (popped < posted) {
+		std::unique_ptr<PostedFunction> posted_function(post_queue_->Pop());
+		if (!posted_function) {
+			break; // A push is still in progress.
+		}
+
+		popped++;
+		posted_function->func();
+	}
+
+	LOG_TRACE("handled posted functions count=" << popped);
+
+	if (options_.single_thread_) {
+		posted_.store(posted_.load(std::memory_order_relaxed) - popped, std::memory_order_relaxed);
+		return;
+	}
+
+	// Posts made while running did not wake the event loop up (the count was positive).
+	if ((posted_ -= popped) > 0) {
+		async_io_->Wakeup();
+	}
+}
+
+bool EventLoop::Offload(std::function<void()> work, std::function<void()> continuation) {
+	return Offload(WorkerPool::GetDefault(), std::move(work), std::move(continuation));
+}
+
+bool EventLoop::Offload(std::shared_ptr<WorkerPool> worker_pool, std::function<void()> work, std::function<void()> continuation) {
+	if (options_.single_thread_) {
+		throw "offload is not supported by a single thread event loop";
+	}
+
+	std::weak_ptr<EventLoop> weak_event_loop = shared_from_this();
+
+	return worker_pool->TrySubmit([weak_event_loop, work, continuation]() {
+		try {
+			work();
+		} catch (...) {
+			LOG_WARN("offloaded work threw an exception");
+		}
+
+		auto event_loop = weak_event_loop.lock();
+		if (event_loop) {
+			event_loop->Post(continuation);
+		} else {
+			LOG_DEBUG("offloaded work completed - event loop has been destroyed");
+		}
+	});
+}
+
 std::shared_ptr<Event> EventLoop::CreateEvent(std::shared_ptr<EventHandler> event_handler) {
 	std::shared_ptr<Event> event(new Event(shared_from_this(), event_handler));
 
 	LOG_TRACE("creating and adding an event id=" << event->GetID() << " handle=" << event->GetHandle());
 
-	lock_.lock();
+	Lock();
 	events_[event->GetID()] = event;
-	lock_.unlock();
+	Unlock();
 
 	LOG_TRACE("creating and adding an event - event added id=" << event->GetID() << " handle=" << event->GetHandle());
 
 	return event;
 }
 
+void EventLoop::CheckThread() const {
+	if (!IsInLoopThread()) {
+		throw "single thread event loop used by another thread";
+	}
+}
+
 void EventLoop::Attach(std::shared_ptr<EventHandler> event_handler) {
+	if (options_.single_thread_) {
+		CheckThread();
+	}
+
 	if (event_handler->event_) {
 		throw "event handler already attached";
 	}
@@ -155,15 +438,18 @@ void EventLoop::Attach(std::shared_ptr<EventHandler> event_handler) {
 }
 
 void EventLoop::AttachInternal(std::shared_ptr<EventHandler> event_handler) {
-	lock_.lock();
+	Lock();
 	internal_event_handlers_.insert(event_handler);
-	lock_.unlock();
+	Unlock();
 	Attach(event_handler);
 }
 
 void EventLoop::RemoveInternal(std::shared_ptr<EventHandler> event_handler) {
-	std::lock_guard<std::mutex> guard(lock_);
-	if (internal_event_handlers_.erase(event_handler) != 1) {
+	Lock();
+	auto erased = internal_event_handlers_.erase(event_handler);
+	Unlock();
+
+	if (erased != 1) {
 		throw "event handler found";
 	}
 }
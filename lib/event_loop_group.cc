@@ -0,0 +1,77 @@
+/*
+ * event_loop_group.cc
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#include "config.h"
+#include "event_loop_group.h"
+#include "strand.h"
+#include "log.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace ael {
+
+EventLoopGroup::EventLoopGroup(std::uint32_t size, const EventLoopOptions &options) : next_(0) {
+	if (options.caller_thread_ || options.single_thread_) {
+		throw "event loop group does not support caller thread event loops";
+	}
+
+	if (size == 0) {
+		size = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	LOG_DEBUG("event loop group is created size=" << size);
+
+	for (std::uint32_t i = 0; i < size; i++) {
+		auto event_loop_options = options;
+		if (!options.name_.empty()) {
+			event_loop_options.name_ = options.name_ + "-" + std::to_string(i);
+		}
+		if (!options.cpus_.empty()) {
+			event_loop_options.cpus_ = { options.cpus_[i % options.cpus_.size()] };
+		}
+
+		event_loops_.push_back(EventLoop::Create(event_loop_options));
+	}
+}
+
+EventLoopGroup::~EventLoopGroup() {
+	LOG_DEBUG("event loop group is destroyed");
+}
+
+std::shared_ptr<EventLoopGroup> EventLoopGroup::Create(std::uint32_t size) {
+	return Create(size, EventLoopOptions());
+}
+
+std::shared_ptr<EventLoopGroup> EventLoopGroup::Create(std::uint32_t size, const EventLoopOptions &options) {
+	return std::shared_ptr<EventLoopGroup>(new EventLoopGroup(size, options));
+}
+
+std::shared_ptr<EventLoop> EventLoopGroup::GetNext() {
+	return event_loops_[next_++ % event_loops_.size()];
+}
+
+std::shared_ptr<EventLoop> EventLoopGroup::GetForKey(std::uint64_t key) const {
+	// Mixed (splitmix64 finalizer) - sequential keys are spread evenly.
+	key ^= key >> 30;
+	key *= 0xbf58476d1ce4e5b9ull;
+	key ^= key >> 27;
+	key *= 0x94d049bb133111ebull;
+	key ^= key >> 31;
+
+	return event_loops_[key % event_loops_.size()];
+}
+
+std::shared_ptr<Strand> EventLoopGroup::CreateStrand() {
+	return Strand::Create(GetNext());
+}
+
+std::shared_ptr<Strand> EventLoopGroup::CreateStrand(std::uint64_t key) {
+	return Strand::Create(GetForKey(key));
+}
+
+}
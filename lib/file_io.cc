@@ -0,0 +1,213 @@
+/*
+ * file_io.cc
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#include "config.h"
+#include "file_io.h"
+#include "file_io_engine.h"
+#include "file_thread_pool.h"
+#include "io_uring.h"
+#include "log.h"
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
+
+#include <cerrno>
+#include <system_error>
+#include <vector>
+
+namespace ael {
+
+static void DestroyOperation(FileOperation *operation) {
+	if (operation->type == FileOperation::READ) {
+		delete [] operation->buf;
+	}
+	delete operation;
+}
+
+std::unique_ptr<FileIOEngine> FileIOEngine::Create(Handle notify_handle, std::uint32_t queue_depth) {
+#ifdef HAVE_LINUX_IO_URING_H
+	if (GLOBAL_CONFIG.file_io_uring_) {
+		auto io_uring = IOUring::Create(notify_handle, queue_depth);
+		if (io_uring) {
+			return io_uring;
+		}
+	}
+#else
+	(void)queue_depth;
+#endif
+
+	LOG_DEBUG("file io engine - thread pool");
+	return std::make_unique<FileThreadPool>(notify_handle);
+}
+
+std::ostream& operator<<(std::ostream &out, const FileIO *file_io) {
+	const EventHandler *event_handler = file_io;
+	out << event_handler << " in_flight=" << file_io->in_flight_ << " queued=" << file_io->queued_.GetSize();
+	return out;
+}
+
+FileIO::FileIO(Handle handle, std::uint32_t queue_depth) :
+		EventHandler(handle),
+		queue_depth_(queue_depth),
+		in_flight_(0),
+		submit_deferred_(false),
+		engine_(FileIOEngine::Create(handle, queue_depth)) {
+	LOG_TRACE("file io is created " << this << " queue_depth=" << queue_depth_ << " io_uring=" << engine_->IsIOUring());
+}
+
+FileIO::~FileIO() {
+	LOG_TRACE("file io is destroyed " << this);
+
+	// The kernel (or a worker thread) may still reference the buffers.
+	std::vector<FileOperation*> completed;
+	while (in_flight_ > 0) {
+		engine_->Reap(completed);
+		if (completed.empty()) {
+			engine_->Wait();
+			continue;
+		}
+
+		for (auto operation : completed) {
+			DestroyOperation(operation);
+			in_flight_--;
+		}
+		completed.clear();
+	}
+
+	while (!queued_.IsEmpty()) {
+		DestroyOperation(queued_.Front());
+		queued_.PopFront();
+	}
+}
+
+std::shared_ptr<FileIO> FileIO::Create() {
+	return Create(GLOBAL_CONFIG.file_io_queue_depth_);
+}
+
+std::shared_ptr<FileIO> FileIO::Create(std::uint32_t queue_depth) {
+	if (queue_depth == 0) {
+		throw "file io queue depth must be positive";
+	}
+
+	auto fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (fd < 0) {
+		throw std::system_error(errno, std::system_category(), "eventfd failed");
+	}
+
+	try {
+		return std::shared_ptr<FileIO>(new FileIO(fd, queue_depth));
+	} catch (...) {
+		close(fd);
+		throw;
+	}
+}
+
+bool FileIO::IsIOUring() const {
+	return engine_->IsIOUring();
+}
+
+void FileIO::ReadFile(Handle file_handle, std::uint64_t offset, std::uint32_t length, FileCallback callback) {
+	LOG_DEBUG("file io read " << this << " file_handle=" << file_handle << " offset=" << offset << " length=" << length);
+	Queue(new FileOperation{ FileOperation::READ, file_handle, offset, new std::uint8_t[length], length, 0, nullptr, callback, 0 });
+}
+
+void FileIO::WriteFile(Handle file_handle, std::uint64_t offset, const DataView &data_view, FileCallback callback) {
+	LOG_DEBUG("file io write " << this << " file_handle=" << file_handle << " offset=" << offset << " length=" << data_view.GetDataLength());
+	auto data = data_view.Save();
+	Queue(new FileOperation{ FileOperation::WRITE, file_handle, offset, const_cast<std::uint8_t*>(data->GetData()), static_cast<std::uint32_t>(data->GetDataLength()), 0, data, callback, 0 });
+}
+
+void FileIO::Fsync(Handle file_handle, bool data_only, FileCallback callback) {
+	LOG_DEBUG("file io fsync " << this << " file_handle=" << file_handle << " data_only=" << data_only);
+	Queue(new FileOperation{ data_only ? FileOperation::FDATASYNC : FileOperation::FSYNC, file_handle, 0, nullptr, 0, 0, nullptr, callback, 0 });
+}
+
+void FileIO::Queue(FileOperation *operation) {
+	if (!IsEventLoopThread()) {
+		DestroyOperation(operation);
+		throw "file io called outside the scope of the event loop";
+	}
+
+	queued_.PushBack(operation);
+
+	// Operations issued in this event loop iteration are submitted together.
+	if (!submit_deferred_) {
+		submit_deferred_ = true;
+		DeferEvent();
+	}
+}
+
+void FileIO::HandleEvents(Handle handle, Events events) {
+	LOG_TRACE("handling events " << this << " events=" << events);
+
+	if (events & Events::Read) {
+		eventfd_t value;
+		eventfd_read(handle, &value); // Completions signaled from now on trigger another event.
+	}
+
+	DoComplete();
+	DoSubmit();
+}
+
+Events FileIO::GetEvents() const {
+	return Events::Read;
+}
+
+void FileIO::DoComplete() {
+	std::vector<FileOperation*> completed;
+	engine_->Reap(completed);
+
+	for (auto operation : completed) {
+		auto result = operation->result;
+
+		if (operation->type == FileOperation::WRITE && result > 0 && result < operation->length) {
+			LOG_DEBUG("file io short write - continuing " << this << " written=" << result << " length=" << operation->length);
+			operation->transferred += result;
+			operation->offset += result;
+			operation->buf += result;
+			operation->length -= result;
+			engine_->Submit(operation);
+			continue;
+		}
+
+		in_flight_--;
+
+		std::shared_ptr<const DataView> data_view;
+		if (operation->type == FileOperation::READ && result >= 0) {
+			data_view = std::shared_ptr<const DataView>(new DataView(operation->buf, static_cast<int>(result), true));
+			operation->buf = nullptr;
+		} else if (operation->type == FileOperation::WRITE && result >= 0) {
+			result += operation->transferred;
+		}
+
+		LOG_TRACE("file io completed " << this << " type=" << operation->type << " result=" << result);
+
+		auto callback = std::move(operation->callback);
+		DestroyOperation(operation);
+
+		callback(FileResult(result, data_view));
+	}
+}
+
+void FileIO::DoSubmit() {
+	submit_deferred_ = false;
+
+	while (!queued_.IsEmpty() && in_flight_ < queue_depth_) {
+		engine_->Submit(queued_.Front());
+		queued_.PopFront();
+		in_flight_++;
+	}
+
+	engine_->Flush();
+}
+
+}
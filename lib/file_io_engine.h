@@ -0,0 +1,51 @@
+/*
+ * file_io_engine.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#ifndef LIB_FILE_IO_ENGINE_H_
+#define LIB_FILE_IO_ENGINE_H_
+
+#include <memory>
+#include <vector>
+
+#include "file_io.h"
+
+namespace ael {
+
+struct FileOperation {
+	enum Type { READ, WRITE, FSYNC, FDATASYNC };
+
+	Type type;
+	int file_handle;
+	std::uint64_t offset;
+	std::uint8_t *buf; // READ - allocated by new[] (owned by the result data view once completed), WRITE - the remaining data.
+	std::uint32_t length;
+	std::uint64_t transferred; // WRITE - bytes written by previous (short) writes.
+	std::shared_ptr<const DataView> data_view; // WRITE - kept until the operation is completed.
+	FileCallback callback;
+	std::int64_t result; // Set once completed - the bytes transferred or -errno.
+};
+
+// Executes file operations - completions are signaled by writing to the notify handle (an eventfd).
+// Only used in the context of a single event loop.
+class FileIOEngine {
+public:
+	FileIOEngine() {}
+	virtual ~FileIOEngine() {}
+
+	// io_uring if supported by the kernel, otherwise the thread pool.
+	static std::unique_ptr<FileIOEngine> Create(Handle notify_handle, std::uint32_t queue_depth);
+
+	virtual void Submit(FileOperation *operation) = 0; // Submitted operations may be batched until Flush().
+	virtual void Flush() = 0;
+	virtual void Reap(std::vector<FileOperation*> &completed) = 0; // Appends the completed operations.
+	virtual void Wait() = 0; // Blocks until an operation completes.
+	virtual bool IsIOUring() const = 0;
+};
+
+}
+
+#endif /* LIB_FILE_IO_ENGINE_H_ */
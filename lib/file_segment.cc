@@ -0,0 +1,61 @@
+/*
+ * file_segment.cc
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#include "config.h"
+#include "file_segment.h"
+#include "log.h"
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <cstring>
+
+namespace ael {
+
+FileSegment::FileSegment(std::shared_ptr<const Handle> file_handle, std::uint64_t offset, int length) :
+		DataView(nullptr, length),
+		file_handle_(file_handle),
+		offset_(offset) {}
+
+FileSegment::~FileSegment() {}
+
+const FileSegment* FileSegment::From(const std::shared_ptr<const DataView> &data_view) {
+	if (!data_view->IsFileSegment()) {
+		throw "data view is not a file segment";
+	}
+
+	return static_cast<const FileSegment*>(data_view.get());
+}
+
+std::shared_ptr<const DataView> FileSegment::Advance(int length) const {
+	if (length >= GetDataLength()) {
+		return nullptr;
+	}
+
+	return std::make_shared<FileSegment>(file_handle_, offset_ + length, GetDataLength() - length);
+}
+
+std::shared_ptr<const DataView> FileSegment::Read(int length) const {
+	if (length > GetDataLength()) {
+		length = GetDataLength();
+	}
+
+	auto data = new std::uint8_t[length];
+
+	auto read_ret = pread(*file_handle_, data, length, offset_);
+	if (read_ret <= 0) {
+		LOG_WARN("file segment read failed handle=" << *file_handle_ << " offset=" << offset_ << " error=" << (read_ret == 0 ? "EOF" : std::strerror(errno)));
+		delete [] data;
+		return nullptr;
+	}
+
+	return std::shared_ptr<const DataView>(new DataView(data, read_ret, true));
+}
+
+}
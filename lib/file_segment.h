@@ -0,0 +1,44 @@
+/*
+ * file_segment.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#ifndef LIB_FILE_SEGMENT_H_
+#define LIB_FILE_SEGMENT_H_
+
+#include <memory>
+#include <cstdint>
+
+#include "data_view.h"
+#include "handle.h"
+
+namespace ael {
+
+// A file range queued for writing. Passed along the write path as a data view with no data (the data length is the range length).
+class FileSegment : public DataView {
+public:
+	FileSegment(std::shared_ptr<const Handle> file_handle, std::uint64_t offset, int length);
+	virtual ~FileSegment();
+
+	bool IsFileSegment() const override { return true; }
+	// Throws if the data view is not a file segment.
+	static const FileSegment* From(const std::shared_ptr<const DataView> &data_view);
+
+	Handle GetFileHandle() const { return *file_handle_; }
+	std::uint64_t GetOffset() const { return offset_; }
+
+	// The remaining range after length bytes were written (nullptr if nothing remains).
+	std::shared_ptr<const DataView> Advance(int length) const;
+	// Reads (up to) the first length bytes of the range - returns nullptr if the file could not be read.
+	std::shared_ptr<const DataView> Read(int length) const;
+
+private:
+	std::shared_ptr<const Handle> file_handle_; // Closed once no segment references it.
+	const std::uint64_t offset_;
+};
+
+}
+
+#endif /* LIB_FILE_SEGMENT_H_ */
@@ -0,0 +1,155 @@
+/*
+ * file_thread_pool.cc
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#include "config.h"
+#include "file_thread_pool.h"
+#include "log.h"
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
+
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <system_error>
+#include <thread>
+
+namespace ael {
+
+class FileWorkers {
+public:
+	struct Job {
+		FileOperation *operation;
+		std::shared_ptr<FileThreadPool::Completions> completions;
+	};
+
+	// Never destroyed - the worker threads are detached and may be blocked on the disk when the process exits.
+	static FileWorkers& Get() {
+		static FileWorkers *file_workers = new FileWorkers(GLOBAL_CONFIG.file_io_threads_);
+		return *file_workers;
+	}
+
+	void Push(std::vector<Job> &jobs) {
+		lock_.lock();
+		jobs_.insert(jobs_.end(), jobs.begin(), jobs.end());
+		lock_.unlock();
+
+		if (jobs.size() == 1) {
+			cond_.notify_one();
+		} else {
+			cond_.notify_all();
+		}
+	}
+
+private:
+	FileWorkers(std::uint32_t threads) {
+		LOG_DEBUG("file workers are starting threads=" << threads);
+		for (std::uint32_t i = 0; i < (threads > 0 ? threads : 1); i++) {
+			std::thread(&FileWorkers::Run, this).detach();
+		}
+	}
+
+	void Run() {
+		for (;;) {
+			std::unique_lock<std::mutex> guard(lock_);
+			cond_.wait(guard, [this] { return !jobs_.empty(); });
+			auto job = jobs_.front();
+			jobs_.pop_front();
+			guard.unlock();
+
+			job.operation->result = Execute(job.operation);
+
+			// Notified under the lock - once the completion is reaped the notify handle may be closed (see FileIO::~FileIO).
+			// The event loop takes all the completed operations at once - one notification is enough.
+			job.completions->lock.lock();
+			if (job.completions->completed.empty() && eventfd_write(job.completions->notify_handle, 1) != 0) {
+				LOG_WARN("file workers notify failed error=" << std::strerror(errno));
+			}
+			job.completions->completed.push_back(job.operation);
+			job.completions->lock.unlock();
+			job.completions->cond.notify_one();
+		}
+	}
+
+	static std::int64_t Execute(const FileOperation *operation) {
+		ssize_t ret;
+
+		do {
+			switch (operation->type) {
+			case FileOperation::READ:
+				ret = pread(operation->file_handle, operation->buf, operation->length, operation->offset);
+				break;
+			case FileOperation::WRITE:
+				ret = pwrite(operation->file_handle, operation->buf, operation->length, operation->offset);
+				break;
+			case FileOperation::FSYNC:
+				ret = fsync(operation->file_handle);
+				break;
+			case FileOperation::FDATASYNC:
+				ret = fdatasync(operation->file_handle);
+				break;
+			default:
+				ret = -1;
+				errno = EINVAL;
+				break;
+			}
+		} while (ret < 0 && errno == EINTR);
+
+		return ret < 0 ? -errno : ret;
+	}
+
+	std::mutex lock_;
+	std::condition_variable cond_;
+	std::deque<Job> jobs_;
+};
+
+FileThreadPool::FileThreadPool(Handle notify_handle) : completions_(std::make_shared<Completions>()) {
+	completions_->notify_handle = notify_handle;
+}
+
+FileThreadPool::~FileThreadPool() {}
+
+void FileThreadPool::Submit(FileOperation *operation) {
+	pending_.push_back(operation);
+}
+
+void FileThreadPool::Flush() {
+	if (pending_.empty()) {
+		return;
+	}
+
+	std::vector<FileWorkers::Job> jobs;
+	jobs.reserve(pending_.size());
+	for (auto operation : pending_) {
+		jobs.push_back({ operation, completions_ });
+	}
+	pending_.clear();
+
+	LOG_TRACE("file thread pool submitting jobs=" << jobs.size());
+
+	FileWorkers::Get().Push(jobs);
+}
+
+void FileThreadPool::Reap(std::vector<FileOperation*> &completed) {
+	std::lock_guard<std::mutex> guard(completions_->lock);
+	completed.insert(completed.end(), completions_->completed.begin(), completions_->completed.end());
+	completions_->completed.clear();
+}
+
+void FileThreadPool::Wait() {
+	Flush();
+
+	std::unique_lock<std::mutex> guard(completions_->lock);
+	completions_->cond.wait(guard, [this] { return !completions_->completed.empty(); });
+}
+
+}
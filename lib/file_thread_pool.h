@@ -0,0 +1,45 @@
+/*
+ * file_thread_pool.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#ifndef LIB_FILE_THREAD_POOL_H_
+#define LIB_FILE_THREAD_POOL_H_
+
+#include <condition_variable>
+#include <mutex>
+
+#include "file_io_engine.h"
+
+namespace ael {
+
+// A file I/O engine that executes the operations with blocking system calls on a process wide pool of
+// Config::file_io_threads_ threads (started on first use). Completions are signaled by writing to the notify handle.
+class FileThreadPool : public FileIOEngine {
+public:
+	FileThreadPool(Handle notify_handle);
+	virtual ~FileThreadPool();
+
+	struct Completions {
+		Handle notify_handle;
+		std::mutex lock;
+		std::condition_variable cond;
+		std::vector<FileOperation*> completed;
+	};
+
+private:
+	void Submit(FileOperation *operation) override;
+	void Flush() override;
+	void Reap(std::vector<FileOperation*> &completed) override;
+	void Wait() override;
+	bool IsIOUring() const override { return false; }
+
+	std::shared_ptr<Completions> completions_;
+	std::vector<FileOperation*> pending_; // Submitted and not yet handed to the thread pool.
+};
+
+}
+
+#endif /* LIB_FILE_THREAD_POOL_H_ */
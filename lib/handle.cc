@@ -29,6 +29,13 @@
 #include <arpa/inet.h>
 #endif
 
+#ifdef HAVE_SYS_UN_H
+#include <sys/un.h>
+#endif
+
+#include <cstddef>
+#include <cstring>
+
 namespace ael {
 
 std::ostream& operator<<(std::ostream &out, const Handle handle) {
@@ -82,11 +89,31 @@ struct SockAddr {
 	int domain;
 	sockaddr_in in4;
 	sockaddr_in6 in6;
+	sockaddr_un un;
 };
 
 static void GetSockAddr(const std::string &ip_addr, std::uint16_t port, SockAddr *sock_addr) {
 	sock_addr->addr = nullptr;
 
+	// A Unix domain socket path (a leading '@' is an abstract socket address) - the port is ignored.
+	if (!ip_addr.empty() && (ip_addr[0] == '/' || ip_addr[0] == '@')) {
+		sock_addr->un = {};
+		if (ip_addr.length() >= sizeof(sock_addr->un.sun_path)) {
+			throw "invalid host - unix domain socket path is too long";
+		}
+
+		auto abstract = ip_addr[0] == '@';
+		sock_addr->un.sun_family = AF_UNIX;
+		std::memcpy(sock_addr->un.sun_path, ip_addr.c_str(), ip_addr.length());
+		if (abstract) {
+			sock_addr->un.sun_path[0] = '\0';
+		}
+		sock_addr->addr = reinterpret_cast<sockaddr*>(&sock_addr->un);
+		sock_addr->addr_size = offsetof(sockaddr_un, sun_path) + ip_addr.length() + (abstract ? 0 : 1);
+		sock_addr->domain = AF_UNIX;
+		return;
+	}
+
 	// Try IPv4.
 	sock_addr->in4 = {};
 	if (inet_pton(AF_INET, ip_addr.c_str(), &sock_addr->in4.sin_addr) == 1) {
@@ -172,6 +199,31 @@ Handle Handle::CreateStreamHandle(const std::string &ip_addr, std::uint16_t port
 	return fd;
 }
 
+Handle Handle::CreateDatagramHandle(const std::string &ip_addr, std::uint16_t port) {
+	SockAddr sock_addr;
+
+	GetSockAddr(ip_addr, port, &sock_addr);
+
+	if (sock_addr.domain == AF_UNIX) {
+		throw "unix domain datagram sockets are not supported";
+	}
+
+	auto fd = socket(sock_addr.domain, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		throw std::system_error(errno, std::system_category(), "socket failed");
+	}
+
+	if (bind(fd, sock_addr.addr, sock_addr.addr_size) != 0) {
+		auto error = errno;
+		close(fd);
+		throw std::system_error(error, std::system_category(), "bind failed");
+	}
+
+	LOG_TRACE("created descriptor for datagram socket " << "fd=" << fd << " ip_addr=" << ip_addr << " port=" << port);
+
+	return fd;
+}
+
 void Handle::Close() {
 	close(fd_);
 }
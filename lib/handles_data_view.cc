@@ -0,0 +1,50 @@
+/*
+ * handles_data_view.cc
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#include "config.h"
+#include "handles_data_view.h"
+
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+namespace ael {
+
+static const std::uint8_t* CopyData(const DataView &data_view) {
+	auto data = new std::uint8_t[data_view.GetDataLength()];
+	std::memcpy(data, data_view.GetData(), data_view.GetDataLength());
+	return data;
+}
+
+HandlesDataView::HandlesDataView(const DataView &data_view, const std::vector<Handle> &handles) :
+		DataView(CopyData(data_view), data_view.GetDataLength(), true) {
+	handles_.reserve(handles.size());
+
+	for (auto handle : handles) {
+		auto fd = fcntl(handle, F_DUPFD_CLOEXEC, 0);
+		if (fd < 0) {
+			auto error = errno;
+			for (auto &duplicate : handles_) {
+				duplicate.Close();
+			}
+			throw std::system_error(error, std::system_category(), "fcntl - F_DUPFD_CLOEXEC - failed");
+		}
+		handles_.push_back(fd);
+	}
+}
+
+HandlesDataView::~HandlesDataView() {
+	for (auto &handle : handles_) {
+		handle.Close();
+	}
+}
+
+}
@@ -0,0 +1,35 @@
+/*
+ * handles_data_view.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#ifndef LIB_HANDLES_DATA_VIEW_H_
+#define LIB_HANDLES_DATA_VIEW_H_
+
+#include <vector>
+
+#include "data_view.h"
+#include "handle.h"
+
+namespace ael {
+
+// Written data with handles attached (passed to the peer of a Unix domain stream as SCM_RIGHTS ancillary data).
+// The data is copied and the handles are duplicated - the duplicates are closed once the data view is destroyed.
+class HandlesDataView : public DataView {
+public:
+	HandlesDataView(const DataView &data_view, const std::vector<Handle> &handles);
+	virtual ~HandlesDataView();
+
+	static const std::size_t max_handles = 253; // The kernel limit of handles per message (SCM_MAX_FD).
+
+	const std::vector<Handle>& GetHandles() const { return handles_; }
+
+private:
+	std::vector<Handle> handles_;
+};
+
+}
+
+#endif /* LIB_HANDLES_DATA_VIEW_H_ */
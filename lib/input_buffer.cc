@@ -0,0 +1,159 @@
+/*
+ * input_buffer.cc
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#include "input_buffer.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace ael {
+
+InputBuffer::InputBuffer() : offset_(0), data_length_(0) {}
+
+InputBuffer::~InputBuffer() {}
+
+void InputBuffer::Append(std::shared_ptr<const DataView> data_view) {
+	if (!data_view || data_view->GetDataLength() == 0) {
+		return;
+	}
+
+	data_length_ += data_view->GetDataLength();
+	segments_.push_back(data_view);
+}
+
+void InputBuffer::Clear() {
+	segments_.clear();
+	offset_ = 0;
+	data_length_ = 0;
+}
+
+DataView InputBuffer::Peek(int data_length) {
+	if (data_length < 0 || data_length > data_length_) {
+		throw std::out_of_range("the peek length is larger than data length");
+	}
+
+	if (data_length == 0) {
+		return DataView();
+	}
+
+	auto &first = segments_.front();
+	if (offset_ + data_length <= first->GetDataLength()) {
+		return DataView(first->GetData() + offset_, data_length);
+	}
+
+	// The range spans multiple segments - merge the segments it covers into one.
+	auto merged_length = 0;
+	auto segments_count = 0;
+	for (auto segment_it = segments_.begin(); merged_length < data_length; ++segment_it) {
+		merged_length += (*segment_it)->GetDataLength() - (segments_count == 0 ? offset_ : 0);
+		segments_count++;
+	}
+
+	auto merged_data = new std::uint8_t[merged_length];
+	auto merged_offset = 0;
+	for (auto i = 0; i < segments_count; i++) {
+		auto &segment = segments_.front();
+		auto segment_offset = i == 0 ? offset_ : 0;
+		std::memcpy(merged_data + merged_offset, segment->GetData() + segment_offset, segment->GetDataLength() - segment_offset);
+		merged_offset += segment->GetDataLength() - segment_offset;
+		segments_.pop_front();
+	}
+
+	segments_.push_front(std::shared_ptr<const DataView>(new DataView(merged_data, merged_length, true)));
+	offset_ = 0;
+
+	return DataView(merged_data, data_length);
+}
+
+bool InputBuffer::Matches(std::deque<std::shared_ptr<const DataView>>::const_iterator segment_it, int offset, const DataView &delimiter) const {
+	for (auto i = 0; i < delimiter.GetDataLength(); i++) {
+		while (offset == (*segment_it)->GetDataLength()) {
+			++segment_it;
+			offset = 0;
+			if (segment_it == segments_.end()) {
+				return false;
+			}
+		}
+
+		if ((*segment_it)->GetData()[offset] != delimiter.GetData()[i]) {
+			return false;
+		}
+
+		offset++;
+	}
+
+	return true;
+}
+
+int InputBuffer::Find(const DataView &delimiter, int start_index) const {
+	if (delimiter.GetDataLength() == 0 || start_index < 0 || start_index + delimiter.GetDataLength() > data_length_) {
+		return -1;
+	}
+
+	auto index = 0; // Index of the first readable byte of the current segment.
+	auto offset = offset_;
+
+	for (auto segment_it = segments_.begin(); segment_it != segments_.end(); ++segment_it) {
+		auto &segment = *segment_it;
+		auto segment_length = segment->GetDataLength() - offset;
+
+		if (index + segment_length <= start_index) {
+			index += segment_length;
+			offset = 0;
+			continue;
+		}
+
+		auto search_offset = offset + (start_index > index ? start_index - index : 0);
+
+		while (search_offset < segment->GetDataLength()) {
+			auto found = static_cast<const std::uint8_t*>(std::memchr(segment->GetData() + search_offset, delimiter.GetData()[0], segment->GetDataLength() - search_offset));
+			if (found == nullptr) {
+				break;
+			}
+
+			auto found_offset = static_cast<int>(found - segment->GetData());
+			auto found_index = index + found_offset - offset;
+
+			if (found_index + delimiter.GetDataLength() > data_length_) {
+				return -1;
+			}
+
+			if (Matches(segment_it, found_offset, delimiter)) {
+				return found_index;
+			}
+
+			search_offset = found_offset + 1;
+		}
+
+		index += segment_length;
+		offset = 0;
+	}
+
+	return -1;
+}
+
+void InputBuffer::Consume(int data_length) {
+	if (data_length < 0 || data_length > data_length_) {
+		throw std::out_of_range("the consume length is larger than data length");
+	}
+
+	data_length_ -= data_length;
+
+	while (data_length > 0) {
+		auto segment_length = segments_.front()->GetDataLength() - offset_;
+		if (data_length < segment_length) {
+			offset_ += data_length;
+			return;
+		}
+
+		data_length -= segment_length;
+		segments_.pop_front();
+		offset_ = 0;
+	}
+}
+
+} /* namespace ael */
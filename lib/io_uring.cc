@@ -0,0 +1,243 @@
+/*
+ * io_uring.cc
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#include "config.h"
+#include "io_uring.h"
+#include "log.h"
+
+#ifdef HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+#include <vector>
+
+namespace ael {
+
+#ifdef HAVE_LINUX_IO_URING_H
+
+IOUring::IOUring() :
+		ring_fd_(-1),
+		sq_ring_(MAP_FAILED),
+		sq_ring_size_(0),
+		cq_ring_(MAP_FAILED),
+		cq_ring_size_(0),
+		sqes_(static_cast<io_uring_sqe*>(MAP_FAILED)),
+		sqes_size_(0),
+		sq_tail_(nullptr),
+		sq_mask_(0),
+		sq_array_(nullptr),
+		cq_head_(nullptr),
+		cq_tail_(nullptr),
+		cq_mask_(0),
+		cqes_(nullptr),
+		to_submit_(0) {}
+
+IOUring::~IOUring() {
+	if (sqes_ != MAP_FAILED) {
+		munmap(sqes_, sqes_size_);
+	}
+
+	if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) {
+		munmap(cq_ring_, cq_ring_size_);
+	}
+
+	if (sq_ring_ != MAP_FAILED) {
+		munmap(sq_ring_, sq_ring_size_);
+	}
+
+	if (ring_fd_ >= 0) {
+		close(ring_fd_);
+	}
+}
+
+std::unique_ptr<IOUring> IOUring::Create(Handle notify_handle, std::uint32_t entries) {
+	std::unique_ptr<IOUring> io_uring(new IOUring);
+
+	if (!io_uring->Setup(notify_handle, entries)) {
+		return nullptr;
+	}
+
+	LOG_DEBUG("io_uring is created ring_fd=" << io_uring->ring_fd_ << " entries=" << entries);
+
+	return io_uring;
+}
+
+bool IOUring::Setup(Handle notify_handle, std::uint32_t entries) {
+	io_uring_params params = {};
+
+	ring_fd_ = syscall(__NR_io_uring_setup, entries, &params);
+	if (ring_fd_ < 0) {
+		LOG_DEBUG("io_uring is not supported error=" << std::strerror(errno));
+		return false;
+	}
+
+	sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+	}
+
+	sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+	if (sq_ring_ == MAP_FAILED) {
+		LOG_WARN("io_uring submission ring mmap failed error=" << std::strerror(errno));
+		return false;
+	}
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		cq_ring_ = sq_ring_;
+	} else {
+		cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+		if (cq_ring_ == MAP_FAILED) {
+			LOG_WARN("io_uring completion ring mmap failed error=" << std::strerror(errno));
+			return false;
+		}
+	}
+
+	sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+	sqes_ = static_cast<io_uring_sqe*>(mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES));
+	if (sqes_ == MAP_FAILED) {
+		LOG_WARN("io_uring submission entries mmap failed error=" << std::strerror(errno));
+		return false;
+	}
+
+	auto sq_ring = static_cast<std::uint8_t*>(sq_ring_);
+	sq_tail_ = reinterpret_cast<unsigned*>(sq_ring + params.sq_off.tail);
+	sq_mask_ = *reinterpret_cast<unsigned*>(sq_ring + params.sq_off.ring_mask);
+	sq_array_ = reinterpret_cast<unsigned*>(sq_ring + params.sq_off.array);
+
+	auto cq_ring = static_cast<std::uint8_t*>(cq_ring_);
+	cq_head_ = reinterpret_cast<unsigned*>(cq_ring + params.cq_off.head);
+	cq_tail_ = reinterpret_cast<unsigned*>(cq_ring + params.cq_off.tail);
+	cq_mask_ = *reinterpret_cast<unsigned*>(cq_ring + params.cq_off.ring_mask);
+	cqes_ = reinterpret_cast<io_uring_cqe*>(cq_ring + params.cq_off.cqes);
+
+	if (!IsSupported()) {
+		return false;
+	}
+
+	int notify_fd = notify_handle;
+	if (syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_EVENTFD, &notify_fd, 1) != 0) {
+		LOG_WARN("io_uring eventfd registration failed error=" << std::strerror(errno));
+		return false;
+	}
+
+	return true;
+}
+
+bool IOUring::IsSupported() {
+	// IORING_OP_READ and IORING_OP_WRITE were added after io_uring itself (the probe is as old as they are).
+	const unsigned ops_count = 256;
+	std::vector<std::uint8_t> buf(sizeof(io_uring_probe) + ops_count * sizeof(io_uring_probe_op));
+	auto probe = reinterpret_cast<io_uring_probe*>(buf.data());
+
+	if (syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_PROBE, probe, ops_count) != 0) {
+		LOG_DEBUG("io_uring probe is not supported error=" << std::strerror(errno));
+		return false;
+	}
+
+	for (auto op : { IORING_OP_READ, IORING_OP_WRITE, IORING_OP_FSYNC }) {
+		if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+			LOG_DEBUG("io_uring operation is not supported op=" << op);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void IOUring::Submit(FileOperation *operation) {
+	auto tail = *sq_tail_; // The submission ring tail is only written by this thread.
+	auto index = tail & sq_mask_;
+
+	auto sqe = &sqes_[index];
+	std::memset(sqe, 0, sizeof(*sqe));
+	sqe->fd = operation->file_handle;
+	sqe->user_data = reinterpret_cast<std::uint64_t>(operation);
+
+	switch (operation->type) {
+	case FileOperation::READ:
+	case FileOperation::WRITE:
+		sqe->opcode = operation->type == FileOperation::READ ? IORING_OP_READ : IORING_OP_WRITE;
+		sqe->addr = reinterpret_cast<std::uint64_t>(operation->buf);
+		sqe->len = operation->length;
+		sqe->off = operation->offset;
+		break;
+	case FileOperation::FSYNC:
+	case FileOperation::FDATASYNC:
+		sqe->opcode = IORING_OP_FSYNC;
+		sqe->fsync_flags = operation->type == FileOperation::FDATASYNC ? IORING_FSYNC_DATASYNC : 0;
+		break;
+	}
+
+	sq_array_[index] = index;
+	__atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+	to_submit_++;
+}
+
+void IOUring::Flush() {
+	while (to_submit_ > 0) {
+		auto ret = syscall(__NR_io_uring_enter, ring_fd_, to_submit_, 0, 0, nullptr, 0);
+		if (ret < 0) {
+			switch (errno) {
+			case EINTR:
+				continue;
+			case EAGAIN:
+			case EBUSY:
+				// Submitted once completions are reaped.
+				LOG_DEBUG("io_uring submit would block ring_fd=" << ring_fd_ << " to_submit=" << to_submit_);
+				return;
+			default:
+				throw std::system_error(errno, std::system_category(), "io_uring_enter failed");
+			}
+		}
+
+		LOG_TRACE("io_uring submitted ring_fd=" << ring_fd_ << " submitted=" << ret << " to_submit=" << to_submit_);
+
+		if (ret == 0) {
+			return;
+		}
+
+		to_submit_ -= ret;
+	}
+}
+
+void IOUring::Reap(std::vector<FileOperation*> &completed) {
+	auto head = *cq_head_; // The completion ring head is only written by this thread.
+	auto tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+
+	for (; head != tail; head++) {
+		auto cqe = &cqes_[head & cq_mask_];
+		auto operation = reinterpret_cast<FileOperation*>(cqe->user_data);
+		operation->result = cqe->res;
+		completed.push_back(operation);
+	}
+
+	__atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+}
+
+void IOUring::Wait() {
+	Flush();
+
+	if (syscall(__NR_io_uring_enter, ring_fd_, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno != EINTR) {
+		throw std::system_error(errno, std::system_category(), "io_uring_enter failed");
+	}
+}
+
+#endif
+
+}
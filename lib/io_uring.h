@@ -0,0 +1,57 @@
+/*
+ * io_uring.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#ifndef LIB_IO_URING_H_
+#define LIB_IO_URING_H_
+
+#include "file_io_engine.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace ael {
+
+// A file I/O engine over io_uring (raw system calls). Completions are signaled through a registered eventfd.
+class IOUring : public FileIOEngine {
+public:
+	virtual ~IOUring();
+
+	// Returns nullptr if io_uring (or one of the required operations) is not supported.
+	static std::unique_ptr<IOUring> Create(Handle notify_handle, std::uint32_t entries);
+
+private:
+	IOUring();
+
+	void Submit(FileOperation *operation) override;
+	void Flush() override;
+	void Reap(std::vector<FileOperation*> &completed) override;
+	void Wait() override;
+	bool IsIOUring() const override { return true; }
+
+	bool Setup(Handle notify_handle, std::uint32_t entries);
+	bool IsSupported();
+
+	int ring_fd_;
+	void *sq_ring_;
+	std::size_t sq_ring_size_;
+	void *cq_ring_;
+	std::size_t cq_ring_size_;
+	io_uring_sqe *sqes_;
+	std::size_t sqes_size_;
+	unsigned *sq_tail_;
+	unsigned sq_mask_;
+	unsigned *sq_array_;
+	unsigned *cq_head_;
+	unsigned *cq_tail_;
+	unsigned cq_mask_;
+	io_uring_cqe *cqes_;
+	unsigned to_submit_; // Queued in the submission ring and not yet submitted (io_uring_enter).
+};
+
+}
+
+#endif /* LIB_IO_URING_H_ */
@@ -0,0 +1,86 @@
+/*
+ * mpsc_queue.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#ifndef LIB_MPSC_QUEUE_H_
+#define LIB_MPSC_QUEUE_H_
+
+#include <atomic>
+
+namespace ael {
+
+class MPSCNode {
+public:
+	MPSCNode() : next_(nullptr) {}
+
+private:
+	std::atomic<MPSCNode*> next_;
+
+	template<typename T>
+	friend class MPSCQueue;
+};
+
+// An intrusive lock-free multi producer single consumer queue (D. Vyukov).
+// T must derive from MPSCNode. The queue does not own the nodes.
+template<typename T>
+class MPSCQueue {
+public:
+	MPSCQueue() : head_(&stub_), tail_(&stub_) {}
+
+	// May be called from any thread.
+	void Push(T *node) {
+		PushNode(node);
+	}
+
+	// Must be called by a single consumer. Returns nullptr if empty (or if a push is still in progress - the producer completes it right after).
+	T* Pop() {
+		auto tail = tail_;
+		auto next = tail->next_.load(std::memory_order_acquire);
+
+		if (tail == &stub_) {
+			if (next == nullptr) {
+				return nullptr;
+			}
+			tail_ = next;
+			tail = next;
+			next = next->next_.load(std::memory_order_acquire);
+		}
+
+		if (next != nullptr) {
+			tail_ = next;
+			return static_cast<T*>(tail);
+		}
+
+		if (tail != head_.load(std::memory_order_acquire)) {
+			return nullptr;
+		}
+
+		PushNode(&stub_);
+
+		next = tail->next_.load(std::memory_order_acquire);
+		if (next != nullptr) {
+			tail_ = next;
+			return static_cast<T*>(tail);
+		}
+
+		return nullptr;
+	}
+
+private:
+	void PushNode(MPSCNode *node) {
+		node->next_.store(nullptr, std::memory_order_relaxed);
+		auto prev = head_.exchange(node, std::memory_order_acq_rel);
+		prev->next_.store(node, std::memory_order_release);
+	}
+
+	std::atomic<MPSCNode*> head_; // Producers side.
+	MPSCNode *tail_; // Consumer side.
+	MPSCNode stub_;
+};
+
+}
+
+#endif /* LIB_MPSC_QUEUE_H_ */
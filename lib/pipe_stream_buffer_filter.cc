@@ -0,0 +1,294 @@
+/*
+ * pipe_stream_buffer_filter.cc
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#include "pipe_stream_buffer_filter.h"
+#include "file_segment.h"
+#include "log.h"
+#include "config.h"
+
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+
+#ifdef HAVE_SIGNAL_H
+#include <pthread.h>
+#include <signal.h>
+#endif
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace ael {
+
+std::ostream& operator<<(std::ostream &out, const PipeStreamBufferFilter *filter) {
+	const StreamBufferFilter *stream_buffer_filter = filter;
+	out << stream_buffer_filter << " handle=" << filter->handle_;
+	return out;
+}
+
+PipeStreamBufferFilter::PipeStreamBufferFilter(std::shared_ptr<StreamBuffer> stream_buffer, Handle handle, StreamBuffer::PipeKind pipe_kind) :
+		StreamBufferFilter(stream_buffer),
+		handle_(handle),
+		flags_(0),
+		readable_(true),
+		writable_(true),
+		fifo_(false),
+		sigpipe_ignored_(false),
+		eventfd_(false),
+		reader_closed_(false) {
+	flags_ = fcntl(handle_, F_GETFL);
+	if (flags_ < 0) {
+		throw std::system_error(errno, std::system_category(), "fcntl - F_GETFL - failed");
+	}
+
+	if (!(flags_ & O_NONBLOCK) && fcntl(handle_, F_SETFL, flags_ | O_NONBLOCK) < 0) {
+		throw std::system_error(errno, std::system_category(), "fcntl - F_SETFL - failed");
+	}
+
+	readable_ = (flags_ & O_ACCMODE) != O_WRONLY;
+	writable_ = (flags_ & O_ACCMODE) != O_RDONLY;
+
+	struct stat stat_buf;
+	if (fstat(handle_, &stat_buf) == 0) {
+		if (S_ISSOCK(stat_buf.st_mode)) {
+			throw "pipe stream buffer filter created for a socket";
+		}
+		fifo_ = S_ISFIFO(stat_buf.st_mode);
+	}
+
+#ifdef HAVE_SIGNAL_H
+	struct sigaction sigpipe_action;
+	if (fifo_ && sigaction(SIGPIPE, nullptr, &sigpipe_action) == 0) {
+		sigpipe_ignored_ = sigpipe_action.sa_handler == SIG_IGN;
+	}
+#endif
+
+	// An eventfd is written a 64 bit counter value at a time.
+	if (pipe_kind == StreamBuffer::DETECT_PIPE) {
+		char link[64];
+		auto link_path = "/proc/self/fd/" + std::to_string(static_cast<int>(handle_));
+		auto link_length = readlink(link_path.c_str(), link, sizeof(link));
+		eventfd_ = link_length > 0 && std::string(link, link_length) == "anon_inode:[eventfd]";
+	} else {
+		eventfd_ = pipe_kind == StreamBuffer::EVENTFD_PIPE;
+	}
+	if (eventfd_) {
+		SetWriteLength(sizeof(std::uint64_t));
+	}
+}
+
+PipeStreamBufferFilter::~PipeStreamBufferFilter() {
+	if (!(flags_ & O_NONBLOCK)) {
+		LOG_TRACE("restoring blocking mode " << this);
+		fcntl(handle_, F_SETFL, flags_);
+	}
+}
+
+std::shared_ptr<PipeStreamBufferFilter> PipeStreamBufferFilter::Create(std::shared_ptr<StreamBuffer> stream_buffer, Handle handle, StreamBuffer::PipeKind pipe_kind) {
+	LOG_TRACE("creating a pipe stream buffer filter handle=" << handle << " pipe_kind=" << pipe_kind);
+	return std::shared_ptr<PipeStreamBufferFilter>(new PipeStreamBufferFilter(stream_buffer, handle, pipe_kind));
+}
+
+InResult PipeStreamBufferFilter::In() {
+	if (!readable_) {
+		// The write end of a pipe is never readable - it is read closed once the reader is gone.
+		return reader_closed_ ? InResult::CreateShouldClose() : InResult();
+	}
+
+	// Reused by every stream of the event loop thread, the data is handed over borrowed (copied only when it has to be kept).
+	// A handler still using the data it borrowed (e.g. it runs the event loop) is not overwritten - a saved copy is returned.
+	static thread_local std::vector<std::uint8_t> shared_buf;
+	std::vector<std::uint8_t> nested_buf;
+	auto borrowed = !IsHandlingData();
+	auto &buf = borrowed ? shared_buf : nested_buf;
+	buf.resize(GLOBAL_CONFIG.read_buffer_size_);
+
+	auto read_ret = read(handle_, buf.data(), buf.size());
+
+	switch (read_ret) {
+	case 0:
+		LOG_DEBUG("read EOF " << this);
+		return InResult::CreateShouldClose();
+	case -1:
+		switch (errno) {
+		case EAGAIN:
+		case EINTR:
+			LOG_DEBUG("read would block " << this);
+			return InResult();
+		case EFAULT:
+		case EINVAL:
+		case EBADF:
+			throw std::system_error(errno, std::system_category(), "read failed");
+		default:
+			// E.g. EIO - a tty hang up.
+			LOG_DEBUG("read EOF with error " << this << " error=" << std::strerror(errno));
+			return InResult::CreateShouldClose();
+		}
+		break;
+	default:
+		LOG_DEBUG("read " << read_ret << " bytes " << this);
+		return borrowed ? InResult::CreateBorrowed(DataView(buf.data(), read_ret)) : InResult(buf.data(), read_ret);
+	}
+}
+
+OutResult PipeStreamBufferFilter::Out(std::shared_ptr<const DataView> &data_view) {
+	if (!writable_) {
+		LOG_WARN("write to a read only handle " << this);
+		return OutResult::CreateShouldClose();
+	}
+
+	auto write_ret = Write(*data_view);
+
+	if (write_ret == -1) {
+		switch (errno) {
+		case EAGAIN:
+		case EINTR:
+			LOG_DEBUG("write would block " << this);
+			return OutResult();
+		case EINVAL:
+			if (eventfd_) {
+				// The length is checked by StreamBuffer::Write() - the value is invalid (the maximal counter value).
+				LOG_WARN("invalid eventfd value - dropped " << this);
+				data_view = nullptr;
+				return OutResult();
+			}
+			throw std::system_error(errno, std::system_category(), "write failed");
+		case EBADF:
+		case EFAULT:
+			throw std::system_error(errno, std::system_category(), "write failed");
+		default:
+			LOG_DEBUG("pipe stream buffer filter write no longer writable " << this << " error=" << std::strerror(errno));
+			return OutResult::CreateShouldClose();
+		}
+	}
+
+	LOG_DEBUG("write " << write_ret << " bytes " << this);
+
+	if (write_ret == 0) {
+		throw "write return 0 (kernel bug?)";
+	}
+
+	if (write_ret < data_view->GetDataLength()) {
+		data_view = data_view->Slice(write_ret).Save();
+		LOG_TRACE("partial write " <<  data_view->GetDataLength() << " bytes left id=" << this);
+	} else {
+		data_view = nullptr;
+	}
+
+	return OutResult();
+}
+
+int PipeStreamBufferFilter::Write(const DataView &data_view) {
+#ifdef HAVE_SIGNAL_H
+	if (fifo_ && !sigpipe_ignored_) {
+		// Unlike send (MSG_NOSIGNAL), a write to a pipe without a reader raises SIGPIPE - it is blocked for this thread during
+		// the write, and the SIGPIPE the write raised is consumed (the signal disposition of the process is left as is).
+		sigset_t sigpipe_set;
+		sigset_t old_set;
+		sigemptyset(&sigpipe_set);
+		sigaddset(&sigpipe_set, SIGPIPE);
+		pthread_sigmask(SIG_BLOCK, &sigpipe_set, &old_set);
+
+		sigset_t pending_set;
+		sigpending(&pending_set);
+		auto sigpipe_pending = sigismember(&pending_set, SIGPIPE) == 1;
+
+		auto write_ret = write(handle_, data_view.GetData(), data_view.GetDataLength());
+		auto write_errno = errno;
+
+		if (write_ret == -1 && write_errno == EPIPE && !sigpipe_pending) {
+			timespec timeout = { 0, 0 };
+			sigtimedwait(&sigpipe_set, nullptr, &timeout);
+		}
+
+		pthread_sigmask(SIG_SETMASK, &old_set, nullptr);
+		errno = write_errno;
+		return write_ret;
+	}
+#endif
+
+	return write(handle_, data_view.GetData(), data_view.GetDataLength());
+}
+
+OutResult PipeStreamBufferFilter::OutFile(std::shared_ptr<const DataView> &data_view) {
+	if (!fifo_ || !writable_) {
+		return StreamBufferFilter::OutFile(data_view);
+	}
+
+	while (data_view) {
+		auto file_segment = FileSegment::From(data_view);
+		loff_t offset = file_segment->GetOffset();
+
+		auto write_ret = splice(file_segment->GetFileHandle(), &offset, handle_, nullptr, file_segment->GetDataLength(), SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+		if (write_ret == -1) {
+			switch (errno) {
+			case EAGAIN:
+				LOG_DEBUG("splice would block " << this);
+				return OutResult();
+			case EINVAL:
+			case ENOSYS:
+				LOG_DEBUG("splice not supported for the file - buffered write " << this);
+				return StreamBufferFilter::OutFile(data_view);
+			default:
+				LOG_DEBUG("splice failed - no longer writable " << this << " error=" << std::strerror(errno));
+				return OutResult::CreateShouldClose();
+			}
+		}
+
+		if (write_ret == 0) {
+			LOG_WARN("splice reached the end of the file before the end of the segment (file truncated?) " << this);
+			return OutResult::CreateShouldClose();
+		}
+
+		LOG_DEBUG("splice " << write_ret << " bytes " << this);
+
+		data_view = file_segment->Advance(write_ret);
+	}
+
+	return OutResult();
+}
+
+void PipeStreamBufferFilter::Error() {
+	if (!readable_) {
+		LOG_DEBUG("error on a write only handle - reader closed " << this);
+		reader_closed_ = true;
+	}
+}
+
+ConnectResult PipeStreamBufferFilter::Accept() {
+	LOG_TRACE("accept " << this);
+	return ConnectResult::CreateSuccess();
+}
+
+ConnectResult PipeStreamBufferFilter::Connect() {
+	LOG_TRACE("connect " << this);
+	return ConnectResult::CreateSuccess();
+}
+
+ShutdownResult PipeStreamBufferFilter::Shutdown() {
+	// There is no half close - the handle is closed with the stream buffer event.
+	LOG_TRACE("shutdown " << this);
+	return ShutdownResult(true);
+}
+
+} /* namespace ael */
@@ -0,0 +1,48 @@
+/*
+ * pipe_stream_buffer_filter.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#ifndef LIB_PIPE_STREAM_BUFFER_FILTER_H_
+#define LIB_PIPE_STREAM_BUFFER_FILTER_H_
+
+#include "stream_buffer.h"
+
+namespace ael {
+
+// The transport of a non socket handle - a pipe, a character device (e.g. a tty) or an eventfd (read and write).
+class PipeStreamBufferFilter: public StreamBufferFilter {
+public:
+	PipeStreamBufferFilter(std::shared_ptr<StreamBuffer> stream_buffer, Handle handle, StreamBuffer::PipeKind pipe_kind);
+	virtual ~PipeStreamBufferFilter();
+
+	static std::shared_ptr<PipeStreamBufferFilter> Create(std::shared_ptr<StreamBuffer> stream_buffer, Handle handle, StreamBuffer::PipeKind pipe_kind);
+
+	friend std::ostream& operator<<(std::ostream &out, const PipeStreamBufferFilter *filter);
+
+private:
+	InResult In() override;
+	OutResult Out(std::shared_ptr<const DataView> &data_view) override;
+	ConnectResult Connect() override;
+	ConnectResult Accept() override;
+	ShutdownResult Shutdown() override;
+	void Error() override;
+	OutResult OutFile(std::shared_ptr<const DataView> &file_segment) override;
+
+	int Write(const DataView &data_view); // A write to a pipe without a reader does not raise SIGPIPE.
+
+	Handle handle_;
+	int flags_; // The file status flags are restored once the filter is destroyed (the open file description may be shared).
+	bool readable_;
+	bool writable_;
+	bool fifo_; // File segments are spliced into the pipe.
+	bool sigpipe_ignored_; // SIGPIPE was ignored once the filter was created - a write does not block it.
+	bool eventfd_;
+	bool reader_closed_; // A write only handle has an error event - the reader is gone.
+};
+
+} /* namespace ael */
+
+#endif /* LIB_PIPE_STREAM_BUFFER_FILTER_H_ */
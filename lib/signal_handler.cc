@@ -0,0 +1,148 @@
+/*
+ * signal_handler.cc
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#include "config.h"
+#include "signal_handler.h"
+#include "log.h"
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_SIGNAL_H
+#include <signal.h>
+#endif
+
+#ifdef HAVE_SYS_SIGNALFD_H
+#include <sys/signalfd.h>
+#endif
+
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <system_error>
+#include <unordered_set>
+
+namespace ael {
+
+// The signals handled by a signal handler - a signal is consumed by the first signalfd that reads it.
+static std::mutex handled_lock;
+static std::unordered_set<int> handled;
+
+static sigset_t ToSigSet(const std::vector<int> &signals) {
+	sigset_t mask;
+	sigemptyset(&mask);
+
+	for (auto signal : signals) {
+		if (signal == SIGKILL || signal == SIGSTOP) {
+			throw "SIGKILL and SIGSTOP cannot be handled";
+		}
+		if (sigaddset(&mask, signal) != 0) {
+			throw "invalid signal";
+		}
+	}
+
+	return mask;
+}
+
+void SignalHandler::Block(const std::vector<int> &signals) {
+	auto mask = ToSigSet(signals);
+
+	auto ret = pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+	if (ret != 0) {
+		throw std::system_error(ret, std::system_category(), "pthread_sigmask failed");
+	}
+}
+
+std::shared_ptr<SignalHandler> SignalHandler::Create(const std::vector<int> &signals, SignalCallback callback) {
+	if (signals.empty()) {
+		throw "no signals to handle";
+	}
+
+	auto mask = ToSigSet(signals);
+
+	std::lock_guard<std::mutex> guard(handled_lock);
+
+	for (auto signal : signals) {
+		if (handled.count(signal) > 0) {
+			throw "signal is already handled by another signal handler";
+		}
+	}
+
+	Block(signals);
+
+	auto fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+	if (fd < 0) {
+		throw std::system_error(errno, std::system_category(), "signalfd failed");
+	}
+
+	handled.insert(signals.begin(), signals.end());
+
+	return std::shared_ptr<SignalHandler>(new SignalHandler(fd, signals, callback));
+}
+
+SignalHandler::SignalHandler(Handle handle, const std::vector<int> &signals, SignalCallback callback) :
+		EventHandler(handle),
+		signals_(signals),
+		callback_(callback) {
+	LOG_DEBUG("signal handler is created " << this << " signals=" << signals_.size());
+}
+
+SignalHandler::~SignalHandler() {
+	LOG_DEBUG("signal handler is destroyed " << this);
+
+	std::lock_guard<std::mutex> guard(handled_lock);
+	for (auto signal : signals_) {
+		handled.erase(signal);
+	}
+}
+
+void SignalHandler::Close() {
+	LOG_TRACE("signal handler is closing " << this);
+	CloseEvent();
+}
+
+void SignalHandler::HandleEvents(Handle handle, Events events) {
+	LOG_TRACE("handling events " << this << " events=" << events);
+
+	if (!(events & Events::Read)) {
+		return;
+	}
+
+	signalfd_siginfo infos[16];
+
+	for (;;) {
+		auto ret = read(handle, infos, sizeof(infos));
+		if (ret < 0) {
+			switch (errno) {
+			case EAGAIN:
+				return;
+			case EINTR:
+				continue;
+			default:
+				throw std::system_error(errno, std::system_category(), "signalfd read - failed");
+			}
+		}
+
+		auto count = static_cast<std::size_t>(ret) / sizeof(signalfd_siginfo);
+		for (std::size_t i = 0; i < count; i++) {
+			auto &info = infos[i];
+			LOG_DEBUG("signal received " << this << " signal=" << info.ssi_signo << " pid=" << info.ssi_pid);
+			callback_(SignalInfo(static_cast<int>(info.ssi_signo), info.ssi_code, info.ssi_pid, info.ssi_uid, info.ssi_status));
+		}
+
+		if (count < sizeof(infos) / sizeof(signalfd_siginfo)) {
+			return; // Drained - the next signal triggers another event.
+		}
+	}
+}
+
+Events SignalHandler::GetEvents() const {
+	return Events::Read;
+}
+
+}
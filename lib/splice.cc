@@ -0,0 +1,254 @@
+/*
+ * splice.cc
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#include "config.h"
+#include "splice.h"
+#include "log.h"
+
+#ifdef HAVE_SYS_SOCKET_H
+#include <sys/socket.h>
+#endif
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+namespace ael {
+
+Splice::Splice(std::shared_ptr<StreamBuffer> first, std::shared_ptr<StreamBuffer> second, bool kernel) : kernel_(kernel) {
+	directions_[0] = { first.get(), first, second, { -1, -1 }, 0, 0, false, false, false };
+	directions_[1] = { second.get(), second, first, { -1, -1 }, 0, 0, false, false, false };
+
+	if (!kernel_) {
+		return;
+	}
+
+	for (auto &direction : directions_) {
+		if (pipe2(direction.pipe_fds, O_NONBLOCK | O_CLOEXEC) != 0) {
+			auto error = errno;
+			if (&direction != directions_) {
+				close(directions_[0].pipe_fds[0]);
+				close(directions_[0].pipe_fds[1]);
+			}
+			throw std::system_error(error, std::system_category(), "pipe2 failed");
+		}
+
+		auto pipe_size = fcntl(direction.pipe_fds[1], F_GETPIPE_SZ);
+		direction.pipe_size = pipe_size > 0 ? pipe_size : 65536;
+	}
+}
+
+Splice::~Splice() {
+	for (auto &direction : directions_) {
+		if (direction.pipe_fds[0] >= 0) {
+			close(direction.pipe_fds[0]);
+			close(direction.pipe_fds[1]);
+		}
+	}
+}
+
+Splice::Direction& Splice::GetDirectionFrom(const StreamBuffer *stream_buffer) {
+	return directions_[0].id == stream_buffer ? directions_[0] : directions_[1];
+}
+
+Splice::Direction& Splice::GetDirectionTo(const StreamBuffer *stream_buffer) {
+	return directions_[0].id == stream_buffer ? directions_[1] : directions_[0];
+}
+
+void Splice::Pump(StreamBuffer *stream_buffer, Events events) {
+	auto self = shared_from_this(); // Stop() releases the references held by the stream buffers.
+
+	auto success = true;
+
+	if (events & (Events::Read | Events::Close | Events::Error)) {
+		success = Transfer(GetDirectionFrom(stream_buffer));
+	}
+
+	if (success && (events & (Events::Write | Events::Error))) {
+		success = Transfer(GetDirectionTo(stream_buffer));
+	}
+
+	if (!success || (directions_[0].shutdown && directions_[1].shutdown)) {
+		Stop();
+	}
+}
+
+bool Splice::Transfer(Direction &direction) {
+	auto source = direction.source.lock();
+	auto destination = direction.destination.lock();
+	if (!source || !destination) {
+		return false;
+	}
+
+	if (direction.shutdown) {
+		return true;
+	}
+
+	// Data written to the destination stream buffer (e.g. before splicing) is sent first.
+	if (destination->HasPendingWrites()) {
+		destination->DoWrite();
+		if (destination->IsWriteClosed()) {
+			return false;
+		}
+	}
+
+	auto destination_ready = !destination->HasPendingWrites();
+
+	for (;;) {
+		auto progress = false;
+
+		// The pipe capacity bounds the data in flight - a slow destination pushes back on the source.
+		if (!direction.eof && direction.pipe_bytes < direction.pipe_size) {
+			auto splice_ret = splice(source->GetHandle(), nullptr, direction.pipe_fds[1], nullptr, direction.pipe_size - direction.pipe_bytes, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+			if (splice_ret > 0) {
+				direction.pipe_bytes += splice_ret;
+				progress = true;
+			} else if (splice_ret == 0) {
+				LOG_DEBUG("splice source EOF " << source.get());
+				direction.eof = true;
+			} else if (errno != EAGAIN && errno != EINTR) {
+				LOG_DEBUG("splice from source failed " << source.get() << " error=" << std::strerror(errno));
+				return false;
+			}
+		}
+
+		if (direction.pipe_bytes > 0 && destination_ready) {
+			auto splice_ret = splice(direction.pipe_fds[0], nullptr, destination->GetHandle(), nullptr, direction.pipe_bytes, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+			if (splice_ret > 0) {
+				direction.pipe_bytes -= splice_ret;
+				progress = true;
+			} else if (splice_ret < 0 && errno != EAGAIN && errno != EINTR) {
+				LOG_DEBUG("splice to destination failed " << destination.get() << " error=" << std::strerror(errno));
+				return false;
+			}
+		}
+
+		if (!progress) {
+			break;
+		}
+	}
+
+	LOG_TRACE("splice transfer " << source.get() << " -> " << destination.get() << " pipe_bytes=" << direction.pipe_bytes << " eof=" << direction.eof);
+
+	if (direction.pipe_bytes == 0 && destination_ready) {
+		ShutdownWrite(direction, destination.get());
+	}
+
+	return true;
+}
+
+void Splice::ShutdownWrite(Direction &direction, StreamBuffer *destination) {
+	if (!direction.eof || direction.shutdown) {
+		return;
+	}
+
+	// Half close - the destination may still send data in the other direction.
+	LOG_DEBUG("splice shutdown write " << destination);
+	shutdown(destination->GetHandle(), SHUT_WR);
+	direction.shutdown = true;
+}
+
+void Splice::Forward(StreamBuffer *stream_buffer, const DataView &data_view) {
+	auto &direction = GetDirectionFrom(stream_buffer);
+
+	auto destination = direction.destination.lock();
+	if (!destination) {
+		stream_buffer->Close();
+		return;
+	}
+
+	destination->Write(data_view);
+
+	if (!direction.source_paused && destination->GetQueuedBytes() > destination->write_high_watermark_) {
+		LOG_DEBUG("splice destination backpressure " << destination.get() << " - pausing source " << stream_buffer);
+		direction.source_paused = true;
+		stream_buffer->PauseRead();
+	}
+}
+
+void Splice::ReadClosed(StreamBuffer *stream_buffer) {
+	auto self = shared_from_this(); // Stop() releases the references held by the stream buffers.
+
+	auto &direction = GetDirectionFrom(stream_buffer);
+	if (direction.eof) {
+		return;
+	}
+
+	LOG_DEBUG("splice source EOF " << stream_buffer);
+	direction.eof = true;
+
+	auto destination = direction.destination.lock();
+	if (!destination) {
+		Stop();
+		return;
+	}
+
+	if (!destination->HasPendingWrites()) {
+		ShutdownWrite(direction, destination.get());
+	}
+
+	if (directions_[0].shutdown && directions_[1].shutdown) {
+		Stop();
+	}
+}
+
+void Splice::Drained(StreamBuffer *stream_buffer) {
+	auto self = shared_from_this();
+
+	auto &direction = GetDirectionTo(stream_buffer);
+
+	if (direction.eof && !stream_buffer->HasPendingWrites()) {
+		ShutdownWrite(direction, stream_buffer);
+		if (directions_[0].shutdown && directions_[1].shutdown) {
+			Stop();
+			return;
+		}
+	}
+
+	if (direction.source_paused && stream_buffer->GetQueuedBytes() <= stream_buffer->write_low_watermark_) {
+		direction.source_paused = false;
+		auto source = direction.source.lock();
+		if (source) {
+			LOG_DEBUG("splice destination drained " << stream_buffer << " - resuming source " << source.get());
+			source->ResumeRead();
+		}
+	}
+}
+
+void Splice::Closed(StreamBuffer *stream_buffer) {
+	auto self = shared_from_this();
+
+	auto destination = GetDirectionFrom(stream_buffer).destination.lock();
+	stream_buffer->splice_ = nullptr;
+
+	if (destination && destination->splice_ == self) {
+		destination->splice_ = nullptr;
+		destination->Close();
+	}
+}
+
+void Splice::Stop() {
+	LOG_DEBUG("splice stopped " << directions_[0].id << " " << directions_[1].id);
+
+	for (auto &direction : directions_) {
+		auto stream_buffer = direction.source.lock();
+		if (stream_buffer) {
+			stream_buffer->splice_ = nullptr;
+			stream_buffer->Close();
+		}
+	}
+}
+
+}
@@ -0,0 +1,65 @@
+/*
+ * splice.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#ifndef LIB_SPLICE_H_
+#define LIB_SPLICE_H_
+
+#include <memory>
+#include <cstdint>
+
+#include "stream_buffer.h"
+
+namespace ael {
+
+// Pumps the data received by each of two stream buffers to the other (see StreamBuffer::SpliceTo).
+// Shared by both stream buffers and only used in the context of their event loop.
+class Splice : public std::enable_shared_from_this<Splice> {
+public:
+	// In kernel mode the data is moved from one socket to the other through a pipe (splice) and never reaches user space.
+	Splice(std::shared_ptr<StreamBuffer> first, std::shared_ptr<StreamBuffer> second, bool kernel);
+	virtual ~Splice();
+
+	bool IsKernel() const { return kernel_; }
+
+	// Kernel mode - moves the data of the directions affected by the events of stream_buffer.
+	void Pump(StreamBuffer *stream_buffer, Events events);
+	// User space mode - writes the data received by stream_buffer to the other stream buffer.
+	void Forward(StreamBuffer *stream_buffer, const DataView &data_view);
+	// User space mode - the queued write data of stream_buffer may have drained (the other stream buffer may resume reading).
+	void Drained(StreamBuffer *stream_buffer);
+	// User space mode - stream_buffer read EOF. The write side of the other stream buffer is shut down once its queued write
+	// data is sent (the other direction is pumped until it reads EOF as well).
+	void ReadClosed(StreamBuffer *stream_buffer);
+	// stream_buffer reached EOF - the other stream buffer is closed.
+	void Closed(StreamBuffer *stream_buffer);
+
+private:
+	struct Direction {
+		const StreamBuffer *id;
+		std::weak_ptr<StreamBuffer> source;
+		std::weak_ptr<StreamBuffer> destination;
+		int pipe_fds[2];
+		std::uint32_t pipe_size;
+		std::uint32_t pipe_bytes; // Spliced from the source and not yet to the destination.
+		bool eof;
+		bool shutdown;
+		bool source_paused;
+	};
+
+	Direction& GetDirectionFrom(const StreamBuffer *stream_buffer);
+	Direction& GetDirectionTo(const StreamBuffer *stream_buffer);
+	bool Transfer(Direction &direction); // Returns false if either side failed.
+	void ShutdownWrite(Direction &direction, StreamBuffer *destination); // Once the source reached EOF and the destination drained.
+	void Stop();
+
+	const bool kernel_;
+	Direction directions_[2];
+};
+
+}
+
+#endif /* LIB_SPLICE_H_ */
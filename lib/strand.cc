@@ -0,0 +1,114 @@
+/*
+ * strand.cc
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#include "config.h"
+#include "strand.h"
+#include "mpsc_queue.h"
+#include "log.h"
+
+#include <algorithm>
+
+namespace ael {
+
+class StrandFunction : public MPSCNode {
+public:
+	StrandFunction(std::function<void()> func) : func(std::move(func)) {}
+
+	std::function<void()> func;
+};
+
+class StrandQueue : public MPSCQueue<StrandFunction> {};
+
+// The strand that is running on this thread.
+static thread_local const Strand *current_strand = nullptr;
+
+class CurrentStrandScope {
+public:
+	CurrentStrandScope(const Strand *strand) : prev_(current_strand) { current_strand = strand; }
+	~CurrentStrandScope() { current_strand = prev_; }
+
+private:
+	const Strand *prev_;
+};
+
+Strand::Strand(std::shared_ptr<EventLoop> event_loop) : event_loop_(event_loop), queue_(std::make_unique<StrandQueue>()), pending_(0) {
+	LOG_TRACE("strand is created");
+}
+
+Strand::~Strand() {
+	LOG_TRACE("strand is destroyed");
+
+	while (auto strand_function = queue_->Pop()) {
+		delete strand_function;
+	}
+}
+
+std::shared_ptr<Strand> Strand::Create(std::shared_ptr<EventLoop> event_loop) {
+	if (!event_loop) {
+		throw "strand requires an event loop";
+	}
+
+	return std::shared_ptr<Strand>(new Strand(event_loop));
+}
+
+bool Strand::IsRunningInThisThread() const {
+	return current_strand == this;
+}
+
+void Strand::Post(std::function<void()> func) {
+	queue_->Push(new StrandFunction(std::move(func)));
+
+	// Pushed before it is counted - the strand runs it once it sees the count.
+	if (pending_++ == 0) {
+		Schedule();
+	}
+}
+
+void Strand::Dispatch(std::function<void()> func) {
+	if (IsRunningInThisThread()) {
+		func();
+		return;
+	}
+
+	Post(std::move(func));
+}
+
+void Strand::Schedule() {
+	auto self = shared_from_this();
+	event_loop_->Post([self]() { self->Drain(); });
+}
+
+void Strand::Drain() {
+	CurrentStrandScope current_strand_scope(this);
+
+	// A limit below one would never drain the strand.
+	std::int64_t batch_limit = std::max<std::int64_t>(GLOBAL_CONFIG.strand_batch_limit_, 1);
+	std::int64_t pending = pending_;
+	if (pending > batch_limit) {
+		pending = batch_limit;
+	}
+
+	std::int64_t popped = 0;
+	while (popped < pending) {
+		std::unique_ptr<StrandFunction> strand_function(queue_->Pop());
+		if (!strand_function) {
+			break; // A push is still in progress.
+		}
+
+		popped++;
+		strand_function->func();
+	}
+
+	LOG_TRACE("strand handled functions count=" << popped);
+
+	// Still owned by this drain (the count was positive) - the remaining functions run in the next event loop iteration.
+	if ((pending_ -= popped) > 0) {
+		Schedule();
+	}
+}
+
+}
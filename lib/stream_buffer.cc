@@ -8,6 +8,11 @@
 #include "config.h"
 #include "stream_buffer.h"
 #include "tcp_stream_buffer_filter.h"
+#include "pipe_stream_buffer_filter.h"
+#include "write_queue.h"
+#include "file_segment.h"
+#include "handles_data_view.h"
+#include "splice.h"
 #include "async_io.h"
 #include "log.h"
 
@@ -19,8 +24,29 @@
 #include <sys/socket.h>
 #endif
 
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <system_error>
+
 namespace ael {
 
+// Handlers of received data running on this thread (nested once a data handler runs an event loop).
+static thread_local int handling_data_depth = 0;
+
+class HandlingDataScope {
+public:
+	HandlingDataScope() { handling_data_depth++; }
+	~HandlingDataScope() { handling_data_depth--; }
+};
+
 std::ostream& operator<<(std::ostream &out, const StreamBuffer *stream_buffer) {
 	const EventHandler *event_hadler = stream_buffer;
 	out << event_hadler;
@@ -30,13 +56,28 @@ std::ostream& operator<<(std::ostream &out, const StreamBuffer *stream_buffer) {
 StreamBuffer::StreamBuffer(std::shared_ptr<StreamBufferHandler> stream_buffer_handler, Handle handle, StreamBufferMode mode) :
 		EventHandler(handle),
 		stream_buffer_handler_(stream_buffer_handler),
+		write_queue_(std::make_unique<WriteQueue>()),
 		add_filter_allowed_(true),
 		eof_called_(false),
 		should_close_(false),
-		mode_(mode) {
+		mode_(mode),
+		read_paused_(false),
+		read_interest_paused_(false),
+		pending_writes_bytes_(0),
+		pending_out_bytes_(0),
+		write_low_watermark_(GLOBAL_CONFIG.write_low_watermark_),
+		write_high_watermark_(GLOBAL_CONFIG.write_high_watermark_),
+		write_backpressured_(false),
+		flush_deferred_(false),
+		handling_events_(false),
+		written_while_handling_(false) {
 	LOG_TRACE("stream buffer created " << this);
 }
 
+StreamBuffer::~StreamBuffer() {
+	LOG_TRACE("stream buffer destroyed " << this);
+}
+
 
 std::shared_ptr<StreamBuffer> StreamBuffer::Create(std::shared_ptr<StreamBufferHandler> stream_buffer_handler, Handle handle, StreamBufferMode mode) {
 	std::shared_ptr<StreamBuffer> stream_buffer(new StreamBuffer(stream_buffer_handler, handle, mode));
@@ -53,6 +94,13 @@ std::shared_ptr<StreamBuffer> StreamBuffer::CreateForClient(std::shared_ptr<Stre
 	return Create(stream_buffer_handler, handle, CLIENT_MODE);
 }
 
+std::shared_ptr<StreamBuffer> StreamBuffer::CreateForPipe(std::shared_ptr<StreamBufferHandler> stream_buffer_handler, Handle handle, PipeKind pipe_kind) {
+	std::shared_ptr<StreamBuffer> stream_buffer(new StreamBuffer(stream_buffer_handler, handle, PIPE_MODE));
+	auto pipe_stream_buffer_filter = PipeStreamBufferFilter::Create(stream_buffer, handle, pipe_kind);
+	stream_buffer->AddStreamBufferFilter(pipe_stream_buffer_filter);
+	return stream_buffer;
+}
+
 void StreamBuffer::AddStreamBufferFilter(std::shared_ptr<StreamBufferFilter> stream_filter) {
 	if (!add_filter_allowed_) {
 		throw "filter added when it is not allowed";
@@ -60,8 +108,8 @@ void StreamBuffer::AddStreamBufferFilter(std::shared_ptr<StreamBufferFilter> str
 
 	add_filter_allowed_ = false;
 
-	if (!stream_filters_.empty()) {
-		auto prev_it = stream_filters_.back();
+	if (!stream_filters_.IsEmpty()) {
+		auto prev_it = stream_filters_.Back();
 		auto prev = prev_it.get();
 		prev->next_ = stream_filter.get();
 		stream_filter->prev_ = prev;
@@ -72,7 +120,7 @@ void StreamBuffer::AddStreamBufferFilter(std::shared_ptr<StreamBufferFilter> str
 
 	LOG_DEBUG("attaching filter " << stream_filter);
 
-	stream_filters_.push_back(stream_filter);
+	stream_filters_.PushBack(stream_filter);
 }
 
 void StreamBuffer::HandleEvents(Handle, Events events) {
@@ -85,16 +133,40 @@ void StreamBuffer::HandleEvents(Handle, Events events) {
 		return;
 	}
 
+	handling_events_ = true;
+
+	if ((events & Events::Error) && IsConnected()) {
+		DoError();
+	}
+
 	if (should_close_) {
 		DoClose();
 	} else if (!IsConnected() ) {
 		DoConnect(stream_buffer_handler);
+	} else if (splice_ && splice_->IsKernel()) {
+		splice_->Pump(this, events);
 	} else {
-		DoRead();
+		// A write only event (e.g. a deferred flush) does not require reading.
+		if (events & (Events::Read | Events::Close | Events::Error)) {
+			DoRead();
+		}
 		DoWrite();
 	}
 
+	if (read_interest_paused_ != read_paused_ && IsConnected() && !eof_called_) {
+		LOG_TRACE("read interest modified " << this << " read_paused=" << read_paused_);
+		read_interest_paused_ = read_paused_;
+		ModifyEvent();
+	}
+
 	DoFinalize(stream_buffer_handler);
+
+	handling_events_ = false;
+
+	if (written_while_handling_ && IsConnected() && !eof_called_) {
+		LOG_TRACE("written while handling events (after write) " << this);
+		DeferFlush();
+	}
 }
 
 void StreamBuffer::Write(const DataView &data_view) {
@@ -103,6 +175,11 @@ void StreamBuffer::Write(const DataView &data_view) {
 		return;
 	}
 
+	auto write_length = stream_filters_[0]->write_length_;
+	if (write_length != 0 && static_cast<std::uint32_t>(data_view.GetDataLength()) != write_length) {
+		throw "write length is not supported by the handle";
+	}
+
 	if (should_close_) {
 		LOG_DEBUG("should close cannot write " << this);
 		return;
@@ -110,28 +187,187 @@ void StreamBuffer::Write(const DataView &data_view) {
 
 	LOG_DEBUG("add write " << data_view.GetDataLength() << " bytes " << this);
 
-	auto saved_data_view = data_view.Save();
+	pending_writes_bytes_ += data_view.GetDataLength();
+	write_queue_->Push(data_view);
+
+	ScheduleWrite();
+}
+
+void StreamBuffer::Write(const DataView &data_view, const std::vector<Handle> &handles) {
+	if (handles.empty()) {
+		Write(data_view);
+		return;
+	}
+
+	if (data_view.GetDataLength() == 0) {
+		throw "handles must be written with data";
+	}
+
+	if (handles.size() > HandlesDataView::max_handles) {
+		throw "too many handles";
+	}
+
+	if (stream_filters_.GetSize() > 1) {
+		throw "handles cannot be written through stream filters";
+	}
+
+	if (should_close_) {
+		LOG_DEBUG("should close cannot write " << this);
+		return;
+	}
+
+	LOG_DEBUG("add write " << data_view.GetDataLength() << " bytes " << this << " handles=" << handles.size());
+
+	pending_writes_bytes_ += data_view.GetDataLength();
+	write_queue_->Push(std::make_shared<HandlesDataView>(data_view, handles));
+
+	ScheduleWrite();
+}
+
+void StreamBuffer::WriteFile(Handle file_handle, std::uint64_t offset, std::uint64_t length) {
+	if (length == 0) {
+		LOG_WARN("trying to write 0 file data " << this);
+		return;
+	}
+
+	if (stream_filters_[0]->write_length_ != 0) {
+		throw "file data cannot be written to the handle (fixed write length)";
+	}
+
+	if (should_close_) {
+		LOG_DEBUG("should close cannot write file " << this);
+		return;
+	}
+
+	LOG_DEBUG("add write file " << length << " bytes " << this << " file_handle=" << file_handle << " offset=" << offset);
+
+	// The file handle is duplicated - the caller may close it once WriteFile returns.
+	auto fd = fcntl(file_handle, F_DUPFD_CLOEXEC, 0);
+	if (fd < 0) {
+		throw std::system_error(errno, std::system_category(), "fcntl - F_DUPFD_CLOEXEC - failed");
+	}
+
+	std::shared_ptr<const Handle> shared_file_handle(new Handle(fd), [](const Handle *handle) {
+		close(*handle);
+		delete handle;
+	});
+
+	// Data views lengths are limited to int - large ranges are split.
+	const std::uint64_t max_segment_length = 1 << 30;
+
+	while (length > 0) {
+		auto segment_length = std::min(length, max_segment_length);
+		pending_writes_bytes_ += segment_length;
+		write_queue_->Push(std::make_shared<FileSegment>(shared_file_handle, offset, static_cast<int>(segment_length)));
+		offset += segment_length;
+		length -= segment_length;
+	}
+
+	ScheduleWrite();
+}
+
+void StreamBuffer::ScheduleWrite() {
+	if (IsEventLoopThread() && IsConnected() && !eof_called_) {
+		// In the context of the event loop - no need for a wakeup round trip. The write is not handled inline (callbacks would
+		// re-enter the current handler) - it is flushed once the current handler returns.
+		if (handling_events_) {
+			LOG_TRACE("write while handling events - flushed once handling is done " << this);
+			written_while_handling_ = true;
+		} else {
+			DeferFlush(); // Consecutive writes are sent together at the end of the event loop iteration.
+		}
+	} else {
+		ReadyEvent(Events::Write); // Coalesced with other pending ready events.
+	}
+}
+
+void StreamBuffer::DeferFlush() {
+	if (!flush_deferred_) {
+		LOG_TRACE("deferring flush " << this);
+		flush_deferred_ = true;
+		DeferEvent();
+	}
+}
+
+void StreamBuffer::SetZeroCopy(bool zerocopy) {
+	LOG_DEBUG("set zerocopy " << this << " zerocopy=" << zerocopy);
+	stream_filters_[0]->zerocopy_ = zerocopy;
+}
+
+void StreamBuffer::SetDeferredFlush(bool deferred_flush) {
+	LOG_DEBUG("set deferred flush " << this << " deferred_flush=" << deferred_flush);
+	stream_filters_[0]->batched_ = deferred_flush;
+}
+
+void StreamBuffer::SpliceTo(std::shared_ptr<StreamBuffer> stream_buffer) {
+	if (!IsEventLoopThread() || !stream_buffer->IsEventLoopThread()) {
+		throw "splice called outside the scope of the event loop";
+	}
 
-	pending_writes_lock_.lock();
-	auto send_write_ready = pending_writes_.empty();
-	pending_writes_.push_back(saved_data_view);
-	pending_writes_lock_.unlock();
+	if (stream_buffer.get() == this || !IsConnected() || !stream_buffer->IsConnected()) {
+		throw "splice requires two connected stream buffers";
+	}
 
-	if (send_write_ready) {
-		ReadyEvent(Events::Write);
+	if (splice_ || stream_buffer->splice_) {
+		throw "stream buffer is already spliced";
 	}
+
+	// Filters above the transport must process the data - it is moved through user space.
+	auto kernel = stream_filters_.GetSize() == 1 && stream_buffer->stream_filters_.GetSize() == 1;
+
+	LOG_DEBUG("splice " << this << " to " << stream_buffer.get() << " kernel=" << kernel);
+
+	splice_ = std::make_shared<Splice>(shared_from_this(), stream_buffer, kernel);
+	stream_buffer->splice_ = splice_;
+
+	// Data that is already pending on the handles does not trigger a new event.
+	ReadyEvent(Events::Read | Events::Write);
+	stream_buffer->ReadyEvent(Events::Read | Events::Write);
+}
+
+void StreamBuffer::SetWriteWatermarks(std::uint64_t low_watermark, std::uint64_t high_watermark) {
+	if (low_watermark > high_watermark) {
+		throw "low watermark is larger than high watermark";
+	}
+
+	LOG_DEBUG("write watermarks " << this << " low_watermark=" << low_watermark << " high_watermark=" << high_watermark);
+
+	write_low_watermark_ = low_watermark;
+	write_high_watermark_ = high_watermark;
 }
 
 void StreamBuffer::Close() {
 	LOG_DEBUG("close invoked " << this);
 	should_close_ = true;
-	ReadyEvent(Events::Close);
+
+	if (IsEventLoopThread() && IsConnected() && !eof_called_) {
+		DeferFlush(); // Closed (after flushing) at the end of the event loop iteration.
+	} else {
+		ReadyEvent(Events::Close);
+	}
+}
+
+void StreamBuffer::PauseRead() {
+	LOG_DEBUG("pause read " << this);
+	read_paused_ = true;
+	ReadyEvent(Events::Read); // Read interest is removed in the context of the event loop.
+}
+
+void StreamBuffer::ResumeRead() {
+	LOG_DEBUG("resume read " << this);
+	read_paused_ = false;
+	ReadyEvent(Events::Read); // Read interest is restored and pending data is read in the context of the event loop.
 }
 
 void StreamBuffer::DoRead() {
 	LOG_TRACE("read " << this);
 
-	auto filter = stream_filters_.back();
+	if (read_paused_) {
+		LOG_TRACE("read paused " << this);
+		return;
+	}
+
+	auto filter = stream_filters_.Back();
 
 	if (filter->read_closed_) {
 		LOG_TRACE("filter read closed " << filter);
@@ -144,27 +380,47 @@ void StreamBuffer::DoRead() {
 void StreamBuffer::DoWrite() {
 	LOG_TRACE("write " << this);
 
-	auto filter = stream_filters_.back();
+	flush_deferred_ = false;
+	written_while_handling_ = false;
+
+	auto filter = stream_filters_.Back();
 
 	if (filter->write_closed_) {
 		LOG_TRACE("filter write closed " << filter);
 		return;
 	}
 
-	std::list<std::shared_ptr<const DataView>> pending_writes_swap;
-	pending_writes_lock_.lock();
-	if (!pending_writes_.empty()) {
-		pending_writes_.swap(pending_writes_swap);
+	// Only take what is already queued - producers writing concurrently cannot starve the event loop.
+	std::uint64_t pending_writes_bytes = pending_writes_bytes_;
+	std::uint64_t popped_bytes = 0;
+
+	while (popped_bytes < pending_writes_bytes) {
+		auto data_view = write_queue_->Pop();
+		if (!data_view) {
+			break; // A push is still in progress (the writer readies the event once it completes).
+		}
+
+		popped_bytes += data_view->GetDataLength();
+		filter->Write(data_view);
 	}
-	pending_writes_lock_.unlock();
 
-	if (!pending_writes_swap.empty()) {
-		filter->Write(pending_writes_swap);
+	pending_writes_bytes_ -= popped_bytes;
+
+	if (!filter->pending_out_.IsEmpty()) {
+		filter->Flush();
 	} else {
 		LOG_TRACE("write - nothing to write " << this);
 	}
 }
 
+void StreamBuffer::DoError() {
+	LOG_TRACE("error " << this);
+
+	for (auto &filter : stream_filters_) {
+		filter->Error();
+	}
+}
+
 void StreamBuffer::DoClose() {
 	LOG_TRACE("close " << this);
 
@@ -196,11 +452,11 @@ void StreamBuffer::DoClose() {
 }
 
 void StreamBuffer::DoConnect(std::shared_ptr<StreamBufferHandler> stream_buffer_handler) {
-	auto filter = stream_filters_.back();
+	auto filter = stream_filters_.Back();
 
 	ConnectResult connect_result;
 
-	if (mode_ == CLIENT_MODE) {
+	if (mode_ != SERVER_MODE) {
 		LOG_TRACE("connect " << this);
 		connect_result = filter->Connect();
 	} else {
@@ -209,36 +465,67 @@ void StreamBuffer::DoConnect(std::shared_ptr<StreamBufferHandler> stream_buffer_
 	}
 
 	if (connect_result.IsFailed()) {
-		LOG_DEBUG((mode_ == CLIENT_MODE ? "connect" : "accept") << " failed " << this);
+		LOG_DEBUG((mode_ != SERVER_MODE ? "connect" : "accept") << " failed " << this);
 		filter->read_closed_ = true;
 		filter->write_closed_ = true;
 	} else if (connect_result.IsSuccess()) {
-		LOG_DEBUG((mode_ == CLIENT_MODE ? "connect" : "accept") << " complete " << this);
+		LOG_DEBUG((mode_ != SERVER_MODE ? "connect" : "accept") << " complete " << this);
 		filter->connected_ = true;
 		add_filter_allowed_ = true;
 		stream_buffer_handler->HandleConnected(shared_from_this());
 		add_filter_allowed_ = false;
+		read_interest_paused_ = read_paused_;
 		ModifyEvent();
 	} else {
-		LOG_TRACE((mode_ == CLIENT_MODE ? "connect" : "accept") << " pending " << this);
+		LOG_TRACE((mode_ != SERVER_MODE ? "connect" : "accept") << " pending " << this);
 	}
 }
 
 void StreamBuffer::DoFinalize(std::shared_ptr<StreamBufferHandler> stream_buffer_handler) {
 	LOG_TRACE("finalize " << this);
 
-	auto filter = stream_filters_.back();
+	auto filter = stream_filters_.Back();
 
 	if (!should_close_ && filter->read_closed_) {
 		LOG_TRACE("filter is read closed " << filter);
-		should_close_ = true;
-		DoClose();
+		if (splice_ && !splice_->IsKernel()) {
+			splice_->ReadClosed(this); // Half close - the other direction is still pumped.
+		} else {
+			should_close_ = true;
+			DoClose();
+		}
+	}
+
+	std::uint64_t pending_out_bytes = 0;
+	for (auto &stream_filter : stream_filters_) {
+		pending_out_bytes += stream_filter->pending_out_bytes_;
+	}
+	pending_out_bytes_ = pending_out_bytes;
+
+	if (!eof_called_ && !should_close_) {
+		auto queued_bytes = GetQueuedBytes();
+		if (!write_backpressured_ && queued_bytes > write_high_watermark_) {
+			LOG_DEBUG("write backpressure " << this << " queued_bytes=" << queued_bytes);
+			write_backpressured_ = true;
+			stream_buffer_handler->HandleBackpressure(shared_from_this());
+		} else if (write_backpressured_ && queued_bytes <= write_low_watermark_) {
+			LOG_DEBUG("write backpressure released " << this << " queued_bytes=" << queued_bytes);
+			write_backpressured_ = false;
+			stream_buffer_handler->HandleWritable(shared_from_this());
+		}
+
+		if (splice_ && !splice_->IsKernel()) {
+			splice_->Drained(this);
+		}
 	}
 
 	if (IsReadClosed() && IsWriteClosed()) {
 		if (!eof_called_) {
 			LOG_TRACE("EOF " << this);
 			eof_called_ = true;
+			if (splice_) {
+				splice_->Closed(this);
+			}
 			stream_buffer_handler->HandleEOF(shared_from_this());
 			CloseEvent();
 		}
@@ -246,7 +533,7 @@ void StreamBuffer::DoFinalize(std::shared_ptr<StreamBufferHandler> stream_buffer
 }
 
 bool StreamBuffer::IsConnected() const {
-	return stream_filters_.back()->connected_;
+	return stream_filters_.Back()->connected_;
 }
 
 bool StreamBuffer::IsReadClosed() const {
@@ -274,8 +561,33 @@ bool StreamBuffer::IsWriteClosed() const {
 	return true;
 }
 
+bool StreamBuffer::HasPendingWrites() const {
+	if (pending_writes_bytes_ > 0) {
+		return true;
+	}
+
+	for (auto &filter : stream_filters_) {
+		if (!filter->pending_out_.IsEmpty()) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
 Events StreamBuffer::GetEvents() const {
-	return stream_filters_.back()->GetEvents();
+	auto events = stream_filters_.Back()->GetEvents();
+
+	if (mode_ == PIPE_MODE && !IsConnected()) {
+		// There is no handshake - the read end of a pipe is never writable, it is connected on its first read event.
+		events = events | Events::Read;
+	}
+
+	if (read_paused_) {
+		return events & ~Events::Read;
+	}
+
+	return events;
 }
 
 std::shared_ptr<StreamBuffer> StreamBuffer::CreateForClient(std::shared_ptr<StreamBufferHandler> stream_buffer_handler, const std::string &ip_addr, std::uint16_t port) {
@@ -300,18 +612,26 @@ StreamBufferFilter::StreamBufferFilter(std::shared_ptr<StreamBuffer> stream_buff
 		next_(nullptr),
 		stream_buffer_(stream_buffer),
 		id_(stream_buffer->GetId()),
-		order_(~1) {}
+		order_(~1),
+		pending_out_bytes_(0),
+		zerocopy_(false),
+		batched_(false),
+		write_length_(0) {}
 
-void StreamBufferFilter::Write(const std::list<std::shared_ptr<const DataView>> &write_list) {
-	LOG_TRACE("write " << this);
+void StreamBufferFilter::Write(std::shared_ptr<const DataView> data_view) {
+	LOG_TRACE("write " << this << " data_length=" << data_view->GetDataLength());
 
-	pending_out_.insert(pending_out_.end(), write_list.begin(), write_list.end());
+	pending_out_.PushBack(data_view);
+	pending_out_bytes_ += data_view->GetDataLength();
+}
 
-	while (!pending_out_.empty()) {
-		auto data_view = pending_out_.front();
-		pending_out_.pop_front();
+void StreamBufferFilter::Flush() {
+	while (!pending_out_.IsEmpty()) {
+		auto data_view = std::move(pending_out_.Front());
+		pending_out_.PopFront();
+		pending_out_bytes_ -= data_view->GetDataLength();
 
-		auto out_result = Out(data_view);
+		auto out_result = data_view->IsFileSegment() ? OutFile(data_view) : Out(data_view);
 
 		if (out_result.ShouldCloseWrite()) {
 			write_closed_ = true;
@@ -319,16 +639,61 @@ void StreamBufferFilter::Write(const std::list<std::shared_ptr<const DataView>>
 		}
 
 		if (data_view) {
-			pending_out_.push_front(data_view);
+			pending_out_.PushFront(data_view);
+			pending_out_bytes_ += data_view->GetDataLength();
 			return;
 		}
 	}
 }
 
+OutResult StreamBufferFilter::OutFile(std::shared_ptr<const DataView> &data_view) {
+	// Buffered - the file range is read and written a chunk at a time.
+	while (data_view) {
+		auto file_segment = FileSegment::From(data_view);
+
+		auto chunk = file_segment->Read(GLOBAL_CONFIG.read_buffer_size_);
+		if (!chunk) {
+			return OutResult::CreateShouldClose();
+		}
+
+		auto chunk_length = chunk->GetDataLength();
+		auto out_result = Out(chunk);
+
+		// Data that was not written is read again (from the file) on the next attempt.
+		data_view = file_segment->Advance(chunk_length - (chunk ? chunk->GetDataLength() : 0));
+
+		if (out_result.ShouldCloseWrite() || chunk) {
+			return out_result;
+		}
+	}
+
+	return OutResult();
+}
+
+bool StreamBufferFilter::HasMoreOut() const {
+	for (auto filter = this; filter != nullptr; filter = filter->next_) {
+		if (!filter->pending_out_.IsEmpty()) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool StreamBufferFilter::IsHandlingData() {
+	return handling_data_depth > 0;
+}
+
 void StreamBufferFilter::Read() {
 	LOG_TRACE("read " << this);
 
-	while (true) {
+	auto stream_buffer = stream_buffer_.lock();
+	if (!stream_buffer) {
+		LOG_WARN("stream buffer has been destroyed " << this);
+		return;
+	}
+
+	while (!stream_buffer->read_paused_) {
 		auto in_result = In();
 
 		if (in_result.ShouldCloseRead()) {
@@ -340,15 +705,14 @@ void StreamBufferFilter::Read() {
 			return;
 		}
 
-		auto data_view = in_result.GetData();
-		HandleData(data_view);
+		HandleData(in_result);
 	}
 }
 
 void StreamBufferFilter::Close() {
-	LOG_TRACE("close " << this << " write_closed=" << write_closed_ << " pending_out=" << !pending_out_.empty())
+	LOG_TRACE("close " << this << " write_closed=" << write_closed_ << " pending_out=" << !pending_out_.IsEmpty())
 
-	if (pending_out_.empty() || write_closed_) {
+	if (pending_out_.IsEmpty() || write_closed_) {
 		if (Shutdown().IsComplete()) {
 			LOG_TRACE("shutdown is complete " << this)
 			write_closed_ = true;
@@ -359,24 +723,9 @@ void StreamBufferFilter::Close() {
 
 	LOG_TRACE("flushing pending out data " << this)
 
-	while (!pending_out_.empty()) {
-		auto data_view = pending_out_.front();
-		pending_out_.pop_front();
-
-		auto out_result = Out(data_view);
-
-		if (out_result.ShouldCloseWrite()) {
-			write_closed_ = true;
-			break;
-		}
+	Flush();
 
-		if (data_view) {
-			pending_out_.push_front(data_view);
-			break;
-		}
-	}
-
-	if (pending_out_.empty() || write_closed_) {
+	if (pending_out_.IsEmpty() || write_closed_) {
 		if (Shutdown().IsComplete()) {
 			LOG_TRACE("shutdown is complete" << this)
 			write_closed_ = true;
@@ -385,7 +734,7 @@ void StreamBufferFilter::Close() {
 		return;
 	}
 
-	LOG_TRACE("cannot close more data to flush out " << this << " write_closed=" << write_closed_ << " pending_out=" << !pending_out_.empty())
+	LOG_TRACE("cannot close more data to flush out " << this << " write_closed=" << write_closed_ << " pending_out=" << !pending_out_.IsEmpty())
 }
 
 void StreamBufferFilter::HandleData(const std::shared_ptr<const DataView> &data_view) {
@@ -401,9 +750,76 @@ void StreamBufferFilter::HandleData(const std::shared_ptr<const DataView> &data_
 		return;
 	}
 
+	if (stream_buffer->splice_) {
+		stream_buffer->splice_->Forward(stream_buffer.get(), *data_view);
+		return;
+	}
+
 	stream_buffer_handler->HandleData(stream_buffer, data_view);
 }
 
+void StreamBufferFilter::HandleData(const InResult &in_result) {
+	auto stream_buffer = stream_buffer_.lock();
+	if (!stream_buffer) {
+		LOG_WARN("stream buffer has been destroyed " << this);
+		return;
+	}
+
+	auto stream_buffer_handler = stream_buffer->stream_buffer_handler_.lock();
+	if (!stream_buffer_handler) {
+		LOG_WARN("stream buffer handler has been destroyed " << this);
+		return;
+	}
+
+	HandlingDataScope handling_data_scope;
+
+	if (stream_buffer->splice_) {
+		stream_buffer->splice_->Forward(stream_buffer.get(), in_result.GetBorrowedData());
+		return;
+	}
+
+	switch (stream_buffer_handler->GetDataMode()) {
+	case StreamBufferHandler::BORROWED_DATA:
+		stream_buffer_handler->HandleBorrowedData(stream_buffer, in_result.GetBorrowedData());
+		break;
+	case StreamBufferHandler::BUFFERED_DATA:
+		stream_buffer->input_buffer_.Append(in_result.GetData());
+		stream_buffer_handler->HandleBufferedData(stream_buffer, stream_buffer->input_buffer_);
+		break;
+	default:
+		stream_buffer_handler->HandleData(stream_buffer, in_result.GetData());
+	}
+}
+
+void StreamBufferFilter::HandleHandles(std::vector<Handle> handles) {
+	auto stream_buffer = stream_buffer_.lock();
+	auto stream_buffer_handler = stream_buffer ? stream_buffer->stream_buffer_handler_.lock() : nullptr;
+
+	if (!stream_buffer_handler) {
+		LOG_WARN("stream buffer handler has been destroyed - closing received handles " << this);
+		for (auto &handle : handles) {
+			handle.Close();
+		}
+		return;
+	}
+
+	stream_buffer_handler->HandleHandles(stream_buffer, std::move(handles));
+}
+
+void StreamBufferHandler::HandleHandles(std::shared_ptr<StreamBuffer> stream_buffer, std::vector<Handle> handles) {
+	LOG_DEBUG("closing received handles (not handled) " << stream_buffer.get() << " handles=" << handles.size());
+
+	for (auto &handle : handles) {
+		handle.Close();
+	}
+}
+
+void StreamBufferHandler::HandleBufferedData(std::shared_ptr<StreamBuffer> stream_buffer, InputBuffer &input_buffer) {
+	auto data_length = input_buffer.GetDataLength();
+	HandleData(stream_buffer, input_buffer.Peek(data_length).Retain());
+	input_buffer.Consume(data_length);
+}
+
 Events StreamBufferFilter::GetEvents() const {
 	if (connected_ || order_ > 0) {
 		return Events::Read | Events::Write | Events::Stream;
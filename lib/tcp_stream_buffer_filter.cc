@@ -6,6 +6,8 @@
  */
 
 #include "tcp_stream_buffer_filter.h"
+#include "file_segment.h"
+#include "handles_data_view.h"
 #include "log.h"
 #include "async_io.h"
 #include "config.h"
@@ -22,11 +24,129 @@
 #include <unistd.h>
 #endif
 
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
+
+#ifdef HAVE_LINUX_ERRQUEUE_H
+#include <ctime>
+#include <linux/errqueue.h>
+#endif
+
+#include <fcntl.h>
+
 #include <cerrno>
 #include <cstring>
+#include <vector>
 
 namespace ael {
 
+// The unsent suffix of a zerocopy send - it references the data of the sent data view (which is kept in any case).
+class ZeroCopySuffix : public DataView {
+public:
+	ZeroCopySuffix(std::shared_ptr<const DataView> data_view, int suffix_index) : DataView(data_view->Slice(suffix_index)), data_view_(data_view) {}
+	virtual ~ZeroCopySuffix() {}
+
+private:
+	std::shared_ptr<const DataView> data_view_;
+};
+
+#if defined(HAVE_MSG_ZEROCOPY) && defined(HAVE_LINUX_ERRQUEUE_H)
+// Reads the completions from the error queue and removes the completed sends. copied is set if the kernel copied the data.
+static void ReapZeroCopySends(Handle handle, RingBuffer<ZeroCopySend> &zerocopy_sends, bool &copied) {
+	// Error events are edge triggered - read the whole error queue.
+	while (!zerocopy_sends.IsEmpty()) {
+		char control[128];
+		msghdr msg = {};
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		if (recvmsg(handle, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1) {
+			if (errno != EAGAIN) {
+				LOG_DEBUG("zerocopy error queue read failed handle=" << handle << " error=" << std::strerror(errno));
+			}
+			break;
+		}
+
+		for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			auto serr = reinterpret_cast<const sock_extended_err*>(CMSG_DATA(cmsg));
+			if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+				continue;
+			}
+
+			if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+				copied = true;
+			}
+
+			// [ee_info, ee_data] is the range of completed send ids.
+			for (auto id = serr->ee_info; id != serr->ee_data + 1; id++) {
+				auto index = static_cast<std::uint32_t>(id - zerocopy_sends.Front().id);
+				if (index < zerocopy_sends.GetSize()) {
+					zerocopy_sends[index].completed = true;
+				}
+			}
+		}
+
+		while (!zerocopy_sends.IsEmpty() && zerocopy_sends.Front().completed) {
+			zerocopy_sends.PopFront();
+		}
+	}
+}
+#endif
+
+ZeroCopyLinger::ZeroCopyLinger(Handle handle) : EventHandler(handle) {
+	LOG_TRACE("zerocopy linger created " << this);
+}
+
+ZeroCopyLinger::~ZeroCopyLinger() {
+	LOG_TRACE("zerocopy linger destroyed " << this << " pending=" << zerocopy_sends_.GetSize());
+}
+
+void ZeroCopyLinger::Create(std::shared_ptr<EventLoop> event_loop, Handle handle, RingBuffer<ZeroCopySend> &zerocopy_sends) {
+	// The stream closes its handle - the duplicate keeps the socket (and its error queue) until the sends complete.
+	auto fd = fcntl(handle, F_DUPFD_CLOEXEC, 0);
+	if (fd < 0) {
+		LOG_WARN("zerocopy linger cannot duplicate the handle - pending sends are released handle=" << handle << " error=" << std::strerror(errno));
+		return;
+	}
+	shutdown(fd, SHUT_RDWR);
+
+	auto zerocopy_linger = std::make_shared<ZeroCopyLinger>(fd);
+	while (!zerocopy_sends.IsEmpty()) {
+		zerocopy_linger->zerocopy_sends_.PushBack(std::move(zerocopy_sends.Front()));
+		zerocopy_sends.PopFront();
+	}
+
+	zerocopy_linger->event_loop_ = event_loop;
+
+	LOG_DEBUG("zerocopy linger " << zerocopy_linger.get() << " pending=" << zerocopy_linger->zerocopy_sends_.GetSize());
+
+	event_loop->AttachInternal(zerocopy_linger);
+}
+
+void ZeroCopyLinger::HandleEvents(Handle handle, Events) {
+#if defined(HAVE_MSG_ZEROCOPY) && defined(HAVE_LINUX_ERRQUEUE_H)
+	bool copied = false;
+	ReapZeroCopySends(handle, zerocopy_sends_, copied);
+#else
+	(void)handle;
+#endif
+
+	if (!zerocopy_sends_.IsEmpty()) {
+		LOG_TRACE("zerocopy linger reaped " << this << " pending=" << zerocopy_sends_.GetSize());
+		return;
+	}
+
+	LOG_DEBUG("zerocopy linger done " << this);
+
+	CloseEvent();
+
+	auto event_loop = event_loop_.lock();
+	if (event_loop) {
+		event_loop->RemoveInternal(shared_from_this());
+	}
+}
+
 std::ostream& operator<<(std::ostream &out, const TCPStreamBufferFilter *filter) {
 	const StreamBufferFilter *stream_buffer_filter = filter;
 	out << stream_buffer_filter << " handle=" << filter->handle_;
@@ -36,9 +156,22 @@ std::ostream& operator<<(std::ostream &out, const TCPStreamBufferFilter *filter)
 TCPStreamBufferFilter::TCPStreamBufferFilter(std::shared_ptr<StreamBuffer> stream_buffer, Handle handle, bool pending_connect) :
 		StreamBufferFilter(stream_buffer),
 		handle_(handle),
-		pending_connect_(pending_connect) {}
+		pending_connect_(pending_connect),
+		unix_(false),
+		zerocopy_enabled_(false),
+		zerocopy_fallback_(false),
+		zerocopy_next_id_(0) {
+	int domain;
+	socklen_t domain_len = sizeof(domain);
+	if (getsockopt(handle_, SOL_SOCKET, SO_DOMAIN, &domain, &domain_len) == 0) {
+		unix_ = domain == AF_UNIX;
+	}
+}
 
-TCPStreamBufferFilter::~TCPStreamBufferFilter() {}
+TCPStreamBufferFilter::~TCPStreamBufferFilter() {
+	// Destroyed without being closed (the stream buffer still holds the handle).
+	LingerZeroCopy();
+}
 
 std::shared_ptr<TCPStreamBufferFilter> TCPStreamBufferFilter::Create(std::shared_ptr<StreamBuffer> stream_buffer, Handle handle, bool connected) {
 	LOG_TRACE("creating a tcp stream buffer filter handle=" << handle);
@@ -46,9 +179,15 @@ std::shared_ptr<TCPStreamBufferFilter> TCPStreamBufferFilter::Create(std::shared
 }
 
 InResult TCPStreamBufferFilter::In() {
-	std::uint8_t buf[100000];
+	// Reused by every stream of the event loop thread, the data is handed over borrowed (copied only when it has to be kept).
+	// A handler still using the data it borrowed (e.g. it runs the event loop) is not overwritten - a saved copy is returned.
+	static thread_local std::vector<std::uint8_t> shared_buf;
+	std::vector<std::uint8_t> nested_buf;
+	auto borrowed = !IsHandlingData();
+	auto &buf = borrowed ? shared_buf : nested_buf;
+	buf.resize(GLOBAL_CONFIG.read_buffer_size_);
 
-	auto read_ret_ = recv(handle_, buf, sizeof(buf), MSG_DONTWAIT);
+	auto read_ret_ = unix_ ? ReceiveWithHandles(buf.data(), buf.size(), MSG_DONTWAIT) : recv(handle_, buf.data(), buf.size(), MSG_DONTWAIT);
 
 	switch (read_ret_) {
 	case 0:
@@ -72,12 +211,39 @@ InResult TCPStreamBufferFilter::In() {
 		break;
 	default:
 		LOG_DEBUG("read " << read_ret_ << " bytes " << this);
-		return InResult(buf, read_ret_);
+		return borrowed ? InResult::CreateBorrowed(DataView(buf.data(), read_ret_)) : InResult(buf.data(), read_ret_);
 	}
 }
 
 OutResult TCPStreamBufferFilter::Out(std::shared_ptr<const DataView> &data_view) {
-	auto write_ret = send(handle_, data_view->GetData(), data_view->GetDataLength(), MSG_NOSIGNAL | MSG_DONTWAIT);
+	// MSG_MORE packs the writes of a batch into full segments - the last write of the batch is sent without it.
+	auto flags = MSG_NOSIGNAL | MSG_DONTWAIT | (IsBatched() && HasMoreOut() ? MSG_MORE : 0);
+
+	auto zerocopy = ShouldZeroCopy(data_view);
+#ifdef HAVE_MSG_ZEROCOPY
+	if (zerocopy) {
+		flags |= MSG_ZEROCOPY;
+	}
+#endif
+
+	ssize_t write_ret;
+
+	auto handles_data_view = unix_ ? dynamic_cast<const HandlesDataView*>(data_view.get()) : nullptr;
+	if (handles_data_view) {
+		zerocopy = false;
+		write_ret = SendWithHandles(*handles_data_view, flags);
+	} else {
+		write_ret = send(handle_, data_view->GetData(), data_view->GetDataLength(), flags);
+	}
+
+#ifdef HAVE_MSG_ZEROCOPY
+	if (write_ret == -1 && errno == ENOBUFS && zerocopy) {
+		// Exceeded the locked pages limit (the optmem limit) - send this one with a copy.
+		LOG_DEBUG("zerocopy write no buffers - copying " << this);
+		zerocopy = false;
+		write_ret = send(handle_, data_view->GetData(), data_view->GetDataLength(), flags & ~MSG_ZEROCOPY);
+	}
+#endif
 
 	if (write_ret == -1) {
 		switch (errno) {
@@ -106,10 +272,22 @@ OutResult TCPStreamBufferFilter::Out(std::shared_ptr<const DataView> &data_view)
 		throw "write return 0 (kernel bug?)";
 	}
 
-	std::shared_ptr<const DataView> suffix_data_view;
+	if (zerocopy) {
+		// Each successful zerocopy send is identified (by the kernel) by a sequential id.
+		zerocopy_sends_.PushBack(ZeroCopySend{zerocopy_next_id_++, false, data_view});
+		if (zerocopy_event_loop_.expired()) {
+			zerocopy_event_loop_ = EventLoop::Current();
+		}
+	}
+
 	if (write_ret < data_view->GetDataLength()) {
-		data_view = data_view->Slice(write_ret).Save();
-		LOG_TRACE("partial write " <<  suffix_data_view->GetDataLength( )<< " bytes left id=" << this);
+		if (zerocopy) {
+			// No need to copy the suffix.
+			data_view = std::make_shared<ZeroCopySuffix>(data_view, write_ret);
+		} else {
+			data_view = data_view->Slice(write_ret).Save();
+		}
+		LOG_TRACE("partial write " <<  data_view->GetDataLength() << " bytes left id=" << this);
 	} else {
 		data_view = nullptr;
 	}
@@ -117,6 +295,183 @@ OutResult TCPStreamBufferFilter::Out(std::shared_ptr<const DataView> &data_view)
 	return OutResult();
 }
 
+int TCPStreamBufferFilter::ReceiveWithHandles(std::uint8_t *buf, std::size_t buf_size, int flags) {
+	alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * HandlesDataView::max_handles)];
+
+	iovec iov;
+	iov.iov_base = buf;
+	iov.iov_len = buf_size;
+
+	msghdr msg = {};
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	auto read_ret = recvmsg(handle_, &msg, flags | MSG_CMSG_CLOEXEC);
+	if (read_ret <= 0) {
+		return read_ret;
+	}
+
+	if (msg.msg_flags & MSG_CTRUNC) {
+		LOG_WARN("received handles truncated " << this);
+	}
+
+	std::vector<Handle> handles;
+
+	for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+			continue;
+		}
+
+		auto handles_count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		for (std::size_t i = 0; i < handles_count; i++) {
+			int fd;
+			std::memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(fd));
+			handles.push_back(fd);
+		}
+	}
+
+	if (!handles.empty()) {
+		LOG_DEBUG("received handles " << this << " handles=" << handles.size());
+		HandleHandles(std::move(handles));
+	}
+
+	return read_ret;
+}
+
+int TCPStreamBufferFilter::SendWithHandles(const HandlesDataView &data_view, int flags) {
+	alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * HandlesDataView::max_handles)];
+
+	auto &handles = data_view.GetHandles();
+	auto handles_size = sizeof(int) * handles.size();
+
+	iovec iov;
+	iov.iov_base = const_cast<std::uint8_t*>(data_view.GetData());
+	iov.iov_len = data_view.GetDataLength();
+
+	msghdr msg = {};
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = CMSG_SPACE(handles_size);
+
+	auto cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(handles_size);
+
+	for (std::size_t i = 0; i < handles.size(); i++) {
+		int fd = handles[i];
+		std::memcpy(CMSG_DATA(cmsg) + i * sizeof(int), &fd, sizeof(fd));
+	}
+
+	LOG_DEBUG("sending handles " << this << " handles=" << handles.size());
+
+	return sendmsg(handle_, &msg, flags);
+}
+
+OutResult TCPStreamBufferFilter::OutFile(std::shared_ptr<const DataView> &data_view) {
+#ifdef HAVE_SYS_SENDFILE_H
+	while (data_view) {
+		auto file_segment = FileSegment::From(data_view);
+		off_t offset = file_segment->GetOffset();
+
+		auto write_ret = sendfile(handle_, file_segment->GetFileHandle(), &offset, file_segment->GetDataLength());
+
+		if (write_ret == -1) {
+			switch (errno) {
+			case EAGAIN:
+				LOG_DEBUG("sendfile would block " << this);
+				return OutResult();
+			case EINVAL:
+			case ENOSYS:
+				LOG_DEBUG("sendfile not supported for the file - buffered write " << this);
+				return StreamBufferFilter::OutFile(data_view);
+			default:
+				LOG_DEBUG("sendfile failed - no longer writable " << this << " error=" << std::strerror(errno));
+				return OutResult::CreateShouldClose();
+			}
+		}
+
+		if (write_ret == 0) {
+			LOG_WARN("sendfile reached the end of the file before the end of the segment (file truncated?) " << this);
+			return OutResult::CreateShouldClose();
+		}
+
+		LOG_DEBUG("sendfile " << write_ret << " bytes " << this);
+
+		data_view = file_segment->Advance(write_ret);
+	}
+
+	return OutResult();
+#else
+	return StreamBufferFilter::OutFile(data_view);
+#endif
+}
+
+bool TCPStreamBufferFilter::ShouldZeroCopy(const std::shared_ptr<const DataView> &data_view) {
+#if defined(HAVE_MSG_ZEROCOPY) && defined(HAVE_LINUX_ERRQUEUE_H)
+	if (!IsZeroCopy() || zerocopy_fallback_ || static_cast<std::uint32_t>(data_view->GetDataLength()) < GLOBAL_CONFIG.zerocopy_threshold_) {
+		return false;
+	}
+
+	if (!zerocopy_enabled_) {
+		int enable = 1;
+		if (setsockopt(handle_, SOL_SOCKET, SO_ZEROCOPY, &enable, sizeof(enable)) != 0) {
+			LOG_DEBUG("zerocopy is not supported - falling back " << this << " error=" << std::strerror(errno));
+			zerocopy_fallback_ = true;
+			return false;
+		}
+		zerocopy_enabled_ = true;
+	}
+
+	return true;
+#else
+	(void)data_view;
+	return false;
+#endif
+}
+
+void TCPStreamBufferFilter::Error() {
+	ReapZeroCopy();
+}
+
+void TCPStreamBufferFilter::ReapZeroCopy() {
+#if defined(HAVE_MSG_ZEROCOPY) && defined(HAVE_LINUX_ERRQUEUE_H)
+	if (zerocopy_sends_.IsEmpty()) {
+		return;
+	}
+
+	bool copied = false;
+	ReapZeroCopySends(handle_, zerocopy_sends_, copied);
+
+	if (copied && !zerocopy_fallback_) {
+		// The kernel copied the data anyway (e.g. loopback) - zerocopy only adds overhead.
+		LOG_DEBUG("zerocopy data copied by the kernel - falling back " << this);
+		zerocopy_fallback_ = true;
+	}
+
+	LOG_TRACE("zerocopy reaped " << this << " pending=" << zerocopy_sends_.GetSize());
+#endif
+}
+
+void TCPStreamBufferFilter::LingerZeroCopy() {
+	ReapZeroCopy();
+
+	if (zerocopy_sends_.IsEmpty()) {
+		return;
+	}
+
+	auto event_loop = zerocopy_event_loop_.lock();
+	if (!event_loop) {
+		LOG_WARN("zerocopy sends pending but the event loop has been destroyed - released " << this << " pending=" << zerocopy_sends_.GetSize());
+		return;
+	}
+
+	ZeroCopyLinger::Create(event_loop, handle_, zerocopy_sends_);
+}
+
 ConnectResult TCPStreamBufferFilter::Accept() {
 	LOG_TRACE("accept " << this);
 
@@ -152,6 +507,8 @@ ConnectResult TCPStreamBufferFilter::Connect() {
 
 ShutdownResult TCPStreamBufferFilter::Shutdown() {
 	LOG_TRACE("shutdown " << this);
+	// The handle is closed once the stream is closed.
+	LingerZeroCopy();
 	return ShutdownResult(true);
 }
 
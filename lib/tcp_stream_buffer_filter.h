@@ -9,9 +9,35 @@
 #define LIB_LINUX_TCP_STREAM_FILTER_H_
 
 #include "stream_buffer.h"
+#include "event_loop.h"
 
 namespace ael {
 
+class HandlesDataView;
+
+struct ZeroCopySend {
+	std::uint32_t id;
+	bool completed;
+	std::shared_ptr<const DataView> data_view; // Kept until the kernel no longer references the data.
+};
+
+// Keeps the data of zerocopy sends that did not complete when the stream was closed (or destroyed) until the kernel
+// no longer references it. The socket is kept open (shut down) and the event loop owns the linger until it is done.
+class ZeroCopyLinger : public EventHandler, public std::enable_shared_from_this<ZeroCopyLinger> {
+public:
+	ZeroCopyLinger(Handle handle);
+	virtual ~ZeroCopyLinger();
+
+	static void Create(std::shared_ptr<EventLoop> event_loop, Handle handle, RingBuffer<ZeroCopySend> &zerocopy_sends);
+
+private:
+	void HandleEvents(Handle handle, Events events) override;
+	Events GetEvents() const override { return 0; } // Completions are error events.
+
+	RingBuffer<ZeroCopySend> zerocopy_sends_;
+	std::weak_ptr<EventLoop> event_loop_;
+};
+
 class TCPStreamBufferFilter: public StreamBufferFilter {
 public:
 	TCPStreamBufferFilter(std::shared_ptr<StreamBuffer> stream_buffer, Handle handle, bool pending_connect);
@@ -27,9 +53,23 @@ private:
 	ConnectResult Connect() override;
 	ConnectResult Accept() override;
 	ShutdownResult Shutdown() override;
+	void Error() override;
+	OutResult OutFile(std::shared_ptr<const DataView> &file_segment) override;
+
+	int ReceiveWithHandles(std::uint8_t *buf, std::size_t buf_size, int flags); // Received handles are handled before the data is returned.
+	int SendWithHandles(const HandlesDataView &data_view, int flags);
+	bool ShouldZeroCopy(const std::shared_ptr<const DataView> &data_view);
+	void ReapZeroCopy();
+	void LingerZeroCopy(); // Pending zerocopy sends outlive the filter.
 
 	Handle handle_;
 	bool pending_connect_;
+	bool unix_; // A Unix domain socket - handles may be passed along with the data.
+	bool zerocopy_enabled_; // SO_ZEROCOPY is set.
+	bool zerocopy_fallback_; // Zero copy is not supported (or the kernel copies) - a regular send is used.
+	std::uint32_t zerocopy_next_id_;
+	RingBuffer<ZeroCopySend> zerocopy_sends_;
+	std::weak_ptr<EventLoop> zerocopy_event_loop_; // The event loop of the zerocopy sends (a linger is attached to it).
 };
 
 } /* namespace ael */
@@ -0,0 +1,197 @@
+/*
+ * thread_placement.cc
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#include "config.h"
+#include "thread_placement.h"
+#include "log.h"
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_SCHED_H
+#include <sched.h>
+#endif
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#ifdef HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif
+
+#ifdef HAVE_SYS_SYSCALL_H
+#include <sys/syscall.h>
+#endif
+
+#ifdef HAVE_LINUX_MEMPOLICY_H
+#include <linux/mempolicy.h>
+#endif
+
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace ael {
+
+static bool ParseCpu(const std::string &value, int &cpu) {
+	if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos) {
+		return false;
+	}
+
+	errno = 0;
+	auto parsed = std::strtol(value.c_str(), nullptr, 10);
+	if (errno != 0 || parsed >= CPU_SETSIZE) {
+		return false;
+	}
+
+	cpu = static_cast<int>(parsed);
+	return true;
+}
+
+// Parses a kernel CPU list (e.g. "0-3,8-11") - an invalid list is logged and yields no CPUs.
+static std::vector<int> ParseCpuList(const std::string &cpu_list) {
+	std::vector<int> cpus;
+	std::istringstream in(cpu_list);
+	std::string range;
+
+	while (std::getline(in, range, ',')) {
+		while (!range.empty() && std::isspace(static_cast<unsigned char>(range.back()))) {
+			range.pop_back();
+		}
+		if (range.empty()) {
+			continue;
+		}
+
+		auto dash = range.find('-');
+		int first;
+		int last;
+		if (!ParseCpu(range.substr(0, dash), first) || !ParseCpu(dash == std::string::npos ? range : range.substr(dash + 1), last) ||
+				last < first) {
+			LOG_WARN("invalid cpu list cpu_list=" << cpu_list);
+			return {};
+		}
+		for (auto cpu = first; cpu <= last; cpu++) {
+			cpus.push_back(cpu);
+		}
+	}
+
+	return cpus;
+}
+
+static std::vector<int> GetNodeCpus(int numa_node) {
+	std::ifstream in("/sys/devices/system/node/node" + std::to_string(numa_node) + "/cpulist");
+	std::string cpu_list;
+
+	if (!std::getline(in, cpu_list)) {
+		LOG_WARN("failed to read the cpus of numa node " << numa_node);
+		return {};
+	}
+
+	return ParseCpuList(cpu_list);
+}
+
+static bool SetAffinity(const std::vector<int> &cpus, std::vector<int> &applied) {
+	cpu_set_t cpu_set;
+	CPU_ZERO(&cpu_set);
+	for (auto cpu : cpus) {
+		if (cpu >= 0 && cpu < CPU_SETSIZE) {
+			CPU_SET(cpu, &cpu_set);
+		}
+	}
+
+	if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) != 0) {
+		LOG_WARN("failed to set the cpu affinity of the event loop thread error=" << std::strerror(errno));
+		return false;
+	}
+
+	// The kernel drops offline CPUs.
+	if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0) {
+		for (auto cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+			if (CPU_ISSET(cpu, &cpu_set)) {
+				applied.push_back(cpu);
+			}
+		}
+	}
+
+	return true;
+}
+
+static bool SetPreferredNode(int numa_node) {
+#if defined(HAVE_LINUX_MEMPOLICY_H) && defined(SYS_set_mempolicy)
+	const auto bits = 8 * sizeof(unsigned long);
+	std::vector<unsigned long> node_mask(numa_node / bits + 1, 0);
+	node_mask[numa_node / bits] = 1ul << (numa_node % bits);
+
+	if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, node_mask.data(), node_mask.size() * bits + 1) != 0) {
+		LOG_WARN("failed to set the memory policy of the event loop thread numa_node=" << numa_node << " error=" << std::strerror(errno));
+		return false;
+	}
+
+	return true;
+#else
+	LOG_WARN("memory policy is not supported numa_node=" << numa_node);
+	return false;
+#endif
+}
+
+void ApplyThreadPlacement(const EventLoopOptions &options, EventLoopStats &placement) {
+	if (!options.name_.empty()) {
+		auto name = options.name_.substr(0, 15);
+		auto ret = pthread_setname_np(pthread_self(), name.c_str());
+		if (ret == 0) {
+			placement.name_ = name;
+		} else {
+			LOG_WARN("failed to set the name of the event loop thread error=" << std::strerror(ret));
+		}
+	}
+
+	if (options.numa_node_ >= 0 && SetPreferredNode(options.numa_node_)) {
+		placement.numa_node_ = options.numa_node_;
+	}
+
+	auto cpus = options.cpus_;
+	if (cpus.empty() && options.numa_node_ >= 0) {
+		cpus = GetNodeCpus(options.numa_node_);
+	}
+	if (!cpus.empty()) {
+		SetAffinity(cpus, placement.cpus_);
+	}
+
+	if (options.fifo_priority_ > 0) {
+		sched_param param = {};
+		param.sched_priority = options.fifo_priority_;
+		auto ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+		if (ret == 0) {
+			placement.fifo_priority_ = options.fifo_priority_;
+		} else {
+			LOG_WARN("failed to set SCHED_FIFO for the event loop thread priority=" << options.fifo_priority_ << " error=" << std::strerror(ret));
+		}
+	}
+
+	if (options.nice_ != 0) {
+		// The nice value of a thread (not of the process) - Linux specific.
+		if (setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), options.nice_) == 0) {
+			placement.nice_ = getpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)));
+		} else {
+			LOG_WARN("failed to set the nice value of the event loop thread nice=" << options.nice_ << " error=" << std::strerror(errno));
+		}
+	}
+
+	LOG_DEBUG("event loop thread placement name=" << placement.name_ << " cpus=" << placement.cpus_.size() << " numa_node=" << placement.numa_node_ <<
+			" fifo_priority=" << placement.fifo_priority_ << " nice=" << placement.nice_);
+}
+
+int GetCurrentCpu() {
+	return sched_getcpu();
+}
+
+}
@@ -0,0 +1,23 @@
+/*
+ * thread_placement.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#ifndef LIB_THREAD_PLACEMENT_H_
+#define LIB_THREAD_PLACEMENT_H_
+
+#include "event_loop.h"
+
+namespace ael {
+
+// Applies the options to the calling thread - the settings that were applied are set in placement.
+void ApplyThreadPlacement(const EventLoopOptions &options, EventLoopStats &placement);
+
+// The CPU the calling thread is running on (-1 if unknown).
+int GetCurrentCpu();
+
+}
+
+#endif /* LIB_THREAD_PLACEMENT_H_ */
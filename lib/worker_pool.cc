@@ -0,0 +1,161 @@
+/*
+ * worker_pool.cc
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#include "config.h"
+#include "worker_pool.h"
+#include "log.h"
+
+#include <algorithm>
+#include <deque>
+#include <exception>
+
+namespace ael {
+
+class Worker {
+public:
+	std::mutex lock;
+	std::deque<std::function<void()>> work;
+};
+
+// The worker pool and the index of the worker running on this thread (work it submits is queued to itself).
+static thread_local const WorkerPool *current_worker_pool = nullptr;
+static thread_local std::uint32_t current_worker_index = 0;
+
+WorkerPool::WorkerPool(std::uint32_t threads, std::uint64_t queue_limit) :
+		queue_limit_(queue_limit),
+		queued_(0),
+		active_(0),
+		completed_(0),
+		stolen_(0),
+		rejected_(0),
+		next_(0),
+		sleeping_(0),
+		stop_(false) {
+	if (threads == 0) {
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	LOG_DEBUG("worker pool is created threads=" << threads << " queue_limit=" << queue_limit);
+
+	for (std::uint32_t i = 0; i < threads; i++) {
+		workers_.push_back(std::make_unique<Worker>());
+	}
+
+	for (std::uint32_t i = 0; i < threads; i++) {
+		threads_.emplace_back(&WorkerPool::Run, this, i);
+	}
+}
+
+WorkerPool::~WorkerPool() {
+	LOG_DEBUG("worker pool is destroyed queued=" << queued_);
+
+	sleep_lock_.lock();
+	stop_ = true;
+	sleep_lock_.unlock();
+	sleep_cond_.notify_all();
+
+	for (auto &thread : threads_) {
+		thread.join();
+	}
+}
+
+std::shared_ptr<WorkerPool> WorkerPool::Create(std::uint32_t threads, std::uint64_t queue_limit) {
+	return std::shared_ptr<WorkerPool>(new WorkerPool(threads, queue_limit));
+}
+
+std::shared_ptr<WorkerPool> WorkerPool::GetDefault() {
+	static std::shared_ptr<WorkerPool> worker_pool = Create(GLOBAL_CONFIG.worker_threads_, GLOBAL_CONFIG.worker_queue_limit_);
+	return worker_pool;
+}
+
+bool WorkerPool::TrySubmit(std::function<void()> work) {
+	// The slot is reserved before the work is queued - concurrent submitters cannot exceed the limit (and taking the work
+	// cannot precede the increment).
+	auto queued = queued_.load();
+	do {
+		if (queued >= queue_limit_) {
+			rejected_++;
+			LOG_DEBUG("worker pool queue limit reached queued=" << queued);
+			return false;
+		}
+	} while (!queued_.compare_exchange_weak(queued, queued + 1));
+
+	auto index = current_worker_pool == this ? current_worker_index : next_++ % workers_.size();
+	auto &worker = workers_[index];
+
+	worker->lock.lock();
+	worker->work.push_back(std::move(work));
+	worker->lock.unlock();
+
+	if (sleeping_ > 0) {
+		// A sleeping worker checks for queued work under the sleep lock - it is either notified or sees the work.
+		sleep_lock_.lock();
+		sleep_lock_.unlock();
+		sleep_cond_.notify_one();
+	}
+
+	return true;
+}
+
+bool WorkerPool::Take(std::uint32_t index, std::function<void()> &work) {
+	// The oldest work of the own queue is taken first - the newest work of another queue is stolen.
+	auto &own = workers_[index];
+	{
+		std::lock_guard<std::mutex> guard(own->lock);
+		if (!own->work.empty()) {
+			work = std::move(own->work.front());
+			own->work.pop_front();
+			queued_--;
+			return true;
+		}
+	}
+
+	for (std::size_t i = 1; i < workers_.size(); i++) {
+		auto &victim = workers_[(index + i) % workers_.size()];
+		std::lock_guard<std::mutex> guard(victim->lock);
+		if (!victim->work.empty()) {
+			work = std::move(victim->work.back());
+			victim->work.pop_back();
+			queued_--;
+			stolen_++;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void WorkerPool::Run(std::uint32_t index) {
+	current_worker_pool = this;
+	current_worker_index = index;
+
+	std::function<void()> work;
+
+	while (!stop_) {
+		if (Take(index, work)) {
+			active_++;
+			try {
+				work();
+			} catch (const std::exception &e) {
+				LOG_WARN("worker pool work threw an exception what=" << e.what());
+			} catch (...) {
+				LOG_WARN("worker pool work threw an exception");
+			}
+			work = nullptr;
+			active_--;
+			completed_++;
+			continue;
+		}
+
+		std::unique_lock<std::mutex> guard(sleep_lock_);
+		sleeping_++;
+		sleep_cond_.wait(guard, [this] { return queued_ > 0 || stop_; });
+		sleeping_--;
+	}
+}
+
+}
@@ -0,0 +1,79 @@
+/*
+ * write_queue.cc
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#include "write_queue.h"
+
+#include <cstring>
+#include <new>
+
+namespace ael {
+
+PendingWrite::PendingWrite(const DataView &data_view, std::uint8_t *data) : data_view_(data, data_view.GetDataLength()) {
+	std::memcpy(data, data_view.GetData(), data_view.GetDataLength());
+}
+
+PendingWrite::PendingWrite(std::shared_ptr<const DataView> saved_data_view) : saved_data_view_(saved_data_view) {}
+
+void* PendingWrite::Allocate(int data_length) {
+	return ::operator new(sizeof(PendingWrite) + data_length);
+}
+
+PendingWrite* PendingWrite::Create(const DataView &data_view) {
+	if (data_view.saved_) {
+		return Create(data_view.Save());
+	}
+
+	auto memory = Allocate(data_view.GetDataLength());
+	auto data = static_cast<std::uint8_t*>(memory) + sizeof(PendingWrite);
+	return new (memory) PendingWrite(data_view, data);
+}
+
+PendingWrite* PendingWrite::Create(std::shared_ptr<const DataView> data_view) {
+	return new (Allocate(0)) PendingWrite(std::move(data_view));
+}
+
+std::shared_ptr<const DataView> PendingWrite::Release() {
+	if (saved_data_view_) {
+		auto saved_data_view = std::move(saved_data_view_);
+		Destroy();
+		return saved_data_view;
+	}
+
+	// The data is freed with the pending write once the last reference is gone.
+	return std::shared_ptr<const DataView>(&data_view_, [this](const DataView*) { Destroy(); });
+}
+
+void PendingWrite::Destroy() {
+	this->~PendingWrite();
+	::operator delete(this);
+}
+
+WriteQueue::~WriteQueue() {
+	PendingWrite *pending_write;
+	while ((pending_write = queue_.Pop()) != nullptr) {
+		pending_write->Destroy();
+	}
+}
+
+void WriteQueue::Push(const DataView &data_view) {
+	queue_.Push(PendingWrite::Create(data_view));
+}
+
+void WriteQueue::Push(std::shared_ptr<const DataView> data_view) {
+	queue_.Push(PendingWrite::Create(data_view));
+}
+
+std::shared_ptr<const DataView> WriteQueue::Pop() {
+	auto pending_write = queue_.Pop();
+	if (pending_write == nullptr) {
+		return nullptr;
+	}
+
+	return pending_write->Release();
+}
+
+}
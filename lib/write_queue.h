@@ -0,0 +1,55 @@
+/*
+ * write_queue.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#ifndef LIB_WRITE_QUEUE_H_
+#define LIB_WRITE_QUEUE_H_
+
+#include <cstdint>
+#include <memory>
+
+#include "mpsc_queue.h"
+#include "data_view.h"
+
+namespace ael {
+
+// A written data view - the queue node and the (copied) data share a single allocation.
+class PendingWrite : public MPSCNode {
+public:
+	static PendingWrite* Create(const DataView &data_view);
+	static PendingWrite* Create(std::shared_ptr<const DataView> data_view);
+
+	std::shared_ptr<const DataView> Release(); // Hands over the data (the pending write is freed once the data is released).
+	void Destroy(); // Frees a pending write that was never released.
+
+private:
+	PendingWrite(const DataView &data_view, std::uint8_t *data);
+	PendingWrite(std::shared_ptr<const DataView> saved_data_view);
+	~PendingWrite() {}
+
+	static void* Allocate(int data_length); // The pending write followed by data_length bytes.
+
+	std::shared_ptr<const DataView> saved_data_view_; // Already saved data is shared (not copied).
+	DataView data_view_;
+};
+
+// Writes may be pushed from any thread. Popped in the context of the event loop.
+class WriteQueue {
+public:
+	WriteQueue() {}
+	virtual ~WriteQueue();
+
+	void Push(const DataView &data_view);
+	void Push(std::shared_ptr<const DataView> data_view); // Queued as is (not copied).
+	std::shared_ptr<const DataView> Pop(); // nullptr if empty.
+
+private:
+	MPSCQueue<PendingWrite> queue_;
+};
+
+}
+
+#endif /* LIB_WRITE_QUEUE_H_ */
@@ -15,7 +15,7 @@ using namespace ael;
 
 static Elapsed elapsed;
 
-class PingServer : public NewConnectionHandler, public StreamBufferHandler, public enable_shared_from_this<StreamBufferHandler> {
+class PingServer : public NewConnectionHandler, public BufferedStreamBufferHandler, public enable_shared_from_this<StreamBufferHandler> {
 public:
     PingServer(shared_ptr<EventLoop> event_loop) : event_loop_(event_loop) {}
     virtual ~PingServer() {}
@@ -27,12 +27,18 @@ public:
         event_loop_->Attach(stream_buffer);
     }
 
-    void HandleData(std::shared_ptr<StreamBuffer> stream_buffer, const std::shared_ptr<const DataView> &data_view) override {
-        string data;
-        data_view->AppendToString(data);
-
-        if (data.find("ping") != string::npos) {
+    void HandleBufferedData(std::shared_ptr<StreamBuffer> stream_buffer, InputBuffer &input_buffer) override {
+        // Received data is accumulated in the input buffer (a "ping" may arrive in multiple reads).
+        auto index = input_buffer.Find(string("ping"));
+        while (index >= 0) {
+            input_buffer.Consume(index + 4);
             stream_buffer->Write(string("pong"));
+            index = input_buffer.Find(string("ping"));
+        }
+
+        // Keep what may be the beginning of the next "ping".
+        if (input_buffer.GetDataLength() > 3) {
+            input_buffer.Consume(input_buffer.GetDataLength() - 3);
         }
     }
 
@@ -0,0 +1,233 @@
+/*
+ * async_sync_test.cc
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#include "gtest/gtest.h"
+
+#include "log.h"
+#include "helpers.h"
+#include "async_sync.h"
+#include "event_loop_group.h"
+#include "worker_pool.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace ael;
+using namespace std;
+
+// Upstream requests bounded by a semaphore - each request holds a unit while its (offloaded) work runs.
+class Upstream : public WaitCount, public enable_shared_from_this<Upstream> {
+public:
+	Upstream(int count, uint64_t limit) :
+			WaitCount(1, 5000ms), semaphore_(AsyncSemaphore::Create(limit)), worker_pool_(WorkerPool::Create(8, 1000)),
+			remaining_(count), in_flight_(0), max_in_flight_(0), failed_(false) {}
+	virtual ~Upstream() {}
+
+	void Request() {
+		auto self = shared_from_this();
+		auto event_loop = EventLoop::Current();
+
+		semaphore_->Acquire([self, event_loop]() {
+			if (EventLoop::Current() != event_loop) {
+				self->failed_ = true;
+			}
+
+			auto in_flight = ++self->in_flight_;
+			auto max_in_flight = self->max_in_flight_.load();
+			while (in_flight > max_in_flight && !self->max_in_flight_.compare_exchange_weak(max_in_flight, in_flight)) {}
+
+			event_loop->Offload(self->worker_pool_, []() { this_thread::sleep_for(1ms); }, [self]() {
+				self->in_flight_--;
+				self->semaphore_->Release();
+				if (--self->remaining_ == 0) {
+					self->Dec();
+				}
+			});
+		});
+	}
+
+	int GetMaxInFlight() const { return max_in_flight_; }
+	bool IsFailed() const { return failed_; }
+	shared_ptr<AsyncSemaphore> GetSemaphore() const { return semaphore_; }
+
+private:
+	shared_ptr<AsyncSemaphore> semaphore_;
+	shared_ptr<WorkerPool> worker_pool_;
+	atomic_int remaining_;
+	atomic_int in_flight_;
+	atomic_int max_in_flight_;
+	atomic_bool failed_;
+};
+
+TEST(AsyncSemaphore, Limit) {
+	auto count = 200;
+	auto limit = 3;
+
+	auto event_loop_group = EventLoopGroup::Create(4);
+	auto upstream = make_shared<Upstream>(count, limit);
+
+	for (auto i = 0; i < count; i++) {
+		event_loop_group->GetNext()->Post([upstream]() { upstream->Request(); });
+	}
+
+	ASSERT_TRUE(upstream->Wait());
+	ASSERT_FALSE(upstream->IsFailed());
+	ASSERT_LE(upstream->GetMaxInFlight(), limit);
+	ASSERT_EQ(static_cast<uint64_t>(limit), upstream->GetSemaphore()->GetAvailable());
+	ASSERT_EQ(0u, upstream->GetSemaphore()->GetWaiters());
+
+	// Outside the scope of an event loop.
+	EXPECT_ANY_THROW(upstream->GetSemaphore()->Acquire([]() {}));
+}
+
+TEST(AsyncSemaphore, StoppedWaiter) {
+	EventLoopOptions options;
+	options.caller_thread_ = true;
+
+	auto semaphore = AsyncSemaphore::Create(1);
+	ASSERT_TRUE(semaphore->TryAcquire());
+
+	// Stopped before the unit is released - the waiter is skipped.
+	auto stopped_event_loop = EventLoop::Create(options);
+	semaphore->Acquire(stopped_event_loop, []() { FAIL(); });
+	stopped_event_loop->Stop();
+	semaphore->Release();
+	ASSERT_EQ(1u, semaphore->GetAvailable());
+	ASSERT_EQ(0u, semaphore->GetWaiters());
+
+	// Stopped with the unit posted to it - the unit is released again.
+	ASSERT_TRUE(semaphore->TryAcquire());
+	auto event_loop = EventLoop::Create(options);
+	semaphore->Acquire(event_loop, []() { FAIL(); });
+	semaphore->Release();
+	ASSERT_EQ(0u, semaphore->GetAvailable());
+	event_loop->Stop();
+	ASSERT_FALSE(event_loop->RunOnce(0ms));
+	ASSERT_EQ(1u, semaphore->GetAvailable());
+}
+
+TEST(AsyncSemaphore, StoppedAcquire) {
+	EventLoopOptions options;
+	options.caller_thread_ = true;
+
+	auto semaphore = AsyncSemaphore::Create(1);
+
+	// Acquired outside the context of the event loop - the callback is posted.
+	auto event_loop = EventLoop::Create(options);
+	semaphore->Acquire(event_loop, []() { FAIL(); });
+	ASSERT_EQ(0u, semaphore->GetAvailable());
+	event_loop->Stop();
+	ASSERT_FALSE(event_loop->RunOnce(0ms));
+	ASSERT_EQ(1u, semaphore->GetAvailable());
+
+	// Already stopped.
+	thread other([semaphore, event_loop]() { semaphore->Acquire(event_loop, []() { FAIL(); }); });
+	other.join();
+	ASSERT_EQ(1u, semaphore->GetAvailable());
+	ASSERT_EQ(0u, semaphore->GetWaiters());
+
+	auto mutex = AsyncMutex::Create();
+	mutex->Lock(event_loop, []() { FAIL(); });
+	ASSERT_FALSE(mutex->IsLocked());
+}
+
+TEST(AsyncMutex, CriticalSection) {
+	auto count = 500;
+
+	auto event_loop_group = EventLoopGroup::Create(4);
+	auto mutex = AsyncMutex::Create();
+	auto done = make_shared<WaitCount>(count, 5000ms);
+	auto counter = make_shared<int>(0);
+	auto failed = make_shared<atomic_bool>(false);
+
+	for (auto i = 0; i < count; i++) {
+		auto event_loop = event_loop_group->GetNext();
+		event_loop->Post([event_loop_group, mutex, done, counter, failed]() {
+			mutex->Lock([event_loop_group, mutex, done, counter, failed]() {
+				// The critical section spans an event loop hop.
+				auto value = *counter;
+				event_loop_group->GetNext()->Post([mutex, done, counter, failed, value]() {
+					if (*counter != value) {
+						*failed = true;
+					}
+					*counter = value + 1;
+					mutex->Unlock();
+					done->Dec();
+				});
+			});
+		});
+	}
+
+	ASSERT_TRUE(done->Wait());
+	ASSERT_FALSE(*failed);
+	ASSERT_FALSE(mutex->IsLocked());
+	ASSERT_TRUE(mutex->TryLock());
+	ASSERT_FALSE(mutex->TryLock());
+	mutex->Unlock();
+}
+
+TEST(AsyncLatch, Basic) {
+	auto event_loop_group = EventLoopGroup::Create(3);
+	auto latch = AsyncLatch::Create(3);
+	auto done = make_shared<WaitCount>(4, 5000ms);
+	auto failed = make_shared<atomic_bool>(false);
+
+	for (uint32_t i = 0; i < event_loop_group->GetSize(); i++) {
+		auto event_loop = event_loop_group->Get(i);
+		latch->Wait(event_loop, [event_loop, done, failed]() {
+			if (EventLoop::Current() != event_loop) {
+				*failed = true;
+			}
+			done->Dec();
+		});
+	}
+
+	latch->CountDown();
+	latch->CountDown(2);
+	ASSERT_EQ(0u, latch->GetCount());
+
+	// Already reached zero.
+	auto event_loop = event_loop_group->Get(0);
+	latch->Wait(event_loop, [done]() { done->Dec(); });
+
+	ASSERT_TRUE(done->Wait());
+	ASSERT_FALSE(*failed);
+}
+
+TEST(AsyncEvent, Basic) {
+	auto event_loop_group = EventLoopGroup::Create(2);
+	auto event = AsyncEvent::Create();
+	auto done = make_shared<WaitCount>(2, 5000ms);
+	auto resumed = make_shared<atomic_int>(0);
+
+	for (uint32_t i = 0; i < event_loop_group->GetSize(); i++) {
+		event->Wait(event_loop_group->Get(i), [done, resumed]() {
+			(*resumed)++;
+			done->Dec();
+		});
+	}
+
+	this_thread::sleep_for(10ms);
+	ASSERT_EQ(0, *resumed);
+
+	event->Set();
+	ASSERT_TRUE(done->Wait());
+	ASSERT_TRUE(event->IsSet());
+
+	event->Reset();
+	ASSERT_FALSE(event->IsSet());
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+
+    ::testing::AddGlobalTestEnvironment(new Environment);
+
+    return RUN_ALL_TESTS();
+}
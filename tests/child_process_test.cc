@@ -0,0 +1,215 @@
+/*
+ * child_process_test.cc
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#include "gtest/gtest.h"
+
+#include "config.h"
+#include "log.h"
+#include "helpers.h"
+#include "child_process.h"
+#include "stream_buffer.h"
+#include "event_loop.h"
+
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace ael;
+using namespace std;
+
+class ExitCount : public WaitCount {
+public:
+	ExitCount(int count) : WaitCount(1, 5000ms), count_(count), exit_code_(-1), signal_(0) {}
+	virtual ~ExitCount() {}
+
+	void Handle(const ChildExit &child_exit) {
+		if (child_exit.IsExited()) {
+			exit_code_ = child_exit.GetExitCode();
+		} else if (child_exit.IsSignaled()) {
+			signal_ = child_exit.GetSignal();
+		}
+
+		if (--count_ == 0) {
+			Dec();
+		}
+	}
+
+	int GetExitCode() const { return exit_code_; }
+	int GetSignal() const { return signal_; }
+
+private:
+	atomic_int count_;
+	atomic_int exit_code_;
+	atomic_int signal_;
+};
+
+class OutputHandler : public StreamBufferHandler, public WaitCount {
+public:
+	OutputHandler() : WaitCount(1, 5000ms) {}
+	virtual ~OutputHandler() {}
+
+	void HandleData(std::shared_ptr<StreamBuffer>, const std::shared_ptr<const DataView> &data_view) override {
+		lock_guard<mutex> guard(lock_);
+		data_view->AppendToString(received_);
+	}
+
+	void HandleConnected(std::shared_ptr<StreamBuffer>) override {}
+
+	void HandleEOF(std::shared_ptr<StreamBuffer>) override {
+		Dec();
+	}
+
+	string GetReceived() {
+		lock_guard<mutex> guard(lock_);
+		return received_;
+	}
+
+private:
+	mutex lock_;
+	string received_;
+};
+
+static ChildExitCallback ExitCallback(shared_ptr<ExitCount> exit_count) {
+	return [exit_count](const ChildExit &child_exit) { exit_count->Handle(child_exit); };
+}
+
+TEST(ChildProcess, ExitCode) {
+	auto event_loop = EventLoop::Create();
+	auto exit_count = make_shared<ExitCount>(1);
+
+	auto child_process = ChildProcess::Spawn({ "sh", "-c", "exit 3" }, ChildProcessOptions(), ExitCallback(exit_count));
+	ASSERT_GT(child_process->GetPid(), 0u);
+	event_loop->Attach(child_process);
+
+	ASSERT_TRUE(exit_count->Wait());
+	ASSERT_EQ(3, exit_count->GetExitCode());
+	ASSERT_TRUE(child_process->IsExited());
+
+	EXPECT_ANY_THROW(ChildProcess::Spawn({ "ael_no_such_program" }, ChildProcessOptions(), ExitCallback(exit_count)));
+}
+
+TEST(ChildProcess, Stdio) {
+	auto event_loop = EventLoop::Create();
+	auto exit_count = make_shared<ExitCount>(1);
+
+	ChildProcessOptions options;
+	options.pipe_stdin_ = true;
+	options.pipe_stdout_ = true;
+	options.env_ = { "AEL_TEST=env" };
+
+	auto child_process = ChildProcess::Spawn({ "sh", "-c", "echo $AEL_TEST; cat" }, options, ExitCallback(exit_count));
+	event_loop->Attach(child_process);
+	ASSERT_FALSE(child_process->TakeStderr());
+
+	auto stdin_handler = make_shared<OutputHandler>();
+	auto stdin_stream = StreamBuffer::CreateForPipe(stdin_handler, child_process->TakeStdin());
+	event_loop->Attach(stdin_stream);
+
+	auto stdout_handler = make_shared<OutputHandler>();
+	auto stdout_stream = StreamBuffer::CreateForPipe(stdout_handler, child_process->TakeStdout());
+	event_loop->Attach(stdout_stream);
+
+	stdin_stream->Write(DataView(string("hello child")));
+	stdin_stream->Close();
+	ASSERT_TRUE(stdin_handler->Wait());
+	stdin_stream = nullptr; // The child reads EOF.
+
+	ASSERT_TRUE(stdout_handler->Wait());
+	ASSERT_EQ("env\nhello child", stdout_handler->GetReceived());
+
+	ASSERT_TRUE(exit_count->Wait());
+	ASSERT_EQ(0, exit_count->GetExitCode());
+}
+
+TEST(ChildProcess, Kill) {
+	auto event_loop = EventLoop::Create();
+	auto exit_count = make_shared<ExitCount>(1);
+
+	auto child_process = ChildProcess::Spawn({ "sleep", "10" }, ChildProcessOptions(), ExitCallback(exit_count));
+	event_loop->Attach(child_process);
+
+	child_process->Kill(SIGTERM);
+
+	ASSERT_TRUE(exit_count->Wait());
+	ASSERT_EQ(SIGTERM, exit_count->GetSignal());
+
+	child_process->Kill(SIGTERM); // Ignored.
+}
+
+TEST(ChildProcess, DestroyedBeforeExit) {
+	auto event_loop = EventLoop::Create();
+	auto exit_count = make_shared<ExitCount>(1);
+
+	auto child_process = ChildProcess::Spawn({ "sleep", "0.1" }, ChildProcessOptions(), ExitCallback(exit_count));
+	auto pid = static_cast<id_t>(child_process->GetPid());
+	event_loop->Attach(child_process);
+	child_process.reset();
+
+	// Reaped by the event loop once it exits - no longer a child of this process.
+	siginfo_t info;
+	auto ret = 0;
+	for (auto i = 0; i < 500 && ret == 0; i++) {
+		this_thread::sleep_for(10ms);
+		ret = waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT); // Not reaped by the test.
+	}
+	ASSERT_EQ(-1, ret);
+	ASSERT_EQ(ECHILD, errno);
+	ASSERT_EQ(-1, exit_count->GetExitCode());
+}
+
+TEST(ChildProcess, Many) {
+	auto count = 200;
+
+	auto event_loop = EventLoop::Create();
+	auto exit_count = make_shared<ExitCount>(count);
+
+	vector<shared_ptr<ChildProcess>> child_processes;
+	for (auto i = 0; i < count; i++) {
+		auto child_process = ChildProcess::Spawn({ "true" }, ChildProcessOptions(), ExitCallback(exit_count));
+		event_loop->Attach(child_process);
+		child_processes.push_back(child_process);
+	}
+
+	ASSERT_TRUE(exit_count->Wait());
+	for (auto &child_process : child_processes) {
+		ASSERT_TRUE(child_process->IsExited());
+	}
+}
+
+#ifdef HAVE_POSIX_SPAWN_CLOSEFROM
+TEST(ChildProcess, NotInherited) {
+	auto event_loop = EventLoop::Create();
+	auto exit_count = make_shared<ExitCount>(1);
+
+	// Not close-on-exec.
+	int fds[2];
+	ASSERT_EQ(0, pipe(fds));
+	auto fd = to_string(fds[1]);
+
+	auto child_process = ChildProcess::Spawn({ "sh", "-c", "test ! -e /proc/self/fd/" + fd }, ChildProcessOptions(), ExitCallback(exit_count));
+	event_loop->Attach(child_process);
+
+	ASSERT_TRUE(exit_count->Wait());
+	ASSERT_EQ(0, exit_count->GetExitCode());
+
+	close(fds[0]);
+	close(fds[1]);
+}
+#endif
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+
+    ::testing::AddGlobalTestEnvironment(new Environment);
+
+    return RUN_ALL_TESTS();
+}
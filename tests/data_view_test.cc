@@ -63,6 +63,21 @@ TEST(DataView, Slice) {
 
 }
 
+TEST(DataView, Retain) {
+	auto msg = "hello";
+	auto msg_len = strlen(msg);
+
+	auto view = DataView(reinterpret_cast<const uint8_t*>(msg), msg_len);
+
+	auto retained_view = view.Retain();
+	ASSERT_EQ(view.GetDataLength(), retained_view->GetDataLength());
+	ASSERT_NE(view.GetData(), retained_view->GetData());
+	ASSERT_EQ(0, memcmp(view.GetData(), retained_view->GetData(), view.GetDataLength()));
+
+	auto retained_retained_view = retained_view->Retain();
+	ASSERT_EQ(retained_view.get(), retained_retained_view.get());
+}
+
 TEST(DataView, Append) {
 	string str;
 	auto to_append = "1";
@@ -5,14 +5,23 @@
  *      Author: tomer
  */
 
+#include <atomic>
 #include <condition_variable>
 #include <chrono>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <pthread.h>
+#include <sched.h>
 
 #include "gtest/gtest.h"
 
 #include "log.h"
 #include "helpers.h"
 #include "event_loop.h"
+#include "worker_pool.h"
 
 using namespace std;
 using namespace ael;
@@ -52,6 +61,54 @@ private:
 	condition_variable cond_;
 };
 
+class ExecuteChain : public enable_shared_from_this<ExecuteChain> {
+public:
+	ExecuteChain(EventLoop *event_loop, int count) : event_loop_(event_loop), count_(count), latch_(1) {}
+
+	void Next() {
+		// Called in the context of the event loop.
+		if (--count_ == 0) {
+			latch_.Dec();
+			return;
+		}
+
+		event_loop_->ExecuteOnce(&ExecuteChain::Next, shared_from_this());
+	}
+
+	template< class Rep, class Period>
+	bool Wait(const chrono::duration<Rep, Period> &wait_time) {
+		return latch_.Wait(wait_time);
+	}
+
+private:
+	EventLoop *event_loop_;
+	int count_;
+	CountDownLatch latch_;
+};
+
+// Records the events it handles (the eventfd is never written - the handler runs only when readied).
+class ReadyHandler : public EventHandler {
+public:
+	ReadyHandler() : EventHandler(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), handled_(0) {}
+	virtual ~ReadyHandler() {}
+
+	void HandleEvents(Handle, Events events) override {
+		handled_++;
+		events_ = events;
+	}
+
+	Events GetEvents() const override { return Events::Read; }
+
+	void Ready(Events events) { ReadyEvent(events); }
+
+	int GetHandled() const { return handled_; }
+	Events GetHandledEvents() const { return events_; }
+
+private:
+	int handled_;
+	Events events_;
+};
+
 TEST(Execute, Basic) {
 	int count = 5;
 
@@ -86,6 +143,15 @@ TEST(Execute, Advanced) {
 	ASSERT_TRUE(latch->Wait(10000ms));
 }
 
+TEST(Execute, InContext) {
+	auto event_loop = EventLoop::Create();
+	auto execute_chain = make_shared<ExecuteChain>(event_loop.get(), 1000);
+
+	event_loop->ExecuteOnce(&ExecuteChain::Next, execute_chain);
+
+	ASSERT_TRUE(execute_chain->Wait(5000ms));
+}
+
 TEST(ExecuteIn, Basic) {
 	auto event_loop = EventLoop::Create();
 	auto latch = make_shared<CountDownLatch>(2);
@@ -127,6 +193,340 @@ TEST(ExecuteIntervalIn, Basic) {
 	timer->Cancel();
 }
 
+TEST(Post, Order) {
+	int count = 1000;
+
+	auto event_loop = EventLoop::Create();
+	auto latch = make_shared<CountDownLatch>(1);
+	auto order = make_shared<vector<int>>();
+
+	for (auto i = 0; i < count; i++) {
+		event_loop->Post([order, latch, i, count]() {
+			order->push_back(i);
+			if (i == count - 1) {
+				latch->Dec();
+			}
+		});
+	}
+
+	ASSERT_TRUE(latch->Wait(5000ms));
+	ASSERT_EQ(static_cast<size_t>(count), order->size());
+	for (auto i = 0; i < count; i++) {
+		ASSERT_EQ(i, (*order)[i]);
+	}
+}
+
+TEST(Offload, Basic) {
+	int count = 100;
+
+	auto event_loop = EventLoop::Create();
+	auto worker_pool = WorkerPool::Create(4, 1000);
+	auto latch = make_shared<CountDownLatch>(count);
+	auto loop_thread_id = make_shared<thread::id>();
+	auto failed = make_shared<atomic_bool>(false);
+
+	auto loop_latch = make_shared<CountDownLatch>(1);
+	event_loop->Post([loop_thread_id, loop_latch]() {
+		*loop_thread_id = this_thread::get_id();
+		loop_latch->Dec();
+	});
+	ASSERT_TRUE(loop_latch->Wait(5000ms));
+
+	for (auto i = 0; i < count; i++) {
+		auto done = make_shared<atomic_bool>(false);
+		auto offloaded = event_loop->Offload(worker_pool, [done, loop_thread_id, failed]() {
+			if (this_thread::get_id() == *loop_thread_id) {
+				*failed = true;
+			}
+			*done = true;
+		}, [done, loop_thread_id, failed, latch]() {
+			if (!*done || this_thread::get_id() != *loop_thread_id) {
+				*failed = true;
+			}
+			latch->Dec();
+		});
+		ASSERT_TRUE(offloaded);
+	}
+
+	ASSERT_TRUE(latch->Wait(5000ms));
+	ASSERT_FALSE(*failed);
+	// A worker counts the completion after the continuation is posted.
+	for (auto i = 0; i < 100 && worker_pool->GetCompleted() < static_cast<uint64_t>(count); i++) {
+		this_thread::sleep_for(10ms);
+	}
+	ASSERT_EQ(static_cast<uint64_t>(count), worker_pool->GetCompleted());
+	ASSERT_EQ(0u, worker_pool->GetQueued());
+}
+
+TEST(WorkerPool, QueueLimit) {
+	auto worker_pool = WorkerPool::Create(1, 2);
+	ASSERT_EQ(1u, worker_pool->GetThreads());
+	ASSERT_EQ(2u, worker_pool->GetQueueLimit());
+
+	mutex block;
+	block.lock();
+	ASSERT_TRUE(worker_pool->TrySubmit([&block]() { lock_guard<mutex> guard(block); }));
+
+	for (auto i = 0; i < 100 && worker_pool->GetActive() == 0; i++) {
+		this_thread::sleep_for(10ms);
+	}
+	ASSERT_EQ(1u, worker_pool->GetActive());
+
+	auto latch = make_shared<CountDownLatch>(1);
+	ASSERT_TRUE(worker_pool->TrySubmit([]() { throw "ignored"; }));
+	ASSERT_TRUE(worker_pool->TrySubmit([latch]() { latch->Dec(); }));
+	ASSERT_FALSE(worker_pool->TrySubmit([latch]() { latch->Dec(); }));
+	ASSERT_EQ(2u, worker_pool->GetQueued());
+	ASSERT_EQ(1u, worker_pool->GetRejected());
+
+	block.unlock();
+
+	ASSERT_TRUE(latch->Wait(5000ms));
+	for (auto i = 0; i < 100 && worker_pool->GetCompleted() < 3; i++) {
+		this_thread::sleep_for(10ms);
+	}
+	ASSERT_EQ(3u, worker_pool->GetCompleted());
+	ASSERT_EQ(0u, worker_pool->GetQueued());
+}
+
+TEST(WorkerPool, QueueLimitConcurrent) {
+	auto queue_limit = 16;
+	auto submitters = 8;
+
+	auto worker_pool = WorkerPool::Create(1, queue_limit);
+
+	mutex block;
+	block.lock();
+	ASSERT_TRUE(worker_pool->TrySubmit([&block]() { lock_guard<mutex> guard(block); }));
+	for (auto i = 0; i < 100 && worker_pool->GetActive() == 0; i++) {
+		this_thread::sleep_for(10ms);
+	}
+	ASSERT_EQ(1u, worker_pool->GetActive());
+
+	atomic_int accepted(0);
+	vector<thread> threads;
+	for (auto t = 0; t < submitters; t++) {
+		threads.emplace_back([worker_pool, &accepted, queue_limit]() {
+			for (auto i = 0; i < queue_limit; i++) {
+				if (worker_pool->TrySubmit([]() {})) {
+					accepted++;
+				}
+			}
+		});
+	}
+	for (auto &thread : threads) {
+		thread.join();
+	}
+
+	ASSERT_EQ(queue_limit, accepted);
+	ASSERT_EQ(static_cast<uint64_t>(queue_limit), worker_pool->GetQueued());
+	ASSERT_EQ(static_cast<uint64_t>((submitters - 1) * queue_limit), worker_pool->GetRejected());
+
+	block.unlock();
+}
+
+TEST(EventLoop, Options) {
+	// Pin to a CPU this process is allowed to run on.
+	cpu_set_t cpu_set;
+	CPU_ZERO(&cpu_set);
+	ASSERT_EQ(0, sched_getaffinity(0, sizeof(cpu_set), &cpu_set));
+	auto cpu = 0;
+	while (cpu < CPU_SETSIZE && !CPU_ISSET(cpu, &cpu_set)) {
+		cpu++;
+	}
+	ASSERT_LT(cpu, CPU_SETSIZE);
+
+	EventLoopOptions options;
+	options.name_ = "ael-test-loop-name";
+	options.cpus_ = { cpu };
+	options.nice_ = 5;
+
+	auto event_loop = EventLoop::Create(options);
+	auto latch = make_shared<CountDownLatch>(1);
+	auto name = make_shared<string>();
+
+	event_loop->Post([latch, name]() {
+		char buf[16];
+		pthread_getname_np(pthread_self(), buf, sizeof(buf));
+		*name = buf;
+		latch->Dec();
+	});
+	ASSERT_TRUE(latch->Wait(5000ms));
+
+	// The stats of the iteration are updated once it completes.
+	auto stats = event_loop->GetStats();
+	for (auto i = 0; i < 500 && stats.iterations_ == 0; i++) {
+		this_thread::sleep_for(1ms);
+		stats = event_loop->GetStats();
+	}
+	ASSERT_EQ("ael-test-loop-n", *name);
+	ASSERT_EQ("ael-test-loop-n", stats.name_);
+	ASSERT_EQ(vector<int>{ cpu }, stats.cpus_);
+	ASSERT_EQ(5, stats.nice_);
+	ASSERT_EQ(-1, stats.numa_node_);
+	ASSERT_EQ(cpu, stats.cpu_);
+	ASSERT_GT(stats.iterations_, 0u);
+}
+
+TEST(EventLoop, CallerThread) {
+	EventLoopOptions options;
+	options.caller_thread_ = true;
+
+	auto event_loop = EventLoop::Create(options);
+	auto latch = make_shared<CountDownLatch>(2);
+	auto loop_thread_id = make_shared<thread::id>();
+
+	event_loop->ExecuteOnce(&CountDownLatch::Dec, latch);
+	event_loop->Post([event_loop, latch, loop_thread_id]() {
+		*loop_thread_id = this_thread::get_id();
+		latch->Dec();
+		event_loop->Stop();
+	});
+
+	event_loop->Run();
+
+	ASSERT_EQ(0, latch->GetCount());
+	ASSERT_EQ(this_thread::get_id(), *loop_thread_id);
+	ASSERT_FALSE(event_loop->RunOnce(0ms));
+}
+
+TEST(EventLoop, ReadyCoalesced) {
+	EventLoopOptions options;
+	options.caller_thread_ = true;
+
+	auto event_loop = EventLoop::Create(options);
+	auto ready_handler = make_shared<ReadyHandler>();
+	event_loop->Attach(ready_handler);
+	ASSERT_TRUE(event_loop->RunOnce(0ms));
+	ASSERT_EQ(0, ready_handler->GetHandled());
+
+	// Readied several times before an iteration - handled once with all the events.
+	ready_handler->Ready(Events::Read);
+	ready_handler->Ready(Events(0));
+	ready_handler->Ready(Events::Write);
+	ready_handler->Ready(Events::Read | Events::Close);
+	ASSERT_TRUE(event_loop->RunOnce(0ms));
+	ASSERT_EQ(1, ready_handler->GetHandled());
+	ASSERT_EQ(Events::Read | Events::Write | Events::Close, static_cast<uint32_t>(ready_handler->GetHandledEvents()));
+
+	// No events - nothing is dispatched.
+	ready_handler->Ready(Events(0));
+	ASSERT_TRUE(event_loop->RunOnce(0ms));
+	ASSERT_EQ(1, ready_handler->GetHandled());
+
+	event_loop->Stop();
+}
+
+TEST(EventLoop, PollFd) {
+	EventLoopOptions options;
+	options.caller_thread_ = true;
+
+	auto event_loop = EventLoop::Create(options);
+	auto latch = make_shared<CountDownLatch>(1);
+
+	pollfd poll_fd = { event_loop->GetPollFd(), POLLIN, 0 };
+
+	// Nothing to handle.
+	ASSERT_TRUE(event_loop->RunOnce(0ms));
+	ASSERT_EQ(0, poll(&poll_fd, 1, 10));
+
+	thread poster([event_loop, latch]() { event_loop->Post([latch]() { latch->Dec(); }); });
+	poster.join();
+
+	ASSERT_EQ(1, poll(&poll_fd, 1, 1000));
+	ASSERT_TRUE(event_loop->RunOnce(0ms));
+	ASSERT_EQ(0, latch->GetCount());
+
+	// Attached in the context of the event loop (without a wakeup) - the poll fd is readable until the timer is registered.
+	auto timer_latch = make_shared<CountDownLatch>(1);
+	event_loop->ExecuteOnceIn(20ms, &CountDownLatch::Dec, timer_latch);
+	for (auto i = 0; i < 10 && timer_latch->GetCount() > 0; i++) {
+		ASSERT_EQ(1, poll(&poll_fd, 1, 1000));
+		ASSERT_TRUE(event_loop->RunOnce(0ms));
+	}
+	ASSERT_EQ(0, timer_latch->GetCount());
+
+	thread other([event_loop]() { EXPECT_ANY_THROW(event_loop->RunOnce(0ms)); });
+	other.join();
+
+	event_loop->Stop();
+	ASSERT_FALSE(event_loop->RunOnce(0ms));
+}
+
+TEST(EventLoop, SingleThread) {
+	EventLoopOptions options;
+	options.single_thread_ = true;
+
+	auto event_loop = EventLoop::Create(options);
+	auto latch = make_shared<CountDownLatch>(3);
+	auto execute_chain = make_shared<ExecuteChain>(event_loop.get(), 100);
+
+	// Attached and posted before the event loop runs.
+	event_loop->ExecuteOnce(&ExecuteChain::Next, execute_chain);
+	event_loop->ExecuteOnceIn(10ms, &CountDownLatch::Dec, latch);
+	event_loop->Post([event_loop, latch]() {
+		latch->Dec();
+		event_loop->Post([latch]() { latch->Dec(); });
+	});
+
+	for (auto i = 0; i < 1000 && (latch->GetCount() > 0 || !execute_chain->Wait(0ms)); i++) {
+		ASSERT_TRUE(event_loop->RunOnce(100ms));
+	}
+	ASSERT_EQ(0, latch->GetCount());
+	ASSERT_TRUE(execute_chain->Wait(0ms));
+
+	thread other([event_loop, latch]() {
+		EXPECT_ANY_THROW(event_loop->Post([latch]() { latch->Dec(); }));
+		EXPECT_ANY_THROW(event_loop->RunOnce(0ms));
+	});
+	other.join();
+	EXPECT_ANY_THROW(event_loop->Offload([]() {}, []() {}));
+
+	event_loop->Stop();
+	ASSERT_FALSE(event_loop->RunOnce(0ms));
+}
+
+TEST(EventLoop, CurrentAndDispatch) {
+	ASSERT_EQ(nullptr, EventLoop::Current());
+
+	auto event_loop = EventLoop::Create();
+	auto latch = make_shared<CountDownLatch>(1);
+	auto failed = make_shared<atomic_bool>(false);
+
+	EventLoopOptions options;
+	options.caller_thread_ = true;
+	auto nested_event_loop = EventLoop::Create(options);
+
+	// Dispatched from another thread - posted.
+	event_loop->Dispatch([event_loop, nested_event_loop, latch, failed]() {
+		if (EventLoop::Current() != event_loop) {
+			*failed = true;
+		}
+
+		auto inline_run = false;
+		event_loop->Dispatch([&inline_run]() { inline_run = true; });
+		if (!inline_run) {
+			*failed = true;
+		}
+
+		// Runs in the context of the nested event loop and then back in the context of this event loop.
+		nested_event_loop->Post([nested_event_loop, failed]() {
+			if (EventLoop::Current() != nested_event_loop) {
+				*failed = true;
+			}
+		});
+		nested_event_loop->RunOnce(0ms);
+		if (EventLoop::Current() != event_loop) {
+			*failed = true;
+		}
+
+		latch->Dec();
+	});
+
+	ASSERT_TRUE(latch->Wait(5000ms));
+	ASSERT_FALSE(*failed);
+	ASSERT_EQ(nullptr, EventLoop::Current());
+}
 
 int main(int argc, char **argv)
 {
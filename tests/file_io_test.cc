@@ -0,0 +1,214 @@
+/*
+ * file_io_test.cc
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#include "gtest/gtest.h"
+
+#include "log.h"
+#include "helpers.h"
+#include "config.h"
+#include "file_io.h"
+#include "event_loop.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+
+using namespace ael;
+using namespace std;
+
+class Journal : public WaitCount, public enable_shared_from_this<Journal> {
+public:
+	Journal(shared_ptr<FileIO> file_io, Handle file_handle, int count, int chunk_size) :
+			WaitCount(1, 2000ms), file_io_(file_io), file_handle_(file_handle), count_(count), chunk_size_(chunk_size),
+			written_(0), read_(0), max_in_flight_(0), failed_(false), synced_(false) {}
+	virtual ~Journal() {}
+
+	void Start() {
+		for (auto i = 0; i < count_; i++) {
+			auto self = shared_from_this();
+			file_io_->WriteFile(file_handle_, static_cast<uint64_t>(i) * chunk_size_, DataView(GetChunk(i)), [self](const FileResult &result) {
+				self->Track();
+				if (result.IsError() || result.GetBytes() != static_cast<uint64_t>(self->chunk_size_)) {
+					self->Fail();
+					return;
+				}
+				if (++self->written_ == self->count_) {
+					self->Sync();
+				}
+			});
+		}
+	}
+
+	string GetChunk(int i) const {
+		string chunk(chunk_size_, 'a' + i % 26);
+		chunk.replace(0, to_string(i).length(), to_string(i));
+		return chunk;
+	}
+
+	bool IsFailed() const { return failed_; }
+	bool IsSynced() const { return synced_; }
+	uint32_t GetMaxInFlight() const { return max_in_flight_; }
+
+private:
+	void Sync() {
+		auto self = shared_from_this();
+		file_io_->Fsync(file_handle_, true, [self](const FileResult &result) {
+			if (result.IsError()) {
+				self->Fail();
+				return;
+			}
+			self->synced_ = true;
+			self->ReadBack();
+		});
+	}
+
+	void ReadBack() {
+		for (auto i = 0; i < count_; i++) {
+			auto self = shared_from_this();
+			file_io_->ReadFile(file_handle_, static_cast<uint64_t>(i) * chunk_size_, chunk_size_, [self, i](const FileResult &result) {
+				self->Track();
+				string data;
+				if (!result.IsError()) {
+					result.GetData()->AppendToString(data);
+				}
+				if (data != self->GetChunk(i)) {
+					self->Fail();
+					return;
+				}
+				if (++self->read_ == self->count_) {
+					self->Dec();
+				}
+			});
+		}
+	}
+
+	void Track() {
+		if (file_io_->GetInFlight() > max_in_flight_) {
+			max_in_flight_ = file_io_->GetInFlight();
+		}
+	}
+
+	void Fail() {
+		if (!failed_) {
+			failed_ = true;
+			Dec();
+		}
+	}
+
+	shared_ptr<FileIO> file_io_;
+	Handle file_handle_;
+	const int count_;
+	const int chunk_size_;
+	int written_;
+	int read_;
+	atomic<uint32_t> max_in_flight_;
+	atomic_bool failed_;
+	atomic_bool synced_;
+};
+
+class ReadError : public WaitCount, public enable_shared_from_this<ReadError> {
+public:
+	ReadError(shared_ptr<FileIO> file_io, Handle file_handle) : WaitCount(1, 2000ms), file_io_(file_io), file_handle_(file_handle), error_(0) {}
+	virtual ~ReadError() {}
+
+	void Start() {
+		auto self = shared_from_this();
+		file_io_->ReadFile(file_handle_, 0, 100, [self](const FileResult &result) {
+			self->error_ = result.GetError();
+			self->Dec();
+		});
+	}
+
+	int GetError() const { return error_; }
+
+private:
+	shared_ptr<FileIO> file_io_;
+	Handle file_handle_;
+	atomic_int error_;
+};
+
+static int CreateTempFile(int flags) {
+	char path[] = "/tmp/ael_file_io_XXXXXX";
+	auto fd = mkstemp(path);
+	if (fd >= 0) {
+		close(fd);
+		fd = open(path, flags);
+		unlink(path);
+	}
+	return fd;
+}
+
+static void TestJournal(bool io_uring) {
+	GLOBAL_CONFIG.file_io_uring_ = io_uring;
+
+	auto queue_depth = 4;
+	auto count = 64;
+
+	auto file_fd = CreateTempFile(O_RDWR);
+	ASSERT_GE(file_fd, 0);
+
+	auto event_loop = EventLoop::Create();
+
+	auto file_io = FileIO::Create(queue_depth);
+	if (!io_uring) {
+		ASSERT_FALSE(file_io->IsIOUring());
+	}
+	event_loop->Attach(file_io);
+
+	auto journal = make_shared<Journal>(file_io, file_fd, count, 4096 + 7);
+	event_loop->ExecuteOnce(&Journal::Start, journal);
+
+	ASSERT_TRUE(journal->Wait());
+	ASSERT_FALSE(journal->IsFailed());
+	ASSERT_TRUE(journal->IsSynced());
+	ASSERT_LE(journal->GetMaxInFlight(), static_cast<uint32_t>(queue_depth));
+
+	ASSERT_EQ(static_cast<off_t>(count) * (4096 + 7), lseek(file_fd, 0, SEEK_END));
+
+	close(file_fd);
+
+	GLOBAL_CONFIG.file_io_uring_ = true;
+}
+
+TEST(FileIO, JournalIOUring) {
+	TestJournal(true);
+}
+
+TEST(FileIO, JournalThreadPool) {
+	TestJournal(false);
+}
+
+TEST(FileIO, ReadError) {
+	auto file_fd = CreateTempFile(O_WRONLY);
+	ASSERT_GE(file_fd, 0);
+
+	auto event_loop = EventLoop::Create();
+
+	auto file_io = FileIO::Create();
+	event_loop->Attach(file_io);
+
+	auto read_error = make_shared<ReadError>(file_io, file_fd);
+	event_loop->ExecuteOnce(&ReadError::Start, read_error);
+
+	ASSERT_TRUE(read_error->Wait());
+	ASSERT_EQ(EBADF, read_error->GetError());
+
+	EXPECT_ANY_THROW(file_io->ReadFile(file_fd, 0, 100, [](const FileResult&) {})); // Outside the scope of the event loop.
+
+	close(file_fd);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+
+    ::testing::AddGlobalTestEnvironment(new Environment);
+
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,103 @@
+/*
+ * input_buffer_test.cc
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#include "gtest/gtest.h"
+
+#include "log.h"
+#include "helpers.h"
+#include "input_buffer.h"
+
+#include <cstring>
+
+using namespace std;
+using namespace ael;
+
+TEST(InputBuffer, Basic) {
+	InputBuffer input_buffer;
+
+	ASSERT_TRUE(input_buffer.IsEmpty());
+
+	input_buffer.Append(DataView(string("hello")).Save());
+	input_buffer.Append(DataView(string(" world")).Save());
+
+	ASSERT_FALSE(input_buffer.IsEmpty());
+	ASSERT_EQ(11, input_buffer.GetDataLength());
+
+	EXPECT_ANY_THROW(input_buffer.Peek(-1));
+	EXPECT_ANY_THROW(input_buffer.Peek(12));
+	EXPECT_ANY_THROW(input_buffer.Consume(12));
+
+	auto view = input_buffer.Peek(3);
+	ASSERT_EQ(3, view.GetDataLength());
+	ASSERT_EQ(0, memcmp(view.GetData(), "hel", view.GetDataLength()));
+
+	input_buffer.Consume(3);
+	ASSERT_EQ(8, input_buffer.GetDataLength());
+
+	auto consumed_view = input_buffer.Peek(2);
+	ASSERT_EQ(0, memcmp(consumed_view.GetData(), "lo", consumed_view.GetDataLength()));
+
+	input_buffer.Consume(8);
+	ASSERT_TRUE(input_buffer.IsEmpty());
+}
+
+TEST(InputBuffer, PeekSpansSegments) {
+	InputBuffer input_buffer;
+
+	auto segment1 = DataView(string("abc")).Save();
+	auto segment2 = DataView(string("def")).Save();
+	auto segment3 = DataView(string("ghi")).Save();
+
+	input_buffer.Append(segment1);
+	input_buffer.Append(segment2);
+	input_buffer.Append(segment3);
+
+	auto view = input_buffer.Peek(2);
+	ASSERT_EQ(segment1->GetData(), view.GetData());
+
+	input_buffer.Consume(1);
+
+	auto spanning_view = input_buffer.Peek(4);
+	ASSERT_EQ(0, memcmp(spanning_view.GetData(), "bcde", spanning_view.GetDataLength()));
+
+	// Once merged the same range is no longer copied.
+	auto merged_view = input_buffer.Peek(5);
+	ASSERT_EQ(spanning_view.GetData(), merged_view.GetData());
+	ASSERT_EQ(0, memcmp(merged_view.GetData(), "bcdef", merged_view.GetDataLength()));
+
+	auto all_view = input_buffer.Peek(8);
+	ASSERT_EQ(0, memcmp(all_view.GetData(), "bcdefghi", all_view.GetDataLength()));
+}
+
+TEST(InputBuffer, Find) {
+	InputBuffer input_buffer;
+
+	input_buffer.Append(DataView(string("GET / HTTP/1.1\r")).Save());
+	input_buffer.Append(DataView(string("\nHost: a\r\n")).Save());
+	input_buffer.Append(DataView(string("\r\n")).Save());
+
+	ASSERT_EQ(14, input_buffer.Find(string("\r\n")));
+	ASSERT_EQ(23, input_buffer.Find(string("\r\n"), 15));
+	ASSERT_EQ(23, input_buffer.Find(string("\r\n\r\n")));
+	ASSERT_EQ(-1, input_buffer.Find(string("\r\n\r\n\r\n")));
+	ASSERT_EQ(-1, input_buffer.Find(string("x")));
+	ASSERT_EQ(-1, input_buffer.Find(string("")));
+
+	input_buffer.Consume(16);
+
+	ASSERT_EQ(0, input_buffer.Find(string("Host")));
+	ASSERT_EQ(7, input_buffer.Find(string("\r\n\r\n")));
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+
+    ::testing::AddGlobalTestEnvironment(new Environment);
+
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,262 @@
+/*
+ * pipe_test.cc
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#include "gtest/gtest.h"
+
+#include "log.h"
+#include "helpers.h"
+#include "stream_buffer.h"
+#include "event_loop.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+using namespace ael;
+using namespace std;
+
+class PipeHandler : public StreamBufferHandler, public WaitCount {
+public:
+	PipeHandler(const chrono::milliseconds &wait_time) : WaitCount(1, wait_time), connected_(false), eof_(false) {}
+	virtual ~PipeHandler() {}
+
+	void HandleData(std::shared_ptr<StreamBuffer>, const std::shared_ptr<const DataView> &data_view) override {
+		lock_guard<mutex> guard(lock_);
+		data_view->AppendToString(received_);
+	}
+
+	void HandleConnected(std::shared_ptr<StreamBuffer>) override {
+		connected_ = true;
+	}
+
+	void HandleEOF(std::shared_ptr<StreamBuffer>) override {
+		eof_ = true;
+		Dec();
+	}
+
+	string GetReceived() {
+		lock_guard<mutex> guard(lock_);
+		return received_;
+	}
+
+	bool IsConnected() const { return connected_; }
+	bool IsEOF() const { return eof_; }
+
+private:
+	mutex lock_;
+	string received_;
+	atomic_bool connected_;
+	atomic_bool eof_;
+};
+
+TEST(PipeStream, ReadWrite) {
+	auto count = 1000;
+
+	int pipe_fds[2];
+	ASSERT_EQ(0, pipe(pipe_fds));
+
+	auto event_loop = EventLoop::Create();
+
+	auto reader_handler = make_shared<PipeHandler>(2000ms);
+	auto reader = StreamBuffer::CreateForPipe(reader_handler, pipe_fds[0]);
+	event_loop->Attach(reader);
+
+	auto writer_handler = make_shared<PipeHandler>(2000ms);
+	auto writer = StreamBuffer::CreateForPipe(writer_handler, pipe_fds[1]);
+	event_loop->Attach(writer);
+
+	string expected;
+	for (auto i = 0; i < count; i++) {
+		auto line = "line " + to_string(i) + string(i % 200, 'x') + "\n";
+		writer->Write(DataView(line));
+		expected += line;
+	}
+
+	// Queued data is flushed before the stream is closed - the reader gets EOF after all the data (once the write end is released).
+	writer->Close();
+	ASSERT_TRUE(writer_handler->Wait());
+	writer = nullptr;
+
+	ASSERT_TRUE(reader_handler->Wait());
+	ASSERT_TRUE(reader_handler->IsConnected());
+	ASSERT_EQ(expected, reader_handler->GetReceived());
+}
+
+TEST(PipeStream, ReaderClosed) {
+	int pipe_fds[2];
+	ASSERT_EQ(0, pipe(pipe_fds));
+
+	auto event_loop = EventLoop::Create();
+
+	auto writer_handler = make_shared<PipeHandler>(2000ms);
+	auto writer = StreamBuffer::CreateForPipe(writer_handler, pipe_fds[1]);
+	event_loop->Attach(writer);
+
+	writer->Write(DataView(string("data")));
+
+	char buf[4];
+	ASSERT_EQ(4, read(pipe_fds[0], buf, sizeof(buf)));
+	close(pipe_fds[0]);
+
+	// Without a reader the write end reaches EOF.
+	ASSERT_TRUE(writer_handler->Wait());
+	writer->Write(DataView(string("more")));
+}
+
+TEST(PipeStream, NoReader) {
+	int pipe_fds[2];
+	ASSERT_EQ(0, pipe(pipe_fds));
+	close(pipe_fds[0]);
+
+	auto event_loop = EventLoop::Create();
+
+	auto writer_handler = make_shared<PipeHandler>(2000ms);
+	auto writer = StreamBuffer::CreateForPipe(writer_handler, pipe_fds[1]);
+	writer->Write(DataView(string("data")));
+	event_loop->Attach(writer);
+
+	// The write fails (EPIPE) without raising SIGPIPE - and SIGPIPE is not ignored process wide.
+	ASSERT_TRUE(writer_handler->Wait());
+
+	struct sigaction action;
+	ASSERT_EQ(0, sigaction(SIGPIPE, nullptr, &action));
+	ASSERT_EQ(SIG_DFL, action.sa_handler);
+}
+
+TEST(PipeStream, NoReaderIgnored) {
+	int pipe_fds[2];
+	ASSERT_EQ(0, pipe(pipe_fds));
+	close(pipe_fds[0]);
+
+	// Ignored by the application - the writes are not masked.
+	struct sigaction action = {};
+	struct sigaction old_action;
+	action.sa_handler = SIG_IGN;
+	ASSERT_EQ(0, sigaction(SIGPIPE, &action, &old_action));
+
+	auto event_loop = EventLoop::Create();
+
+	auto writer_handler = make_shared<PipeHandler>(2000ms);
+	auto writer = StreamBuffer::CreateForPipe(writer_handler, pipe_fds[1]);
+	writer->Write(DataView(string("data")));
+	event_loop->Attach(writer);
+
+	auto eof = writer_handler->Wait();
+	sigaction(SIGPIPE, &old_action, nullptr);
+	ASSERT_TRUE(eof);
+}
+
+TEST(PipeStream, RestoreFlags) {
+	int pipe_fds[2];
+	ASSERT_EQ(0, pipe(pipe_fds));
+
+	// The duplicate shares the open file description (and its flags) with the original.
+	auto reader_fd = dup(pipe_fds[0]);
+	ASSERT_GE(reader_fd, 0);
+
+	auto event_loop = EventLoop::Create();
+
+	auto reader_handler = make_shared<PipeHandler>(2000ms);
+	auto reader = StreamBuffer::CreateForPipe(reader_handler, reader_fd);
+	event_loop->Attach(reader);
+	ASSERT_TRUE(fcntl(pipe_fds[0], F_GETFL) & O_NONBLOCK);
+
+	reader = nullptr;
+	ASSERT_FALSE(fcntl(pipe_fds[0], F_GETFL) & O_NONBLOCK);
+
+	close(pipe_fds[0]);
+	close(pipe_fds[1]);
+}
+
+static void TestEventFd(StreamBuffer::PipeKind pipe_kind) {
+	auto event_fd = eventfd(0, EFD_CLOEXEC);
+	ASSERT_GE(event_fd, 0);
+
+	auto event_loop = EventLoop::Create();
+
+	auto handler = make_shared<PipeHandler>(2000ms);
+	auto stream_buffer = StreamBuffer::CreateForPipe(handler, event_fd, pipe_kind);
+	event_loop->Attach(stream_buffer);
+
+	// A counter value is 8 bytes.
+	EXPECT_ANY_THROW(stream_buffer->Write(DataView(string("abc"))));
+
+	uint64_t value = 5;
+	stream_buffer->Write(DataView(reinterpret_cast<const uint8_t*>(&value), sizeof(value)));
+
+	for (auto i = 0; i < 200 && handler->GetReceived().size() < sizeof(value); i++) {
+		this_thread::sleep_for(10ms);
+	}
+
+	auto received = handler->GetReceived();
+	ASSERT_EQ(sizeof(value), received.size());
+	uint64_t received_value;
+	memcpy(&received_value, received.data(), sizeof(received_value));
+	ASSERT_EQ(value, received_value);
+}
+
+TEST(PipeStream, EventFd) {
+	TestEventFd(StreamBuffer::DETECT_PIPE);
+}
+
+TEST(PipeStream, EventFdDeclared) {
+	TestEventFd(StreamBuffer::EVENTFD_PIPE);
+}
+
+TEST(PipeStream, WriteFile) {
+	auto file_size = 1024 * 1024 + 123;
+	auto offset = 1000;
+
+	char path[] = "/tmp/ael_pipe_write_file_XXXXXX";
+	auto file_fd = mkstemp(path);
+	ASSERT_GE(file_fd, 0);
+	unlink(path);
+
+	string content(file_size, 0);
+	for (auto i = 0; i < file_size; i++) {
+		content[i] = static_cast<char>(i * 7);
+	}
+	ASSERT_EQ(file_size, write(file_fd, content.data(), content.size()));
+
+	int pipe_fds[2];
+	ASSERT_EQ(0, pipe(pipe_fds));
+
+	auto event_loop = EventLoop::Create();
+
+	auto reader_handler = make_shared<PipeHandler>(2000ms);
+	auto reader = StreamBuffer::CreateForPipe(reader_handler, pipe_fds[0]);
+	event_loop->Attach(reader);
+
+	auto writer_handler = make_shared<PipeHandler>(2000ms);
+	auto writer = StreamBuffer::CreateForPipe(writer_handler, pipe_fds[1]);
+	event_loop->Attach(writer);
+
+	writer->Write(DataView(string("head")));
+	writer->WriteFile(file_fd, offset, file_size - offset);
+	writer->Write(DataView(string("tail")));
+	writer->Close();
+	close(file_fd);
+	ASSERT_TRUE(writer_handler->Wait());
+	writer = nullptr;
+
+	ASSERT_TRUE(reader_handler->Wait());
+	ASSERT_EQ("head" + content.substr(offset) + "tail", reader_handler->GetReceived());
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+
+    ::testing::AddGlobalTestEnvironment(new Environment);
+
+    return RUN_ALL_TESTS();
+}
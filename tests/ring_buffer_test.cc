@@ -0,0 +1,75 @@
+/*
+ * ring_buffer_test.cc
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#include "gtest/gtest.h"
+
+#include "log.h"
+#include "helpers.h"
+#include "ring_buffer.h"
+
+#include <memory>
+
+using namespace std;
+using namespace ael;
+
+TEST(RingBuffer, Basic) {
+	RingBuffer<int> ring_buffer;
+
+	ASSERT_TRUE(ring_buffer.IsEmpty());
+
+	ring_buffer.PushBack(2);
+	ring_buffer.PushBack(3);
+	ring_buffer.PushFront(1);
+
+	ASSERT_EQ(3, ring_buffer.GetSize());
+	ASSERT_EQ(1, ring_buffer.Front());
+	ASSERT_EQ(3, ring_buffer.Back());
+	ASSERT_EQ(2, ring_buffer[1]);
+
+	ring_buffer.PopFront();
+	ASSERT_EQ(2, ring_buffer.Front());
+
+	ring_buffer.Clear();
+	ASSERT_TRUE(ring_buffer.IsEmpty());
+}
+
+TEST(RingBuffer, WrapAndGrow) {
+	RingBuffer<shared_ptr<int>> ring_buffer;
+
+	auto next = 0;
+	auto expected = 0;
+
+	// Keep the head moving so elements wrap around before the capacity grows.
+	for (auto round = 0; round < 100; round++) {
+		for (auto i = 0; i < 3; i++) {
+			ring_buffer.PushBack(make_shared<int>(next++));
+		}
+
+		ring_buffer.PopFront();
+		ASSERT_EQ(expected + 1, *ring_buffer.Front());
+		expected++;
+	}
+
+	ASSERT_EQ(static_cast<size_t>(next - expected), ring_buffer.GetSize());
+	ASSERT_EQ(0, ring_buffer.GetCapacity() & (ring_buffer.GetCapacity() - 1));
+
+	while (!ring_buffer.IsEmpty()) {
+		ASSERT_EQ(expected++, *ring_buffer.Front());
+		ring_buffer.PopFront();
+	}
+
+	ASSERT_EQ(next, expected);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+
+    ::testing::AddGlobalTestEnvironment(new Environment);
+
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,111 @@
+/*
+ * signal_test.cc
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#include "gtest/gtest.h"
+
+#include "log.h"
+#include "helpers.h"
+#include "signal_handler.h"
+#include "event_loop.h"
+
+#include <signal.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+
+using namespace ael;
+using namespace std;
+
+class SignalCount : public WaitCount {
+public:
+	SignalCount(int count) : WaitCount(1, 2000ms), count_(count), usr1_(0), usr2_(0), pid_(0), value_(0) {}
+	virtual ~SignalCount() {}
+
+	void Handle(const SignalInfo &signal_info) {
+		if (signal_info.GetSignal() == SIGUSR1) {
+			usr1_++;
+		} else if (signal_info.GetSignal() == SIGUSR2) {
+			usr2_++;
+			value_ = signal_info.GetCode() == SI_QUEUE;
+		}
+		pid_ = signal_info.GetPid();
+
+		if (--count_ == 0) {
+			Dec();
+		}
+	}
+
+	int GetUsr1() const { return usr1_; }
+	int GetUsr2() const { return usr2_; }
+	uint32_t GetPid() const { return pid_; }
+	bool IsQueued() const { return value_; }
+
+private:
+	atomic_int count_;
+	atomic_int usr1_;
+	atomic_int usr2_;
+	atomic<uint32_t> pid_;
+	atomic_bool value_;
+};
+
+TEST(Signal, Basic) {
+	auto event_loop = EventLoop::Create();
+	auto signal_count = make_shared<SignalCount>(2);
+
+	auto signal_handler = SignalHandler::Create({ SIGUSR1, SIGUSR2 }, [signal_count](const SignalInfo &signal_info) {
+		signal_count->Handle(signal_info);
+	});
+	event_loop->Attach(signal_handler);
+
+	ASSERT_EQ(0, kill(getpid(), SIGUSR1));
+	sigval value;
+	value.sival_int = 7;
+	ASSERT_EQ(0, sigqueue(getpid(), SIGUSR2, value));
+
+	ASSERT_TRUE(signal_count->Wait());
+	ASSERT_EQ(1, signal_count->GetUsr1());
+	ASSERT_EQ(1, signal_count->GetUsr2());
+	ASSERT_EQ(static_cast<uint32_t>(getpid()), signal_count->GetPid());
+	ASSERT_TRUE(signal_count->IsQueued());
+
+	signal_handler->Close();
+}
+
+TEST(Signal, HandledOnce) {
+	auto signal_handler = SignalHandler::Create({ SIGHUP }, [](const SignalInfo&) {});
+
+	EXPECT_ANY_THROW(SignalHandler::Create({ SIGUSR1, SIGHUP }, [](const SignalInfo&) {}));
+	EXPECT_ANY_THROW(SignalHandler::Create({ SIGKILL }, [](const SignalInfo&) {}));
+
+	signal_handler = nullptr;
+
+	auto event_loop = EventLoop::Create();
+	auto signal_count = make_shared<SignalCount>(1);
+
+	// The signal is pending (blocked) until the new signal handler reads it.
+	ASSERT_EQ(0, kill(getpid(), SIGHUP));
+
+	signal_handler = SignalHandler::Create({ SIGHUP }, [signal_count](const SignalInfo &signal_info) {
+		signal_count->Handle(signal_info);
+	});
+	event_loop->Attach(signal_handler);
+
+	ASSERT_TRUE(signal_count->Wait());
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+
+    ::testing::AddGlobalTestEnvironment(new Environment);
+
+    // Before any thread is created - the signals are received only by the signal handlers.
+    SignalHandler::Block({ SIGUSR1, SIGUSR2, SIGHUP });
+
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,51 @@
+/*
+ * small_vector_test.cc
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#include "gtest/gtest.h"
+
+#include "log.h"
+#include "helpers.h"
+#include "small_vector.h"
+
+#include <memory>
+
+using namespace std;
+using namespace ael;
+
+TEST(SmallVector, InlineAndGrow) {
+	SmallVector<shared_ptr<int>, 2> small_vector;
+
+	ASSERT_TRUE(small_vector.IsEmpty());
+	ASSERT_TRUE(small_vector.IsInline());
+
+	small_vector.PushBack(make_shared<int>(0));
+	small_vector.PushBack(make_shared<int>(1));
+	ASSERT_TRUE(small_vector.IsInline());
+
+	small_vector.PushBack(make_shared<int>(2));
+	ASSERT_FALSE(small_vector.IsInline());
+	ASSERT_EQ(3, small_vector.GetSize());
+	ASSERT_EQ(2, *small_vector.Back());
+
+	auto expected = 0;
+	for (auto &element : small_vector) {
+		ASSERT_EQ(expected++, *element);
+	}
+
+	for (auto it = small_vector.rbegin(); it != small_vector.rend(); ++it) {
+		ASSERT_EQ(--expected, **it);
+	}
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+
+    ::testing::AddGlobalTestEnvironment(new Environment);
+
+    return RUN_ALL_TESTS();
+}
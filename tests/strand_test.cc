@@ -0,0 +1,151 @@
+/*
+ * strand_test.cc
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#include "gtest/gtest.h"
+
+#include "config.h"
+#include "log.h"
+#include "helpers.h"
+#include "event_loop_group.h"
+#include "strand.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace ael;
+using namespace std;
+
+// Verifies that the functions of a strand run in order and never concurrently.
+class Session : public WaitCount {
+public:
+	Session(int threads, int count) : WaitCount(1, 5000ms), remaining_(threads * count), running_(false), failed_(false), last_(threads, -1) {}
+	virtual ~Session() {}
+
+	void Handle(int thread, int seq) {
+		if (running_.exchange(true)) {
+			failed_ = true;
+		}
+
+		if (last_[thread] + 1 != seq) {
+			failed_ = true;
+		}
+		last_[thread] = seq;
+
+		running_ = false;
+
+		if (--remaining_ == 0) {
+			Dec();
+		}
+	}
+
+	bool IsFailed() const { return failed_; }
+
+private:
+	int remaining_; // Only accessed in the strand.
+	atomic_bool running_;
+	atomic_bool failed_;
+	vector<int> last_;
+};
+
+TEST(Strand, Ordered) {
+	auto threads = 8;
+	auto count = 2000;
+
+	auto event_loop_group = EventLoopGroup::Create(4);
+	ASSERT_EQ(4u, event_loop_group->GetSize());
+
+	auto strand = event_loop_group->CreateStrand();
+	auto session = make_shared<Session>(threads, count);
+
+	vector<thread> posters;
+	for (auto t = 0; t < threads; t++) {
+		posters.emplace_back([strand, session, t, count]() {
+			for (auto i = 0; i < count; i++) {
+				strand->Post([session, t, i]() { session->Handle(t, i); });
+			}
+		});
+	}
+
+	for (auto &poster : posters) {
+		poster.join();
+	}
+
+	ASSERT_TRUE(session->Wait());
+	ASSERT_FALSE(session->IsFailed());
+}
+
+TEST(Strand, Keys) {
+	auto keys = 64;
+
+	auto event_loop_group = EventLoopGroup::Create(4);
+	auto latch = make_shared<WaitCount>(keys, 5000ms);
+	auto failed = make_shared<atomic_bool>(false);
+
+	vector<shared_ptr<Strand>> strands;
+	for (auto key = 0; key < keys; key++) {
+		auto strand = event_loop_group->CreateStrand(key);
+		ASSERT_EQ(event_loop_group->GetForKey(key), strand->GetEventLoop());
+		strands.push_back(strand);
+	}
+
+	for (auto &strand : strands) {
+		strand->Post([strand, latch, failed]() {
+			if (EventLoop::Current() != strand->GetEventLoop() || !strand->IsRunningInThisThread()) {
+				*failed = true;
+			}
+
+			auto inline_run = false;
+			strand->Dispatch([&inline_run]() { inline_run = true; });
+			if (!inline_run) {
+				*failed = true;
+			}
+
+			latch->Dec();
+		});
+	}
+
+	ASSERT_TRUE(latch->Wait());
+	ASSERT_FALSE(*failed);
+}
+
+// Restores the batch limit once the test ends (even if it fails).
+class BatchLimitScope {
+public:
+	BatchLimitScope(std::int64_t batch_limit) : prev_(GLOBAL_CONFIG.strand_batch_limit_) { GLOBAL_CONFIG.strand_batch_limit_ = batch_limit; }
+	~BatchLimitScope() { GLOBAL_CONFIG.strand_batch_limit_ = prev_; }
+
+private:
+	std::int64_t prev_;
+};
+
+TEST(Strand, BatchLimit) {
+	auto count = 10;
+
+	// Clamped to one function per iteration.
+	BatchLimitScope batch_limit_scope(0);
+
+	auto event_loop_group = EventLoopGroup::Create(1);
+	auto strand = event_loop_group->CreateStrand();
+	auto latch = make_shared<WaitCount>(count, 5000ms);
+
+	for (auto i = 0; i < count; i++) {
+		strand->Post([latch]() { latch->Dec(); });
+	}
+
+	ASSERT_TRUE(latch->Wait());
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+
+    ::testing::AddGlobalTestEnvironment(new Environment);
+
+    return RUN_ALL_TESTS();
+}
@@ -16,6 +16,13 @@
 #include <chrono>
 #include <random>
 #include <algorithm>
+#include <unordered_set>
+#include <thread>
+
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <linux/tcp.h>
 
 using namespace ael;
 using namespace std;
@@ -150,6 +157,19 @@ private:
 	bool shutdown_received_;
 };
 
+class PassThroughStreamBufferFilter: public StreamBufferFilter {
+public:
+	PassThroughStreamBufferFilter(std::shared_ptr<StreamBuffer> stream_buffer) : StreamBufferFilter(stream_buffer) {}
+	virtual ~PassThroughStreamBufferFilter() {}
+
+private:
+	InResult In() override { return PrevIn(); }
+	OutResult Out(std::shared_ptr<const DataView> &data_view) override { return PrevOut(data_view); }
+	ConnectResult Connect() override { return ConnectResult::CreateSuccess(); }
+	ConnectResult Accept() override { return ConnectResult::CreateSuccess(); }
+	ShutdownResult Shutdown() override { return ShutdownResult(true); }
+};
+
 class DummyFilterServer : public NewConnectionHandler, public WaitCount, public StreamBufferHandler, public std::enable_shared_from_this<DummyFilterServer>  {
 public:
 	DummyFilterServer(int expected_connections_count, const chrono::milliseconds &wait_time) : WaitCount(expected_connections_count, wait_time) {
@@ -385,53 +405,489 @@ private:
 	shared_ptr<EventLoop> event_loop_;
 };
 
-class PingServer : public NewConnectionHandler, public WaitCount, public StreamBufferHandler, public std::enable_shared_from_this<PingServer>  {
+// Accepts connections and attaches their stream buffers to its own event loop (the received data is kept per stream buffer).
+// The servers below override the handler functions of the feature they test.
+class TestServer : public NewConnectionHandler, public WaitCount, public StreamBufferHandler, public std::enable_shared_from_this<TestServer>  {
 public:
-	PingServer(int expected_connections_count, const chrono::milliseconds &wait_time) : WaitCount(expected_connections_count, wait_time) {
-		event_loop_ = EventLoop::Create();
-	}
-	virtual ~PingServer() {}
+	TestServer(int expected_count, const chrono::milliseconds &wait_time, DataMode data_mode = SAVED_DATA) :
+			WaitCount(expected_count, wait_time), StreamBufferHandler(data_mode), event_loop_(EventLoop::Create()) {}
+	virtual ~TestServer() {}
 
 	void HandleNewConnection(Handle handle) override {
-		auto stream_buffer = StreamBuffer::CreateForServer(shared_from_this(), handle);
+		Add(StreamBuffer::CreateForServer(shared_from_this(), handle));
+	}
+
+	void HandleEOF(std::shared_ptr<StreamBuffer> stream_buffer) override {
 		lock_.lock();
-		strings_[stream_buffer] = "";
+		auto erased = strings_.erase(stream_buffer);
 		lock_.unlock();
-		event_loop_->Attach(stream_buffer);
+		ASSERT_EQ(1, erased);
+		HandleClosed(stream_buffer);
 	}
 
-	void HandleEOF(std::shared_ptr<StreamBuffer> stream_buffer) override {
+	void HandleConnected(std::shared_ptr<StreamBuffer>) override {}
+
+	void HandleData(std::shared_ptr<StreamBuffer>, const std::shared_ptr<const DataView>&) override {}
+
+	// The last accepted stream buffer (nullptr once it is closed).
+	shared_ptr<StreamBuffer> GetStreamBuffer() {
+		lock_guard<mutex> guard(lock_);
+		return stream_buffer_.lock();
+	}
+
+protected:
+	virtual void Setup(std::shared_ptr<StreamBuffer>) {} // Called before the stream buffer is attached.
+	virtual void HandleClosed(std::shared_ptr<StreamBuffer>) {}
+
+	void Add(std::shared_ptr<StreamBuffer> stream_buffer) {
+		Setup(stream_buffer);
 		lock_.lock();
-		ASSERT_EQ(1, strings_.erase(stream_buffer));
+		strings_[stream_buffer] = "";
+		stream_buffer_ = stream_buffer;
 		lock_.unlock();
-		Dec();
+		event_loop_->Attach(stream_buffer);
+	}
+
+	// All the data received by the stream buffer so far.
+	string GetData(std::shared_ptr<StreamBuffer> stream_buffer) {
+		lock_guard<mutex> guard(lock_);
+		return strings_[stream_buffer];
+	}
+
+	// Returns all the data received by the stream buffer so far.
+	string Append(std::shared_ptr<StreamBuffer> stream_buffer, const DataView &data_view) {
+		lock_guard<mutex> guard(lock_);
+		auto &str = strings_[stream_buffer];
+		data_view.AppendToString(str);
+		return str;
 	}
 
+	mutex lock_;
+
+private:
+	unordered_map<std::shared_ptr<StreamBuffer>,string> strings_; // Keeps the stream buffers until they are closed.
+	weak_ptr<StreamBuffer> stream_buffer_;
+	shared_ptr<EventLoop> event_loop_;
+};
+
+// Replies to "ping" with "pong" and closes - the data is received in the given data mode.
+class PingServer : public TestServer {
+public:
+	PingServer(int expected_count, const chrono::milliseconds &wait_time, DataMode data_mode = SAVED_DATA, bool deferred_flush = false) :
+			TestServer(expected_count, wait_time, data_mode), deferred_flush_(deferred_flush) {}
+	virtual ~PingServer() {}
+
 	void HandleConnected(std::shared_ptr<StreamBuffer>) override {
 		Dec();
 	}
 
 	void HandleData(std::shared_ptr<StreamBuffer> stream_buffer, const std::shared_ptr<const DataView> &data_view) override {
-		lock_.lock();
-		string &str = strings_[stream_buffer];
-		lock_.unlock();
-		data_view->AppendToString(str);
+		Ping(stream_buffer, Append(stream_buffer, *data_view));
+	}
+
+	void HandleBorrowedData(std::shared_ptr<StreamBuffer> stream_buffer, const DataView &data_view) override {
+		auto retained_data_view = data_view.Retain();
+		ASSERT_EQ(data_view.GetDataLength(), retained_data_view->GetDataLength());
+		ASSERT_NE(data_view.GetData(), retained_data_view->GetData());
+		Ping(stream_buffer, Append(stream_buffer, data_view));
+	}
+
+	void HandleBufferedData(std::shared_ptr<StreamBuffer> stream_buffer, InputBuffer &input_buffer) override {
+		if (input_buffer.Find(string("ping")) == 0) {
+			input_buffer.Consume(4);
+			Ping(stream_buffer, "ping");
+		} else if (input_buffer.GetDataLength() >= 4) {
+			throw "unexpected data";
+		}
+	}
+
+protected:
+	void Setup(std::shared_ptr<StreamBuffer> stream_buffer) override {
+		stream_buffer->SetDeferredFlush(deferred_flush_);
+	}
+
+	void HandleClosed(std::shared_ptr<StreamBuffer>) override {
+		Dec();
+	}
+
+private:
+	void Ping(std::shared_ptr<StreamBuffer> stream_buffer, const string &str) {
 		if (str == "ping") {
 			LOG_TRACE("received ping writing pong");
 			auto pong_msg = string("pong");
-			stream_buffer->Write(pong_msg);
+			if (deferred_flush_) {
+				stream_buffer->Write(pong_msg.substr(0, 2));
+				stream_buffer->Write(pong_msg.substr(2, 2));
+			} else {
+				stream_buffer->Write(pong_msg);
+			}
 			stream_buffer->Close();
 		} else if (str.length() > 4) {
 			throw "string too long";
 		}
 	}
 
+	bool deferred_flush_;
+};
+
+class BackpressureServer : public TestServer {
+public:
+	BackpressureServer(int write_count, int write_size, const chrono::milliseconds &wait_time) : TestServer(2, wait_time), write_count_(write_count), write_size_(write_size), backpressured_(false), writable_(false) {}
+	virtual ~BackpressureServer() {}
+
+	void HandleConnected(std::shared_ptr<StreamBuffer> stream_buffer) override {
+		string msg(write_size_, 'x');
+		for (auto i = 0; i < write_count_; i++) {
+			stream_buffer->Write(msg);
+		}
+	}
+
+	void HandleBackpressure(std::shared_ptr<StreamBuffer> stream_buffer) override {
+		ASSERT_GT(stream_buffer->GetQueuedBytes(), static_cast<uint64_t>(write_size_ * 4));
+		ASSERT_FALSE(backpressured_);
+		backpressured_ = true;
+		Dec();
+	}
+
+	void HandleWritable(std::shared_ptr<StreamBuffer> stream_buffer) override {
+		ASSERT_LE(stream_buffer->GetQueuedBytes(), static_cast<uint64_t>(write_size_));
+		ASSERT_TRUE(backpressured_);
+		ASSERT_FALSE(writable_);
+		writable_ = true;
+		Dec();
+	}
+
+	bool IsBackpressured() const { return backpressured_; }
+
+protected:
+	void Setup(std::shared_ptr<StreamBuffer> stream_buffer) override {
+		stream_buffer->SetWriteWatermarks(write_size_, write_size_ * 4);
+	}
+
+private:
+	int write_count_;
+	int write_size_;
+	atomic_bool backpressured_;
+	atomic_bool writable_;
+};
+
+class PausedReadServer : public TestServer {
+public:
+	PausedReadServer(const chrono::milliseconds &wait_time) : TestServer(1, wait_time), received_(0) {}
+	virtual ~PausedReadServer() {}
+
+	void HandleData(std::shared_ptr<StreamBuffer>, const std::shared_ptr<const DataView> &data_view) override {
+		received_ += data_view->GetDataLength();
+		if (received_ == 4) {
+			Dec();
+		}
+	}
+
+	int GetReceived() const { return received_; }
+
+protected:
+	void Setup(std::shared_ptr<StreamBuffer> stream_buffer) override {
+		stream_buffer->PauseRead();
+	}
+
+private:
+	atomic_int received_;
+};
+
+class ConnectedServer : public TestServer {
+public:
+	ConnectedServer(const chrono::milliseconds &wait_time, bool zerocopy = false) : TestServer(1, wait_time), zerocopy_(zerocopy) {}
+	virtual ~ConnectedServer() {}
+
+	void HandleConnected(std::shared_ptr<StreamBuffer>) override {
+		Dec();
+	}
+
+protected:
+	void Setup(std::shared_ptr<StreamBuffer> stream_buffer) override {
+		stream_buffer->SetZeroCopy(zerocopy_);
+	}
+
+private:
+	bool zerocopy_;
+};
+
+class SpliceProxy : public TestServer {
+public:
+	SpliceProxy(int expected_count, const chrono::milliseconds &wait_time, in_port_t port, bool filtered) : TestServer(expected_count, wait_time), port_(port), filtered_(filtered), spliced_(0) {}
+	virtual ~SpliceProxy() {}
+
+	void HandleNewConnection(Handle handle) override {
+		auto downstream = StreamBuffer::CreateForServer(shared_from_this(), handle);
+		auto upstream = StreamBuffer::CreateForClient(shared_from_this(), "127.0.0.1", port_);
+		lock_.lock();
+		peers_[downstream] = { upstream, false, false };
+		peers_[upstream] = { downstream, false, false };
+		lock_.unlock();
+		Add(downstream);
+		Add(upstream);
+	}
+
+	void HandleConnected(std::shared_ptr<StreamBuffer> stream_buffer) override {
+		lock_guard<mutex> guard(lock_);
+		auto &peer_state = peers_[stream_buffer];
+
+		if (filtered_ && !peer_state.upgraded) {
+			peer_state.upgraded = true;
+			stream_buffer->AddStreamBufferFilter(std::make_shared<PassThroughStreamBufferFilter>(stream_buffer));
+			return;
+		}
+
+		peer_state.connected = true;
+
+		if (peers_[peer_state.peer].connected) {
+			stream_buffer->SpliceTo(peer_state.peer);
+			spliced_++;
+		}
+	}
+
+	int GetSpliced() const { return spliced_; }
+
+	void HandleData(std::shared_ptr<StreamBuffer> stream_buffer, const std::shared_ptr<const DataView> &data_view) override {
+		// Received before both sides are connected (spliced data is not handled).
+		lock_.lock();
+		auto peer = peers_[stream_buffer].peer;
+		lock_.unlock();
+		peer->Write(*data_view);
+	}
+
+protected:
+	void HandleClosed(std::shared_ptr<StreamBuffer> stream_buffer) override {
+		lock_.lock();
+		peers_.erase(stream_buffer);
+		lock_.unlock();
+		Dec();
+	}
+
+private:
+	struct PeerState {
+		shared_ptr<StreamBuffer> peer;
+		bool upgraded;
+		bool connected;
+	};
+
+	in_port_t port_;
+	bool filtered_;
+	atomic_int spliced_;
+	unordered_map<std::shared_ptr<StreamBuffer>,PeerState> peers_;
+};
+
+// Writes a burst of small records once the client sends "go".
+class BurstServer : public TestServer {
+public:
+	BurstServer(int records, int record_size, bool deferred_flush) : TestServer(1, 2000ms), records_(records), record_size_(record_size), deferred_flush_(deferred_flush) {}
+	virtual ~BurstServer() {}
+
+	void HandleConnected(std::shared_ptr<StreamBuffer>) override {
+		Dec();
+	}
+
+	void HandleData(std::shared_ptr<StreamBuffer> stream_buffer, const std::shared_ptr<const DataView> &data_view) override {
+		if (Append(stream_buffer, *data_view) == "go") {
+			string record(record_size_, 'r');
+			for (auto i = 0; i < records_; i++) {
+				stream_buffer->Write(record);
+			}
+		}
+	}
+
+protected:
+	void Setup(std::shared_ptr<StreamBuffer> stream_buffer) override {
+		stream_buffer->SetDeferredFlush(deferred_flush_);
+	}
+
+private:
+	int records_;
+	int record_size_;
+	bool deferred_flush_;
+};
+
+class HandlesServer : public TestServer {
+public:
+	HandlesServer(const chrono::milliseconds &wait_time) : TestServer(1, wait_time) {}
+	virtual ~HandlesServer() {}
+
+	void HandleHandles(std::shared_ptr<StreamBuffer> stream_buffer, std::vector<Handle> handles) override {
+		// Handles are handled before the data they were sent with.
+		ASSERT_TRUE(GetData(stream_buffer).empty());
+		lock_guard<mutex> guard(lock_);
+		handles_.insert(handles_.end(), handles.begin(), handles.end());
+	}
+
+	void HandleData(std::shared_ptr<StreamBuffer> stream_buffer, const std::shared_ptr<const DataView> &data_view) override {
+		if (Append(stream_buffer, *data_view) == "hello") {
+			Dec();
+		}
+	}
+
+	std::vector<Handle> GetHandles() {
+		lock_guard<mutex> guard(lock_);
+		return handles_;
+	}
+
+private:
+	std::vector<Handle> handles_;
+};
+
+class HandlesClient : public StreamBufferHandler {
+public:
+	HandlesClient(std::vector<Handle> handles) : handles_(handles) {}
+	virtual ~HandlesClient() {}
+
+	void HandleEOF(std::shared_ptr<StreamBuffer>) override {}
+
+	void HandleConnected(std::shared_ptr<StreamBuffer> stream_buffer) override {
+		stream_buffer->Write(DataView(string("hello")), handles_);
+	}
+
+	void HandleData(std::shared_ptr<StreamBuffer>, const std::shared_ptr<const DataView>&) override {}
+
+private:
+	std::vector<Handle> handles_;
+};
+
+// Runs the event loop from the data handler of the outer stream buffer - the inner stream buffer is read meanwhile.
+// Writes the data received by the source stream buffer to the target stream buffer and closes it - fails if a callback is
+// called while another callback is running.
+class ForwardHandler : public StreamBufferHandler {
+public:
+	ForwardHandler() : in_callback_(false), forwarded_(false), closed_(false), failed_(false) {}
+	virtual ~ForwardHandler() {}
+
+	void HandleEOF(std::shared_ptr<StreamBuffer> stream_buffer) override {
+		Enter();
+		closed_ = closed_ || stream_buffer == target_;
+		Leave();
+	}
+
+	void HandleConnected(std::shared_ptr<StreamBuffer>) override { Enter(); Leave(); }
+
+	void HandleWritable(std::shared_ptr<StreamBuffer>) override { Enter(); Leave(); }
+
+	void HandleData(std::shared_ptr<StreamBuffer> stream_buffer, const std::shared_ptr<const DataView> &data_view) override {
+		Enter();
+		if (stream_buffer == source_) {
+			target_->Write(*data_view);
+			target_->Close();
+			forwarded_ = true;
+		}
+		Leave();
+	}
+
+	void Set(shared_ptr<StreamBuffer> source, shared_ptr<StreamBuffer> target) {
+		source_ = source;
+		target_ = target;
+	}
+
+	bool IsForwarded() const { return forwarded_; }
+	bool IsClosed() const { return closed_; }
+	bool IsFailed() const { return failed_; }
+
+private:
+	void Enter() {
+		failed_ = failed_ || in_callback_;
+		in_callback_ = true;
+	}
+
+	void Leave() { in_callback_ = false; }
+
+	shared_ptr<StreamBuffer> source_;
+	shared_ptr<StreamBuffer> target_;
+	bool in_callback_;
+	bool forwarded_;
+	bool closed_;
+	bool failed_;
+};
+
+class NestedReadHandler : public BorrowedStreamBufferHandler {
+public:
+	NestedReadHandler(shared_ptr<EventLoop> event_loop, int inner_fd) : event_loop_(event_loop), inner_fd_(inner_fd), done_(false), failed_(false) {}
+	virtual ~NestedReadHandler() {}
+
+	void HandleEOF(std::shared_ptr<StreamBuffer>) override {}
+
+	void HandleConnected(std::shared_ptr<StreamBuffer>) override {}
+
+	void HandleBorrowedData(std::shared_ptr<StreamBuffer> stream_buffer, const DataView &data_view) override {
+		if (stream_buffer != outer_) {
+			data_view.AppendToString(inner_);
+			return;
+		}
+
+		string outer;
+		data_view.AppendToString(outer);
+
+		if (write(inner_fd_, "bbbb", 4) != 4) {
+			failed_ = true;
+		}
+		for (auto i = 0; i < 100 && inner_.size() < 4; i++) {
+			event_loop_->RunOnce(10ms);
+		}
+
+		string borrowed;
+		data_view.AppendToString(borrowed);
+		failed_ = failed_ || inner_ != "bbbb" || borrowed != outer;
+		done_ = true;
+	}
+
+	void SetOuter(shared_ptr<StreamBuffer> outer) { outer_ = outer; }
+	bool IsDone() const { return done_; }
+	bool IsFailed() const { return failed_; }
+
 private:
-	mutex lock_;
-	unordered_map<std::shared_ptr<StreamBuffer>,string> strings_;
 	shared_ptr<EventLoop> event_loop_;
+	shared_ptr<StreamBuffer> outer_;
+	int inner_fd_;
+	string inner_;
+	bool done_;
+	bool failed_;
 };
 
+// Receives a burst of records - returns the number of data segments it was received in and how long it took.
+static void ReceiveBurst(bool deferred_flush, uint32_t &data_segs, chrono::milliseconds &elapsed) {
+	auto records = 64;
+	auto record_size = 16;
+	in_port_t port = uniform_port_dist(mt);
+
+	auto event_loop = EventLoop::Create();
+
+	auto server = make_shared<BurstServer>(records, record_size, deferred_flush);
+	auto server_listener = StreamListener::Create(server, "127.0.0.1", port);
+	event_loop->Attach(server_listener);
+
+	auto fd = ConnectTo("127.0.0.1", port);
+	ASSERT_GE(fd, 0);
+	ASSERT_TRUE(server->Wait());
+
+	tcp_info info_before = {};
+	socklen_t info_len = sizeof(info_before);
+	ASSERT_EQ(0, getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info_before, &info_len));
+
+	auto start = chrono::steady_clock::now();
+	ASSERT_EQ(2, send(fd, "go", 2, 0));
+
+	auto received = 0;
+	while (received < records * record_size) {
+		char buf[4096];
+		auto ret = recv(fd, buf, sizeof(buf), 0);
+		ASSERT_GT(ret, 0);
+		received += ret;
+	}
+	elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+
+	tcp_info info_after = {};
+	info_len = sizeof(info_after);
+	ASSERT_EQ(0, getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info_after, &info_len));
+	data_segs = info_after.tcpi_data_segs_in - info_before.tcpi_data_segs_in;
+
+	close(fd);
+}
+
 TEST(Listener, Create) {
 	in_port_t port = uniform_port_dist(mt);
 
@@ -535,6 +991,588 @@ TEST(StreamBuffer, PingPong) {
 	ASSERT_TRUE(ping_server->Wait());
 }
 
+TEST(StreamBuffer, DeferredFlushPingPong) {
+	auto count = 50;
+	in_port_t port = uniform_port_dist(mt);
+
+	auto event_loop = EventLoop::Create();
+
+	auto ping_server = make_shared<PingServer>(count * 2, 2000ms, StreamBufferHandler::SAVED_DATA, true);
+	auto ping_server_listener = StreamListener::Create(ping_server, "127.0.0.1", port);
+	event_loop->Attach(ping_server_listener);
+
+	auto stream_buffer_handler = make_shared<StreamBufferHandlerPongCount>(count * 2, 2000ms);
+	for (auto i = 0; i < count; i++) {
+		stream_buffer_handler->Connect("127.0.0.1", port);
+	}
+
+	ASSERT_TRUE(stream_buffer_handler->Wait());
+	ASSERT_TRUE(ping_server->Wait());
+}
+
+TEST(StreamBuffer, DeferredFlushCoalesce) {
+	uint32_t data_segs;
+	chrono::milliseconds elapsed;
+	ReceiveBurst(true, data_segs, elapsed);
+	ASSERT_FALSE(HasFatalFailure());
+
+	// The burst is packed into a single segment, and the last write is not held back (cork timeout is 200ms).
+	ASSERT_EQ(1u, data_segs);
+	ASSERT_LT(elapsed, 100ms);
+}
+
+TEST(StreamBuffer, WriteNotCorked) {
+	uint32_t data_segs;
+	chrono::milliseconds elapsed;
+	ReceiveBurst(false, data_segs, elapsed);
+	ASSERT_FALSE(HasFatalFailure());
+
+	ASSERT_LT(elapsed, 100ms);
+}
+
+TEST(StreamBuffer, BorrowedPingPong) {
+	auto count = 50;
+	in_port_t port = uniform_port_dist(mt);
+
+	auto event_loop = EventLoop::Create();
+
+	auto ping_server = make_shared<PingServer>(count * 2, 2000ms, StreamBufferHandler::BORROWED_DATA);
+	auto ping_server_listener = StreamListener::Create(ping_server, "127.0.0.1", port);
+	event_loop->Attach(ping_server_listener);
+
+	auto stream_buffer_handler = make_shared<StreamBufferHandlerPongCount>(count * 2, 2000ms);
+	for (auto i = 0; i < count; i++) {
+		stream_buffer_handler->Connect("127.0.0.1", port);
+	}
+
+	ASSERT_TRUE(stream_buffer_handler->Wait());
+	ASSERT_TRUE(ping_server->Wait());
+}
+
+TEST(StreamBuffer, BufferedPingPong) {
+	auto count = 50;
+	in_port_t port = uniform_port_dist(mt);
+
+	auto event_loop = EventLoop::Create();
+
+	auto ping_server = make_shared<PingServer>(count * 2, 2000ms, StreamBufferHandler::BUFFERED_DATA);
+	auto ping_server_listener = StreamListener::Create(ping_server, "127.0.0.1", port);
+	event_loop->Attach(ping_server_listener);
+
+	auto stream_buffer_handler = make_shared<StreamBufferHandlerPongCount>(count * 2, 2000ms);
+	for (auto i = 0; i < count; i++) {
+		stream_buffer_handler->Connect("127.0.0.1", port);
+	}
+
+	ASSERT_TRUE(stream_buffer_handler->Wait());
+	ASSERT_TRUE(ping_server->Wait());
+}
+
+TEST(StreamBuffer, WriteInContext) {
+	int source_fds[2];
+	int target_fds[2];
+	ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, source_fds));
+	ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, target_fds));
+
+	EventLoopOptions options;
+	options.caller_thread_ = true;
+	auto event_loop = EventLoop::Create(options);
+
+	auto handler = make_shared<ForwardHandler>();
+	auto source = StreamBuffer::CreateForClient(handler, source_fds[0]);
+	auto target = StreamBuffer::CreateForClient(handler, target_fds[0]);
+	handler->Set(source, target);
+	event_loop->Attach(source);
+	event_loop->Attach(target);
+
+	// Connect both stream buffers.
+	ASSERT_TRUE(event_loop->RunOnce(0ms));
+
+	ASSERT_EQ(4, write(source_fds[1], "aaaa", 4));
+	for (auto i = 0; i < 100 && !handler->IsForwarded(); i++) {
+		ASSERT_TRUE(event_loop->RunOnce(10ms));
+	}
+	ASSERT_TRUE(handler->IsForwarded());
+
+	// Written and closed in the same event loop iteration - not inline (re-entering the data handler), and without a wakeup.
+	char buf[8];
+	ASSERT_EQ(4, recv(target_fds[1], buf, sizeof(buf), MSG_DONTWAIT));
+	ASSERT_EQ("aaaa", string(buf, 4));
+	ASSERT_TRUE(handler->IsClosed());
+	ASSERT_FALSE(handler->IsFailed());
+
+	handler->Set(nullptr, nullptr);
+	event_loop->Stop();
+	close(source_fds[1]);
+	close(target_fds[1]);
+}
+
+TEST(StreamBuffer, BorrowedNestedRead) {
+	int outer_fds[2];
+	int inner_fds[2];
+	ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, outer_fds));
+	ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, inner_fds));
+
+	EventLoopOptions options;
+	options.caller_thread_ = true;
+	auto event_loop = EventLoop::Create(options);
+
+	auto handler = make_shared<NestedReadHandler>(event_loop, inner_fds[1]);
+	auto outer = StreamBuffer::CreateForClient(handler, outer_fds[0]);
+	auto inner = StreamBuffer::CreateForClient(handler, inner_fds[0]);
+	handler->SetOuter(outer);
+	event_loop->Attach(outer);
+	event_loop->Attach(inner);
+
+	ASSERT_EQ(4, write(outer_fds[1], "aaaa", 4));
+	for (auto i = 0; i < 100 && !handler->IsDone(); i++) {
+		ASSERT_TRUE(event_loop->RunOnce(10ms));
+	}
+
+	ASSERT_TRUE(handler->IsDone());
+	ASSERT_FALSE(handler->IsFailed());
+
+	handler->SetOuter(nullptr);
+	event_loop->Stop();
+	close(outer_fds[1]);
+	close(inner_fds[1]);
+}
+
+TEST(StreamBuffer, WriteBackpressure) {
+	auto write_count = 128;
+	auto write_size = 256 * 1024;
+	in_port_t port = uniform_port_dist(mt);
+
+	auto event_loop = EventLoop::Create();
+
+	auto server = make_shared<BackpressureServer>(write_count, write_size, 5000ms);
+	auto server_listener = StreamListener::Create(server, "127.0.0.1", port);
+	event_loop->Attach(server_listener);
+
+	auto fd = ConnectTo("127.0.0.1", port);
+	ASSERT_GE(fd, 0);
+
+	// Do not read until the server is backpressured.
+	for (auto i = 0; i < 500 && !server->IsBackpressured(); i++) {
+		this_thread::sleep_for(10ms);
+	}
+	ASSERT_TRUE(server->IsBackpressured());
+
+	vector<char> buf(write_size);
+	int64_t total = 0;
+	while (total < static_cast<int64_t>(write_count) * write_size) {
+		auto ret = recv(fd, buf.data(), buf.size(), 0);
+		ASSERT_GT(ret, 0);
+		total += ret;
+	}
+
+	ASSERT_TRUE(server->Wait());
+	close(fd);
+}
+
+TEST(StreamBuffer, ConcurrentWrites) {
+	auto thread_count = 8;
+	auto write_count = 2000;
+	in_port_t port = uniform_port_dist(mt);
+
+	auto event_loop = EventLoop::Create();
+
+	auto server = make_shared<ConnectedServer>(2000ms);
+	auto server_listener = StreamListener::Create(server, "127.0.0.1", port);
+	event_loop->Attach(server_listener);
+
+	auto fd = ConnectTo("127.0.0.1", port);
+	ASSERT_GE(fd, 0);
+	ASSERT_TRUE(server->Wait());
+
+	auto stream_buffer = server->GetStreamBuffer();
+
+	// Each record is [thread index][sequence] - the order of each writer must be kept.
+	vector<thread> threads;
+	for (auto t = 0; t < thread_count; t++) {
+		threads.emplace_back([stream_buffer, t, write_count]() {
+			for (auto i = 0; i < write_count; i++) {
+				uint8_t record[] = { static_cast<uint8_t>(t), static_cast<uint8_t>(i >> 8), static_cast<uint8_t>(i) };
+				stream_buffer->Write(DataView(record, sizeof(record)));
+			}
+		});
+	}
+
+	vector<int> next_sequence(thread_count, 0);
+	vector<uint8_t> data;
+	auto total = static_cast<size_t>(thread_count * write_count * 3);
+	while (data.size() < total) {
+		uint8_t buf[4096];
+		auto ret = recv(fd, buf, sizeof(buf), 0);
+		ASSERT_GT(ret, 0);
+		data.insert(data.end(), buf, buf + ret);
+	}
+
+	for (auto &writer : threads) {
+		writer.join();
+	}
+
+	for (size_t i = 0; i < data.size(); i += 3) {
+		auto t = data[i];
+		ASSERT_LT(t, thread_count);
+		ASSERT_EQ(next_sequence[t]++, (data[i + 1] << 8) | data[i + 2]);
+	}
+
+	close(fd);
+}
+
+TEST(StreamBuffer, ZeroCopyWrite) {
+	auto write_count = 64;
+	auto write_size = 256 * 1024;
+	in_port_t port = uniform_port_dist(mt);
+
+	auto event_loop = EventLoop::Create();
+
+	auto server = make_shared<ConnectedServer>(2000ms, true);
+	auto server_listener = StreamListener::Create(server, "127.0.0.1", port);
+	event_loop->Attach(server_listener);
+
+	auto fd = ConnectTo("127.0.0.1", port);
+	ASSERT_GE(fd, 0);
+	ASSERT_TRUE(server->Wait());
+
+	auto stream_buffer = server->GetStreamBuffer();
+
+	vector<uint8_t> msg(write_size);
+	for (auto i = 0; i < write_count; i++) {
+		fill(msg.begin(), msg.end(), static_cast<uint8_t>(i));
+		stream_buffer->Write(DataView(msg.data(), msg.size()));
+	}
+
+	vector<uint8_t> buf(write_size);
+	int64_t total = 0;
+	while (total < static_cast<int64_t>(write_count) * write_size) {
+		auto ret = recv(fd, buf.data(), buf.size(), 0);
+		ASSERT_GT(ret, 0);
+		for (auto i = 0; i < ret; i++) {
+			ASSERT_EQ(static_cast<uint8_t>((total + i) / write_size), buf[i]);
+		}
+		total += ret;
+	}
+
+	close(fd);
+}
+
+// Writes with zerocopy, closes the stream buffer right away and drops it - the client must receive all the data and EOF.
+static void ZeroCopyWriteClose(int write_count, int write_size) {
+	in_port_t port = uniform_port_dist(mt);
+
+	auto event_loop = EventLoop::Create();
+
+	auto server = make_shared<ConnectedServer>(2000ms, true);
+	auto server_listener = StreamListener::Create(server, "127.0.0.1", port);
+	event_loop->Attach(server_listener);
+
+	auto fd = ConnectTo("127.0.0.1", port);
+	ASSERT_GE(fd, 0);
+	ASSERT_TRUE(server->Wait());
+
+	{
+		auto stream_buffer = server->GetStreamBuffer();
+		vector<uint8_t> msg(write_size);
+		for (auto i = 0; i < write_count; i++) {
+			fill(msg.begin(), msg.end(), static_cast<uint8_t>(i));
+			stream_buffer->Write(DataView(msg.data(), msg.size()));
+		}
+		stream_buffer->Close();
+	}
+
+	vector<uint8_t> buf(write_size);
+	int64_t total = 0;
+	while (true) {
+		auto ret = recv(fd, buf.data(), buf.size(), 0);
+		ASSERT_GE(ret, 0);
+		if (ret == 0) {
+			break;
+		}
+		for (auto i = 0; i < ret; i++) {
+			ASSERT_EQ(static_cast<uint8_t>((total + i) / write_size), buf[i]);
+		}
+		total += ret;
+	}
+	ASSERT_EQ(static_cast<int64_t>(write_count) * write_size, total);
+
+	close(fd);
+}
+
+TEST(StreamBuffer, ZeroCopyClose) {
+	// Closed while zerocopy sends are pending - the data is kept until the sends complete. Loopback copies the data (the
+	// following writes fall back to a regular send).
+	ZeroCopyWriteClose(16, 1024 * 1024);
+}
+
+TEST(StreamBuffer, ZeroCopyNoBuffers) {
+	// Without CAP_IPC_LOCK the locked pages limit is exceeded (ENOBUFS) - the data is sent with a copy.
+	rlimit memlock;
+	ASSERT_EQ(0, getrlimit(RLIMIT_MEMLOCK, &memlock));
+	rlimit limited = memlock;
+	limited.rlim_cur = 0;
+	ASSERT_EQ(0, setrlimit(RLIMIT_MEMLOCK, &limited));
+
+	ZeroCopyWriteClose(16, 256 * 1024);
+
+	ASSERT_EQ(0, setrlimit(RLIMIT_MEMLOCK, &memlock));
+}
+
+TEST(StreamBuffer, WriteFile) {
+	auto file_size = 4 * 1024 * 1024 + 123;
+	auto offset = 1000;
+	in_port_t port = uniform_port_dist(mt);
+
+	char path[] = "/tmp/ael_write_file_XXXXXX";
+	auto file_fd = mkstemp(path);
+	ASSERT_GE(file_fd, 0);
+	unlink(path);
+
+	vector<uint8_t> content(file_size);
+	for (auto i = 0; i < file_size; i++) {
+		content[i] = static_cast<uint8_t>(i * 7);
+	}
+	ASSERT_EQ(file_size, write(file_fd, content.data(), content.size()));
+
+	auto event_loop = EventLoop::Create();
+
+	auto server = make_shared<ConnectedServer>(2000ms);
+	auto server_listener = StreamListener::Create(server, "127.0.0.1", port);
+	event_loop->Attach(server_listener);
+
+	auto fd = ConnectTo("127.0.0.1", port);
+	ASSERT_GE(fd, 0);
+	ASSERT_TRUE(server->Wait());
+
+	auto stream_buffer = server->GetStreamBuffer();
+	stream_buffer->Write(string("head"));
+	stream_buffer->WriteFile(file_fd, offset, file_size - offset);
+	stream_buffer->Write(string("tail"));
+	close(file_fd); // The stream buffer keeps its own handle.
+
+	vector<uint8_t> expected(content.begin() + offset, content.end());
+	expected.insert(expected.begin(), {'h', 'e', 'a', 'd'});
+	expected.insert(expected.end(), {'t', 'a', 'i', 'l'});
+
+	vector<uint8_t> received;
+	while (received.size() < expected.size()) {
+		uint8_t buf[65536];
+		auto ret = recv(fd, buf, sizeof(buf), 0);
+		ASSERT_GT(ret, 0);
+		received.insert(received.end(), buf, buf + ret);
+	}
+
+	ASSERT_TRUE(expected == received);
+
+	close(fd);
+}
+
+// The client closes its write side - the upstream must receive EOF and still be able to respond through the splice.
+static void SpliceHalfClose(bool filtered) {
+	in_port_t port = uniform_port_dist(mt);
+	in_port_t proxy_port = port + 1;
+
+	auto listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	ASSERT_GE(listen_fd, 0);
+	int reuse = 1;
+	setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+	sockaddr_in in4 = {};
+	in4.sin_family = AF_INET;
+	in4.sin_port = htons(port);
+	in4.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	ASSERT_EQ(0, ::bind(listen_fd, reinterpret_cast<sockaddr*>(&in4), sizeof(in4)));
+	ASSERT_EQ(0, listen(listen_fd, 1));
+
+	auto event_loop = EventLoop::Create();
+
+	auto proxy = make_shared<SpliceProxy>(2, 2000ms, port, filtered);
+	auto proxy_listener = StreamListener::Create(proxy, "127.0.0.1", proxy_port);
+	event_loop->Attach(proxy_listener);
+
+	auto fd = ConnectTo("127.0.0.1", proxy_port);
+	ASSERT_GE(fd, 0);
+	auto upstream_fd = accept(listen_fd, nullptr, nullptr);
+	ASSERT_GE(upstream_fd, 0);
+
+	for (auto i = 0; i < 200 && proxy->GetSpliced() == 0; i++) {
+		this_thread::sleep_for(10ms);
+	}
+	ASSERT_EQ(1, proxy->GetSpliced());
+
+	ASSERT_EQ(4, send(fd, "ping", 4, 0));
+	ASSERT_EQ(0, shutdown(fd, SHUT_WR));
+
+	char buf[16];
+	string received;
+	while (true) {
+		auto ret = recv(upstream_fd, buf, sizeof(buf), 0);
+		ASSERT_GE(ret, 0);
+		if (ret == 0) {
+			break;
+		}
+		received.append(buf, ret);
+	}
+	ASSERT_EQ("ping", received);
+
+	// The other direction is still open.
+	ASSERT_EQ(4, send(upstream_fd, "pong", 4, 0));
+	close(upstream_fd);
+
+	received.clear();
+	while (true) {
+		auto ret = recv(fd, buf, sizeof(buf), 0);
+		ASSERT_GE(ret, 0);
+		if (ret == 0) {
+			break;
+		}
+		received.append(buf, ret);
+	}
+	ASSERT_EQ("pong", received);
+
+	ASSERT_TRUE(proxy->Wait());
+
+	close(fd);
+	close(listen_fd);
+}
+
+TEST(StreamBuffer, SplicePingPong) {
+	auto count = 20;
+	in_port_t port = uniform_port_dist(mt);
+	in_port_t proxy_port = port + 1;
+
+	auto event_loop = EventLoop::Create();
+
+	auto ping_server = make_shared<PingServer>(count * 2, 2000ms);
+	auto ping_server_listener = StreamListener::Create(ping_server, "127.0.0.1", port);
+	event_loop->Attach(ping_server_listener);
+
+	auto proxy = make_shared<SpliceProxy>(count * 2, 2000ms, port, false);
+	auto proxy_listener = StreamListener::Create(proxy, "127.0.0.1", proxy_port);
+	event_loop->Attach(proxy_listener);
+
+	auto stream_buffer_handler = make_shared<StreamBufferHandlerPongCount>(count * 2, 2000ms);
+	for (auto i = 0; i < count; i++) {
+		stream_buffer_handler->Connect("127.0.0.1", proxy_port);
+	}
+
+	ASSERT_TRUE(stream_buffer_handler->Wait());
+	ASSERT_TRUE(ping_server->Wait());
+	ASSERT_TRUE(proxy->Wait());
+}
+
+TEST(StreamBuffer, SpliceFilteredPingPong) {
+	auto count = 20;
+	in_port_t port = uniform_port_dist(mt);
+	in_port_t proxy_port = port + 1;
+
+	auto event_loop = EventLoop::Create();
+
+	auto ping_server = make_shared<PingServer>(count * 2, 2000ms);
+	auto ping_server_listener = StreamListener::Create(ping_server, "127.0.0.1", port);
+	event_loop->Attach(ping_server_listener);
+
+	auto proxy = make_shared<SpliceProxy>(count * 2, 2000ms, port, true);
+	auto proxy_listener = StreamListener::Create(proxy, "127.0.0.1", proxy_port);
+	event_loop->Attach(proxy_listener);
+
+	auto stream_buffer_handler = make_shared<StreamBufferHandlerPongCount>(count * 2, 2000ms);
+	for (auto i = 0; i < count; i++) {
+		stream_buffer_handler->Connect("127.0.0.1", proxy_port);
+	}
+
+	ASSERT_TRUE(stream_buffer_handler->Wait());
+	ASSERT_TRUE(ping_server->Wait());
+	ASSERT_TRUE(proxy->Wait());
+}
+
+TEST(StreamBuffer, SpliceHalfClose) {
+	SpliceHalfClose(false);
+}
+
+TEST(StreamBuffer, SpliceFilteredHalfClose) {
+	SpliceHalfClose(true);
+}
+
+TEST(StreamBuffer, UnixPingPong) {
+	auto count = 50;
+	auto path = "/tmp/ael_tcp_test_" + to_string(uniform_port_dist(mt)) + ".sock";
+	unlink(path.c_str());
+
+	auto event_loop = EventLoop::Create();
+
+	auto ping_server = make_shared<PingServer>(count * 2, 2000ms);
+	auto ping_server_listener = StreamListener::Create(ping_server, path, 0);
+	event_loop->Attach(ping_server_listener);
+
+	auto stream_buffer_handler = make_shared<StreamBufferHandlerPongCount>(count * 2, 2000ms);
+	for (auto i = 0; i < count; i++) {
+		stream_buffer_handler->Connect(path, 0);
+	}
+
+	ASSERT_TRUE(stream_buffer_handler->Wait());
+	ASSERT_TRUE(ping_server->Wait());
+
+	unlink(path.c_str());
+}
+
+TEST(StreamBuffer, WriteHandles) {
+	auto address = "@ael_tcp_test_" + to_string(uniform_port_dist(mt));
+
+	int pipe_fds[2];
+	ASSERT_EQ(0, pipe(pipe_fds));
+	ASSERT_EQ(5, write(pipe_fds[1], "piped", 5));
+
+	auto event_loop = EventLoop::Create();
+
+	auto server = make_shared<HandlesServer>(2000ms);
+	auto server_listener = StreamListener::Create(server, address, 0);
+	event_loop->Attach(server_listener);
+
+	auto client_handler = make_shared<HandlesClient>(std::vector<Handle>{ pipe_fds[0] });
+	auto client = StreamBuffer::CreateForClient(client_handler, address, 0);
+	event_loop->Attach(client);
+
+	ASSERT_TRUE(server->Wait());
+
+	auto handles = server->GetHandles();
+	ASSERT_EQ(1, handles.size());
+	ASSERT_NE(pipe_fds[0], handles[0]);
+
+	// The received handle refers to the same pipe.
+	char buf[5];
+	ASSERT_EQ(5, read(handles[0], buf, sizeof(buf)));
+	ASSERT_EQ(0, memcmp(buf, "piped", 5));
+
+	handles[0].Close();
+	close(pipe_fds[0]);
+	close(pipe_fds[1]);
+}
+
+TEST(StreamBuffer, PauseResumeRead) {
+	in_port_t port = uniform_port_dist(mt);
+
+	auto event_loop = EventLoop::Create();
+
+	auto server = make_shared<PausedReadServer>(2000ms);
+	auto server_listener = StreamListener::Create(server, "127.0.0.1", port);
+	event_loop->Attach(server_listener);
+
+	auto fd = ConnectTo("127.0.0.1", port);
+	ASSERT_GE(fd, 0);
+	ASSERT_EQ(4, send(fd, "ping", 4, 0));
+
+	this_thread::sleep_for(50ms);
+	ASSERT_EQ(0, server->GetReceived());
+
+	auto stream_buffer = server->GetStreamBuffer();
+	ASSERT_TRUE(stream_buffer);
+	stream_buffer->ResumeRead();
+
+	ASSERT_TRUE(server->Wait());
+	close(fd);
+}
+
 TEST(StreamBuffer, ConnectFailure) {
 	auto event_loop = EventLoop::Create();
 	auto stream_buffer_handler = make_shared<StreamBufferHandlerEOFCount>(1, 1000ms);
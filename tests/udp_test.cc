@@ -0,0 +1,161 @@
+/*
+ * udp_test.cc
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: tomer
+ */
+
+#include "gtest/gtest.h"
+
+#include "log.h"
+#include "helpers.h"
+#include "datagram_socket.h"
+#include "event_loop.h"
+
+#include <chrono>
+#include <unordered_set>
+
+using namespace ael;
+using namespace std;
+
+class EchoDatagramHandler : public DatagramHandler {
+public:
+	EchoDatagramHandler() {}
+	virtual ~EchoDatagramHandler() {}
+
+	void HandleDatagram(std::shared_ptr<DatagramSocket> datagram_socket, const DataView &data_view, const SocketAddress &source) override {
+		datagram_socket->SendTo(data_view, source);
+	}
+};
+
+class CollectDatagramHandler : public DatagramHandler, public WaitCount {
+public:
+	CollectDatagramHandler(int expected_count, const chrono::milliseconds &wait_time) : WaitCount(expected_count, wait_time) {}
+	virtual ~CollectDatagramHandler() {}
+
+	void HandleDatagram(std::shared_ptr<DatagramSocket>, const DataView &data_view, const SocketAddress &source) override {
+		string str;
+		data_view.AppendToString(str);
+		lock_.lock();
+		received_.insert(str);
+		sources_.insert(source.GetPort());
+		lock_.unlock();
+		Dec();
+	}
+
+	unordered_set<string> GetReceived() {
+		lock_guard<mutex> guard(lock_);
+		return received_;
+	}
+
+	unordered_set<uint16_t> GetSources() {
+		lock_guard<mutex> guard(lock_);
+		return sources_;
+	}
+
+private:
+	mutex lock_;
+	unordered_set<string> received_;
+	unordered_set<uint16_t> sources_;
+};
+
+TEST(SocketAddress, Basic) {
+	SocketAddress address4("127.0.0.1", 5000);
+	ASSERT_EQ("127.0.0.1", address4.GetIPAddr());
+	ASSERT_EQ(5000, address4.GetPort());
+
+	SocketAddress address6("::1", 5001);
+	ASSERT_EQ("::1", address6.GetIPAddr());
+	ASSERT_EQ(5001, address6.GetPort());
+
+	ASSERT_TRUE(address4 == SocketAddress("127.0.0.1", 5000));
+	ASSERT_TRUE(address4 != SocketAddress("127.0.0.1", 5001));
+	ASSERT_TRUE(address4 != address6);
+	ASSERT_TRUE(SocketAddress().IsEmpty());
+
+	EXPECT_ANY_THROW(SocketAddress("not an address", 5000));
+}
+
+TEST(DatagramSocket, Echo) {
+	auto count = 100;
+
+	auto event_loop = EventLoop::Create();
+
+	auto echo_handler = make_shared<EchoDatagramHandler>();
+	auto echo_socket = DatagramSocket::Create(echo_handler, "127.0.0.1", 0);
+	event_loop->Attach(echo_socket);
+
+	auto collect_handler = make_shared<CollectDatagramHandler>(count, 2000ms);
+	auto collect_socket = DatagramSocket::Create(collect_handler, "127.0.0.1", 0);
+	event_loop->Attach(collect_socket);
+
+	auto destination = echo_socket->GetLocalAddress();
+	ASSERT_NE(0, destination.GetPort());
+
+	for (auto i = 0; i < count; i++) {
+		collect_socket->SendTo(DataView(to_string(i)), destination);
+	}
+
+	ASSERT_TRUE(collect_handler->Wait());
+
+	auto received = collect_handler->GetReceived();
+	ASSERT_EQ(count, received.size());
+	for (auto i = 0; i < count; i++) {
+		ASSERT_EQ(1, received.count(to_string(i)));
+	}
+
+	auto sources = collect_handler->GetSources();
+	ASSERT_EQ(1, sources.size());
+	ASSERT_EQ(destination.GetPort(), *sources.begin());
+
+	collect_socket->Close();
+	echo_socket->Close();
+}
+
+TEST(DatagramSocket, SegmentationOffload) {
+	auto count = 40;
+	auto length = 1000;
+
+	auto event_loop = EventLoop::Create();
+
+	auto collect_handler = make_shared<CollectDatagramHandler>(count, 2000ms);
+	auto collect_socket = DatagramSocket::Create(collect_handler, "127.0.0.1", 0);
+	collect_socket->SetReceiveOffload(true);
+	event_loop->Attach(collect_socket);
+
+	auto echo_handler = make_shared<EchoDatagramHandler>();
+	auto send_socket = DatagramSocket::Create(echo_handler, "127.0.0.1", 0);
+	send_socket->SetSegmentationOffload(true);
+
+	auto destination = collect_socket->GetLocalAddress();
+
+	// Queued before attaching - sent as a single batch.
+	for (auto i = 0; i < count; i++) {
+		string datagram(length, 'a' + i % 26);
+		datagram.replace(0, to_string(i).length(), to_string(i));
+		send_socket->SendTo(DataView(datagram), destination);
+	}
+
+	event_loop->Attach(send_socket);
+
+	ASSERT_TRUE(collect_handler->Wait());
+
+	auto received = collect_handler->GetReceived();
+	ASSERT_EQ(count, received.size());
+	for (auto &datagram : received) {
+		ASSERT_EQ(length, datagram.length());
+	}
+
+	auto sources = collect_handler->GetSources();
+	ASSERT_EQ(1, sources.size());
+	ASSERT_EQ(send_socket->GetLocalAddress().GetPort(), *sources.begin());
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+
+    ::testing::AddGlobalTestEnvironment(new Environment);
+
+    return RUN_ALL_TESTS();
+}